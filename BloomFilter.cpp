@@ -0,0 +1,40 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include "BloomFilter.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace moose {
+namespace tools {
+
+BloomFilter::BloomFilter(const std::size_t n_expected_elements, const unsigned int n_bits_per_element) {
+
+	reset(n_expected_elements, n_bits_per_element);
+}
+
+void BloomFilter::clear() noexcept {
+
+	std::memset(m_blocks.data(), 0, m_blocks.size() * sizeof(block));
+	m_elements = 0;
+}
+
+void BloomFilter::reset(const std::size_t n_expected_elements, const unsigned int n_bits_per_element) {
+
+	// at least one block so lookups need no special case
+	const std::size_t bits = std::max<std::size_t>(n_expected_elements, 1) * std::max(n_bits_per_element, 1u);
+	const std::size_t blocks = (bits + (sizeof(block) * 8) - 1) / (sizeof(block) * 8);
+
+	m_blocks.assign(blocks, block());
+	clear();
+	m_capacity = n_expected_elements;
+}
+
+#if defined(BOOST_MSVC)
+void BloomFilterGetRidOfLNK4221() {}
+#endif
+
+}
+}
@@ -0,0 +1,124 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+#include "MooseToolsConfig.hpp"
+
+#include <boost/cstdint.hpp>
+
+#include <vector>
+
+namespace moose {
+namespace tools {
+
+/*! @brief split block bloom filter
+
+	Each key maps to one 64 byte block (a cache line) and sets one bit in each of its
+	eight 64 bit words, so both insert and lookup touch exactly one cache line.
+	With 10 bits per element this yields about 1% false positives.
+
+	Keys are expected to be hash values. They are mixed again internally so
+	sequential ids work as well as random ones.
+
+	Not thread safe for concurrent insert, concurrent lookups are fine.
+ */
+class BloomFilter {
+
+	public:
+		//! @brief create a filter sized for n_expected_elements with n_bits_per_element
+		MOOSE_TOOLS_API explicit BloomFilter(const std::size_t n_expected_elements = 0, const unsigned int n_bits_per_element = 10);
+
+		//! add a key
+		void insert(const boost::uint64_t n_key) noexcept {
+
+			const boost::uint64_t hash = mix(n_key);
+			block &b = m_blocks[block_index(hash)];
+			for (unsigned int i = 0; i < 8; ++i) {
+				b.m_words[i] |= bit(hash, i);
+			}
+			++m_elements;
+		}
+
+		//! @return false if the key was definitely never inserted
+		bool may_contain(const boost::uint64_t n_key) const noexcept {
+
+			const boost::uint64_t hash = mix(n_key);
+			const block &b = m_blocks[block_index(hash)];
+			for (unsigned int i = 0; i < 8; ++i) {
+				if (!(b.m_words[i] & bit(hash, i))) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		//! forget all keys but keep the size
+		MOOSE_TOOLS_API void clear() noexcept;
+
+		//! forget all keys and resize for a new expected number of elements
+		MOOSE_TOOLS_API void reset(const std::size_t n_expected_elements, const unsigned int n_bits_per_element = 10);
+
+		//! number of insert() calls since the last clear or reset
+		std::size_t elements() const noexcept {
+
+			return m_elements;
+		}
+
+		//! how many elements the filter was sized for
+		std::size_t capacity() const noexcept {
+
+			return m_capacity;
+		}
+
+		//! bytes allocated for the bit array
+		std::size_t memory_usage() const noexcept {
+
+			return m_blocks.size() * sizeof(block);
+		}
+
+	private:
+		struct alignas(64) block {
+			boost::uint64_t m_words[8];
+		};
+
+		//! murmur3 finalizer so neighbouring keys end up in different blocks
+		static boost::uint64_t mix(boost::uint64_t n_key) noexcept {
+
+			n_key ^= n_key >> 33;
+			n_key *= 0xff51afd7ed558ccdULL;
+			n_key ^= n_key >> 33;
+			n_key *= 0xc4ceb9fe1a85ec53ULL;
+			n_key ^= n_key >> 33;
+			return n_key;
+		}
+
+		//! upper half of the hash picks the block, without a division
+		std::size_t block_index(const boost::uint64_t n_hash) const noexcept {
+
+			return static_cast<std::size_t>(((n_hash >> 32) * static_cast<boost::uint64_t>(m_blocks.size())) >> 32);
+		}
+
+		//! lower half of the hash times an odd salt picks one bit per word
+		static boost::uint64_t bit(const boost::uint64_t n_hash, const unsigned int n_word) noexcept {
+
+			static const boost::uint32_t salt[8] = {
+				0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+				0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+			};
+
+			const boost::uint32_t h = static_cast<boost::uint32_t>(n_hash) * salt[n_word];
+			return boost::uint64_t(1) << (h >> 26);
+		}
+
+		std::vector<block>  m_blocks;
+		std::size_t         m_elements = 0;
+		std::size_t         m_capacity = 0;
+};
+
+#if defined(BOOST_MSVC)
+MOOSE_TOOLS_API void BloomFilterGetRidOfLNK4221();
+#endif
+
+}
+}
@@ -5,9 +5,130 @@
 
 #include "Carne.hpp"
 
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
 namespace moose {
 namespace tools {
 
+namespace detail {
+
+incarnation_waiter_count incarnation_waiters[incarnation_bucket_count];
+
+} // namespace detail
+
+namespace {
+
+	//! Waiters are hashed by address into detail::incarnation_bucket_count buckets.
+	//! Collisions only cause spurious wakeups, which all waiters check for.
+	struct alignas(64) incarnation_bucket {
+
+		struct async_waiter {
+			const void             *m_address;
+			boost::uint64_t         m_ticket;
+			std::function<void ()>  m_notify;
+		};
+
+		std::mutex                 m_mutex;
+		std::condition_variable    m_condition;
+		std::vector<async_waiter>  m_async_waiters;
+	};
+
+	incarnation_bucket incarnation_buckets[detail::incarnation_bucket_count];
+	std::atomic<boost::uint64_t> next_incarnation_ticket{ 1 };
+}
+
+namespace detail {
+
+void incarnation_notify(const void *n_address) noexcept {
+
+	const std::size_t index = incarnation_bucket_index(n_address);
+	incarnation_bucket &bucket = incarnation_buckets[index];
+
+	{
+		std::lock_guard<std::mutex> slock(bucket.m_mutex);
+		bucket.m_condition.notify_all();
+	}
+
+	// Take the async waiters one at a time so nothing has to be allocated here and
+	// call them outside the lock as they may post and take other locks
+	for (;;) {
+		std::function<void ()> notify;
+
+		{
+			std::lock_guard<std::mutex> slock(bucket.m_mutex);
+			const std::vector<incarnation_bucket::async_waiter>::iterator i = std::find_if(bucket.m_async_waiters.begin(), bucket.m_async_waiters.end(),
+					[n_address](const incarnation_bucket::async_waiter &n_waiter) {
+						return n_waiter.m_address == n_address;
+					});
+
+			if (i == bucket.m_async_waiters.end()) {
+				return;
+			}
+
+			notify = std::move(i->m_notify);
+			bucket.m_async_waiters.erase(i);
+			incarnation_waiters[index].m_count.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		// a failing post must neither keep the others from being notified nor terminate the writer
+		try {
+			notify();
+		} catch (...) {
+		}
+	}
+}
+
+bool incarnation_wait(const void *n_address, const std::function<bool ()> &n_changed,
+		const std::chrono::steady_clock::time_point n_deadline) {
+
+	const std::size_t index = incarnation_bucket_index(n_address);
+	incarnation_bucket &bucket = incarnation_buckets[index];
+	std::unique_lock<std::mutex> slock(bucket.m_mutex);
+
+	// seq_cst like the check of the counter in n_changed, pairs with Incarnated::notify_waiters()
+	incarnation_waiters[index].m_count.fetch_add(1, std::memory_order_seq_cst);
+
+	const bool ret = bucket.m_condition.wait_until(slock, n_deadline, n_changed);
+	incarnation_waiters[index].m_count.fetch_sub(1, std::memory_order_relaxed);
+	return ret;
+}
+
+boost::uint64_t incarnation_add_async_waiter(const void *n_address, std::function<void ()> &&n_notify) {
+
+	const std::size_t index = incarnation_bucket_index(n_address);
+	incarnation_bucket &bucket = incarnation_buckets[index];
+	const boost::uint64_t ticket = next_incarnation_ticket.fetch_add(1, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> slock(bucket.m_mutex);
+		bucket.m_async_waiters.push_back(incarnation_bucket::async_waiter{ n_address, ticket, std::move(n_notify) });
+
+		// caller checks for changes after this, seq_cst pairs with Incarnated::notify_waiters()
+		incarnation_waiters[index].m_count.fetch_add(1, std::memory_order_seq_cst);
+	}
+
+	return ticket;
+}
+
+void incarnation_remove_async_waiter(const void *n_address, const boost::uint64_t n_ticket) noexcept {
+
+	const std::size_t index = incarnation_bucket_index(n_address);
+	incarnation_bucket &bucket = incarnation_buckets[index];
+	std::lock_guard<std::mutex> slock(bucket.m_mutex);
+	for (std::size_t i = 0; i < bucket.m_async_waiters.size(); ++i) {
+		if (bucket.m_async_waiters[i].m_ticket == n_ticket) {
+			bucket.m_async_waiters.erase(bucket.m_async_waiters.begin() + i);
+			incarnation_waiters[index].m_count.fetch_sub(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+}
+
+} // namespace detail
+
 #if defined(BOOST_MSVC)
 void CarneGetRidOfLNK4221() {}
 #endif
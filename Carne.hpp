@@ -7,23 +7,306 @@
 #include "MooseToolsConfig.hpp"
 #include "Random.hpp"
 #include "Assert.hpp"
+#include "ThreadId.hpp"
 
 #include <boost/cstdint.hpp>
 #include <boost/type_traits/is_same.hpp>
 
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <vector>
 
 namespace moose {
 namespace tools {
 
 class IncarnatedUnusedParent {};
 
+namespace detail {
+
+//! waiters are hashed by address into this many buckets
+const std::size_t incarnation_bucket_count = 64;
+
+//! @return the bucket waiters on n_address are in
+inline std::size_t incarnation_bucket_index(const void *n_address) noexcept {
+
+	const boost::uint64_t key = static_cast<boost::uint64_t>(reinterpret_cast<std::uintptr_t>(n_address)) * 0x9e3779b97f4a7c15ull;
+	return static_cast<std::size_t>((key >> 58) % incarnation_bucket_count);
+}
+
+/*! @brief number of threads and operations currently waiting in one bucket
+
+	Writers read their bucket's count after every increase and only go into the
+	slow path of notifying when it is not 0. Nobody writes it unless someone waits
+	in that bucket, so the cache line stays shared and reading it is close to free.
+	A long wait on one object leaves writers hashed into the other buckets alone.
+ */
+struct alignas(64) incarnation_waiter_count {
+
+	std::atomic<unsigned int>  m_count{ 0 };
+};
+
+extern MOOSE_TOOLS_API incarnation_waiter_count incarnation_waiters[incarnation_bucket_count];
+
+/*! @brief wake everyone waiting on n_address. Only call when its bucket's waiter count is not 0
+	Exceptions thrown by asynchronous waiters' callbacks are swallowed so the others still run.
+ */
+MOOSE_TOOLS_API void incarnation_notify(const void *n_address) noexcept;
+
+/*! @brief block until n_changed returns true or n_deadline passes
+	@return the last result of n_changed
+ */
+MOOSE_TOOLS_API bool incarnation_wait(const void *n_address, const std::function<bool ()> &n_changed,
+		const std::chrono::steady_clock::time_point n_deadline);
+
+/*! @brief have n_notify called once on the next notification for n_address
+	n_notify is called from the writing thread so it should just post somewhere
+	@return ticket to remove the registration
+ */
+MOOSE_TOOLS_API boost::uint64_t incarnation_add_async_waiter(const void *n_address, std::function<void ()> &&n_notify);
+
+//! remove a registration unless it was notified already
+MOOSE_TOOLS_API void incarnation_remove_async_waiter(const void *n_address, const boost::uint64_t n_ticket) noexcept;
+
+//! increases not yet propagated to the parent. Empty without one so it costs no space
+template< bool HasParent >
+struct incarnation_deferral {
+
+	std::atomic<boost::uint64_t>  m_deferred{ 0 };
+};
+
+template< >
+struct incarnation_deferral<false> {
+};
+
+} // namespace detail
+
+/*! @brief the default counter for Incarnated, a single atomic
+ *
+ *  Increments and reads are sequentially consistent, so whoever sees a new incarnation
+ *  also sees the modification that caused it and waiters are never missed, see
+ *  Incarnated::notify_waiters(). On x86 that costs the same as release and acquire.
+ *  Cheap to read, but every writer hits the same cache line.
+ */
+class atomic_incarnation_counter {
+
+	public:
+		explicit atomic_incarnation_counter(const boost::uint64_t n_value = 0) noexcept
+				: m_value(n_value) {
+		}
+
+		boost::uint64_t load() const noexcept {
+
+			return m_value.load(std::memory_order_seq_cst);
+		}
+
+		void increase() noexcept {
+
+			m_value.fetch_add(1, std::memory_order_seq_cst);
+		}
+
+	private:
+		std::atomic<boost::uint64_t>  m_value;
+};
+
+/*! @brief contention free counter for Incarnated with many concurrent writers
+ *
+ *  Every thread increments one of Stripes counters on separate cache lines, chosen
+ *  by thread_index(). Reading sums all stripes, so it costs Stripes loads.
+ *  As every stripe only grows, the sum still never goes backwards for a reader,
+ *  which is all changed() needs. It may however be behind a concurrent increment.
+ *
+ *  The stripes are increased and loaded sequentially consistent, not release and acquire.
+ *  Incarnated::wait_changed() needs every increase ordered before the writer's check
+ *  for waiters, which release doesn't give and which would otherwise take a full fence
+ *  per increase. On x86 a seq_cst fetch_add is the same locked instruction as a release
+ *  one and a seq_cst load is a plain load. On ARMv8 they are the same acquire/release
+ *  instructions. So the price there is next to nothing, while the gain of striping,
+ *  writers not sharing a cache line, stays. Architectures like POWER pay a full barrier
+ *  per stripe read, use another Counter there if nobody waits.
+ */
+template< std::size_t Stripes = 16 >
+class striped_incarnation_counter {
+
+	static_assert(Stripes > 0, "need at least one stripe");
+
+	public:
+		explicit striped_incarnation_counter(const boost::uint64_t n_value = 0) noexcept {
+
+			m_stripes[0].m_value.store(n_value, std::memory_order_relaxed);
+		}
+
+		boost::uint64_t load() const noexcept {
+
+			boost::uint64_t ret = 0;
+			for (const stripe &s : m_stripes) {
+				ret += s.m_value.load(std::memory_order_seq_cst);
+			}
+			return ret;
+		}
+
+		void increase() noexcept {
+
+			m_stripes[thread_index() % Stripes].m_value.fetch_add(1, std::memory_order_seq_cst);
+		}
+
+	private:
+		struct alignas(64) stripe {
+			std::atomic<boost::uint64_t>  m_value{ 0 };
+		};
+
+		stripe  m_stripes[Stripes];
+};
+
+template< typename Child >
+class DirtyChildTracker;
+
+/*! @brief opt-in hook for children that want their parent to know which of them changed
+
+	Derive Child from this and have the parent derive from DirtyChildTracker<Child>.
+	Incarnated then puts the child on the parent's dirty list whenever it increases,
+	unless it is on there already.
+ */
+template< typename Child >
+class DirtyTrackedChild {
+
+	protected:
+		DirtyTrackedChild() = default;
+		DirtyTrackedChild(const DirtyTrackedChild &) noexcept {
+		}
+
+		//! takes itself off the tracker's list so collect_dirty() never sees it dangling
+		~DirtyTrackedChild() noexcept {
+
+			if (m_dirty_tracker) {
+				m_dirty_tracker->remove_dirty(this);
+			}
+		}
+
+	public:
+		/*! @brief put this on n_tracker's dirty list. Lock-free, no shared write when already on there
+
+			Always an exchange rather than checking first. If it finds the flag set, the collector
+			clearing it later reads from this and so sees whatever we changed before.
+		 */
+		void mark_dirty(DirtyChildTracker<Child> &n_tracker) noexcept {
+
+			if (m_dirty_queued.exchange(true, std::memory_order_acq_rel)) {
+				return;
+			}
+
+			m_dirty_tracker = &n_tracker;
+			n_tracker.push_dirty(this);
+		}
+
+	private:
+		friend class DirtyChildTracker<Child>;
+
+		std::atomic<bool>              m_dirty_queued{ false };
+		DirtyTrackedChild             *m_dirty_next = nullptr;
+		DirtyChildTracker<Child>      *m_dirty_tracker = nullptr;
+};
+
+/*! @brief parent side of dirty tracking
+
+	Keeps the children that changed since the last collect_dirty() in an intrusive
+	lock-free stack, so marking costs one CAS and no allocation. Collecting swaps
+	the whole stack out. Children must not outlive this.
+ */
+template< typename Child >
+class DirtyChildTracker {
+
+	public:
+		DirtyChildTracker() = default;
+		DirtyChildTracker(const DirtyChildTracker &) = delete;
+		DirtyChildTracker &operator=(const DirtyChildTracker &) = delete;
+
+		/*! @brief take all children marked since the last call
+			Every child is returned once, no matter how often it changed.
+			Order is unspecified.
+			@throw std::bad_alloc
+		 */
+		std::vector<Child *> collect_dirty() {
+
+			std::vector<Child *> ret;
+			std::lock_guard<std::mutex> slock(m_dirty_consumer);
+
+			DirtyTrackedChild<Child> *node = m_dirty_head.exchange(nullptr, std::memory_order_acquire);
+			while (node) {
+				DirtyTrackedChild<Child> *next = node->m_dirty_next;
+				// Once this is cleared the child may be pushed again and overwrite next
+				node->m_dirty_queued.exchange(false, std::memory_order_acq_rel);
+				ret.push_back(static_cast<Child *>(node));
+				node = next;
+			}
+
+			return ret;
+		}
+
+		//! anything to collect?
+		bool has_dirty() const noexcept {
+
+			return m_dirty_head.load(std::memory_order_acquire) != nullptr;
+		}
+
+	private:
+		friend class DirtyTrackedChild<Child>;
+
+		void push_dirty(DirtyTrackedChild<Child> *n_child) noexcept {
+
+			DirtyTrackedChild<Child> *head = m_dirty_head.load(std::memory_order_relaxed);
+			do {
+				n_child->m_dirty_next = head;
+			} while (!m_dirty_head.compare_exchange_weak(head, n_child, std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		//! Only the consumer changes links other than head, so holding its lock
+		//! I can unlink from the middle while others push on top.
+		void remove_dirty(DirtyTrackedChild<Child> *n_child) noexcept {
+
+			std::lock_guard<std::mutex> slock(m_dirty_consumer);
+			if (!n_child->m_dirty_queued.load(std::memory_order_acquire)) {
+				return;
+			}
+
+			DirtyTrackedChild<Child> *head = n_child;
+			if (m_dirty_head.compare_exchange_strong(head, n_child->m_dirty_next, std::memory_order_acq_rel)) {
+				return;
+			}
+
+			for (DirtyTrackedChild<Child> *node = head; node; node = node->m_dirty_next) {
+				if (node->m_dirty_next == n_child) {
+					node->m_dirty_next = n_child->m_dirty_next;
+					return;
+				}
+			}
+		}
+
+		std::atomic<DirtyTrackedChild<Child> *>  m_dirty_head{ nullptr };
+		std::mutex                               m_dirty_consumer;
+};
+
 /*! @brief Give a class an atomic incarnation counter 
  *  
  *  You may also provide a parent, causing an incarnation increase of this to also increase the parent object's.
+ *
+ *  With many threads modifying children of a common parent the parent's counter becomes
+ *  a hot spot. Use striped_incarnation_counter as Counter for the parent and
+ *  increase_incarnation_deferred() plus an occasional propagate_incarnation() on the
+ *  children to batch the parent updates.
+ *
+ *  If DerivedType is a DirtyTrackedChild and ParentType a DirtyChildTracker of it,
+ *  every increase also puts this on the parent's dirty list.
+ *
+ *  A custom Counter must increase() with a sequentially consistent RMW and load()
+ *  sequentially consistent too, or wait_changed() may miss a change.
  */
-template< typename DerivedType, typename ParentType = IncarnatedUnusedParent >
-class Incarnated {
+template< typename DerivedType, typename ParentType = IncarnatedUnusedParent, typename Counter = atomic_incarnation_counter >
+class Incarnated : private detail::incarnation_deferral<!std::is_same<ParentType, IncarnatedUnusedParent>::value> {
 
 	protected:
 		//! Note that this c'tor can throw but only std::bad_alloc, which all new can
@@ -40,7 +323,7 @@ class Incarnated {
 
 		//! Note that this c'tor can throw but only std::bad_alloc, which all new can
 		//! @throw std::bad_alloc when out of memory on first use
-		Incarnated(const ParentType *n_parent)
+		Incarnated(ParentType *n_parent)
 				: m_incarnation(0)
 				, m_parent(n_parent) {
 
@@ -51,7 +334,7 @@ class Incarnated {
 		 *   at creation time
 		 */
 		Incarnated(const Incarnated &n_other)
-				: m_incarnation(n_other.m_incarnation) {
+				: m_incarnation(n_other.incarnation()) {
 		}
 
 		~Incarnated() noexcept = default;
@@ -59,9 +342,9 @@ class Incarnated {
 		/*! @brief hand in a parent object.
 			Without it the class will assert when increasing inc
 		 */
-		void set_parent(const ParentType *n_parent) {
+		void set_parent(ParentType *n_parent) {
 
-			m_parent(n_parent);
+			m_parent = n_parent;
 			MOOSE_ASSERT(m_parent);
 		}
 
@@ -78,28 +361,111 @@ class Incarnated {
 			return increase_incarnation_impl(typename boost::is_same<ParentType, IncarnatedUnusedParent>::type());
 		}
 	
+		/*! @brief increase only this object's incarnation, not the parent's
+		 *
+		 *  The parent catches up on the next propagate_incarnation(), so it sees
+		 *  one increase per batch rather than one per modification.
+		 *  Without a parent this is the same as increase_incarnation().
+		 */
+		void increase_incarnation_deferred() noexcept {
+
+			m_incarnation.increase();
+			if constexpr (!std::is_same<ParentType, IncarnatedUnusedParent>::value) {
+				this->m_deferred.fetch_add(1, std::memory_order_relaxed);
+			}
+			notify_waiters();
+			mark_dirty_in_parent();
+		}
+
+		/*! @brief increase the parent's incarnation once if there were deferred increases since last time
+		 *  @return true if the parent was increased
+		 */
+		bool propagate_incarnation() noexcept {
+
+			return propagate_incarnation_impl(typename boost::is_same<ParentType, IncarnatedUnusedParent>::type());
+		}
+
 		bool changed(const boost::uint64_t n_known_incarnation) const noexcept {
 		
 			return (m_incarnation.load() > n_known_incarnation);
 		}
 
+		/*! @brief block the calling thread until the incarnation is higher than n_known_incarnation
+
+			Waiting threads park on a shared table of condition variables rather than
+			spinning. Writers only touch it when somebody waits in their bucket of it.
+			For asio based code use async_wait_changed() in IncarnationWait.hpp instead.
+			@return true when changed, false on timeout
+		 */
+		bool wait_changed(const boost::uint64_t n_known_incarnation, const std::chrono::steady_clock::duration n_timeout) const {
+
+			if (changed(n_known_incarnation)) {
+				return true;
+			}
+
+			return detail::incarnation_wait(this, [this, n_known_incarnation]() noexcept {
+						return changed(n_known_incarnation);
+					}, std::chrono::steady_clock::now() + n_timeout);
+		}
+
 	private:
 
 		//! This implementation is for classes that didn't specify a parent type
 		inline void increase_incarnation_impl(boost::true_type) noexcept {
 
-			++m_incarnation;
+			m_incarnation.increase();
+			notify_waiters();
 		}
 
 		//! This implementation is for classes which did specify a parent type
 		inline void increase_incarnation_impl(boost::false_type) noexcept {
 
 			MOOSE_ASSERT(m_parent);
-			++m_incarnation;
+			m_incarnation.increase();
+			notify_waiters();
+			// before the parent's increase so whoever sees that also finds us on the list
+			mark_dirty_in_parent();
 			m_parent->increase_incarnation();
 		}
 
-		std::atomic<boost::uint64_t>  m_incarnation;
+		inline void mark_dirty_in_parent() noexcept {
+
+			if constexpr (std::is_base_of<DirtyChildTracker<DerivedType>, ParentType>::value) {
+				static_assert(std::is_base_of<DirtyTrackedChild<DerivedType>, DerivedType>::value,
+						"parent tracks dirty children, derive the child from DirtyTrackedChild");
+				MOOSE_ASSERT(m_parent);
+				static_cast<DerivedType *>(this)->mark_dirty(*m_parent);
+			}
+		}
+
+		//! The counter's increase and this load are seq_cst, just like the waiter's registration
+		//! and its check of the counter. So either the waiter sees the new incarnation or we see
+		//! the waiter. No fence needed, so writers pay nothing extra when nobody waits in our bucket.
+		inline void notify_waiters() const noexcept {
+
+			if (detail::incarnation_waiters[detail::incarnation_bucket_index(this)].m_count.load(std::memory_order_seq_cst)) {
+				detail::incarnation_notify(this);
+			}
+		}
+
+		inline bool propagate_incarnation_impl(boost::true_type) noexcept {
+
+			return false;
+		}
+
+		inline bool propagate_incarnation_impl(boost::false_type) noexcept {
+
+			MOOSE_ASSERT(m_parent);
+
+			// Only one of several concurrent propagators sees the pending count
+			if (this->m_deferred.load(std::memory_order_relaxed) && this->m_deferred.exchange(0, std::memory_order_relaxed)) {
+				m_parent->increase_incarnation();
+				return true;
+			}
+			return false;
+		}
+
+		Counter                       m_incarnation;
 		ParentType                   *m_parent = nullptr;
 };
 
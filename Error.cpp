@@ -5,46 +5,461 @@
 
 #include "Error.hpp"
 
-#include <boost/spirit/include/karma.hpp>
-#include <boost/spirit/home/karma/numeric/real_policies.hpp>
-#include <boost/thread/tss.hpp>
-#include <boost/core/ignore_unused.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
 
 namespace moose {
 namespace tools {
 
 //----------------------------------------------------------------------------------------------------------------------
 namespace {
-	boost::thread_specific_ptr<std::string> tls_error_message;
 
-	inline std::string* get_tls_error_message() {
-		if (!tls_error_message.get()) {
-			tls_error_message.reset(new std::string{});
-		}
-		return tls_error_message.get();
+	struct last_error_entry {
+
+		std::chrono::system_clock::time_point  m_when;
+		std::size_t                            m_length;
+		char                                   m_message[last_error_capacity];
+	};
+
+	//! trivially destructible so threads don't register a destructor for it
+	struct last_error_ring {
+
+		last_error_entry  m_entries[last_error_history];
+		std::size_t       m_next;   //!< where the next one goes
+		std::size_t       m_count;  //!< used entries
+	};
+
+	thread_local last_error_ring tls_last_errors;
+
+	inline const last_error_entry &last_error_at(const last_error_ring &n_ring, const std::size_t n_age) noexcept {
+
+		return n_ring.m_entries[(n_ring.m_next + last_error_history - 1 - n_age) % last_error_history];
 	}
 } // namespace
 
 //----------------------------------------------------------------------------------------------------------------------
 std::string get_last_error() {
-	return *get_tls_error_message();
+	return std::string(last_error());
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::string_view last_error() noexcept {
+
+	const last_error_ring &ring = tls_last_errors;
+	if (!ring.m_count) {
+		return std::string_view();
+	}
+
+	const last_error_entry &e = last_error_at(ring, 0);
+	return std::string_view(e.m_message, e.m_length);
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-void set_last_error(const std::string& n_error_message) {
-	*get_tls_error_message() = n_error_message;
+void set_last_error(const std::string_view n_error_message) noexcept {
+
+	last_error_ring &ring = tls_last_errors;
+	last_error_entry &e = ring.m_entries[ring.m_next];
+	e.m_when = std::chrono::system_clock::now();
+	e.m_length = std::min(n_error_message.size(), last_error_capacity);
+	std::memcpy(e.m_message, n_error_message.data(), e.m_length);
+
+	ring.m_next = (ring.m_next + 1) % last_error_history;
+	ring.m_count = std::min(ring.m_count + 1, last_error_history);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<recent_error> recent_errors() {
+
+	const last_error_ring &ring = tls_last_errors;
+	std::vector<recent_error> ret;
+	ret.reserve(ring.m_count);
+	for (std::size_t i = 0; i < ring.m_count; ++i) {
+		const last_error_entry &e = last_error_at(ring, i);
+		ret.push_back({ e.m_when, std::string(e.m_message, e.m_length) });
+	}
+	return ret;
+}
+
+namespace {
+
+	std::atomic<unsigned int> error_backtrace_every{ 0 };
+
+	//! per thread so sampling doesn't make all throwing threads contend
+	thread_local unsigned int error_backtrace_countdown = 0;
+
+	inline bool error_backtrace_sampled() noexcept {
+
+		const unsigned int every = error_backtrace_every.load(std::memory_order_relaxed);
+		if (!every) {
+			return false;
+		}
+
+		if (++error_backtrace_countdown >= every) {
+			error_backtrace_countdown = 0;
+			return true;
+		}
+		return false;
+	}
+}
+
+void set_error_backtrace_sampling(const unsigned int n_every) noexcept {
+
+	error_backtrace_every.store(n_every, std::memory_order_relaxed);
+}
+
+boost::stacktrace::stacktrace raw_backtrace::resolve() const {
+
+	return boost::stacktrace::stacktrace::from_dump(m_frames, m_size * sizeof(boost::stacktrace::frame::native_frame_ptr_t));
 }
 
-moose_error::moose_error() {
+std::ostream &operator<<(std::ostream &n_stream, const raw_backtrace &n_backtrace) {
+
+	return n_stream << n_backtrace.resolve();
+}
+
+namespace {
+
+	inline void error_count_bump(std::atomic<boost::uint64_t> &n_counter) noexcept {
+
+		n_counter.store(n_counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	struct error_site_key {
+
+		const char  *m_file;
+		unsigned int m_line;
+		error_kind   m_kind;
+
+		bool operator==(const error_site_key &n_other) const noexcept {
+
+			return (m_file == n_other.m_file) && (m_line == n_other.m_line) && (m_kind == n_other.m_kind);
+		}
+	};
+
+	struct error_site_key_hash {
+
+		std::size_t operator()(const error_site_key &n_key) const noexcept {
+
+			return std::hash<const void *>()(n_key.m_file) ^ (static_cast<std::size_t>(n_key.m_line) << 4) ^ static_cast<std::size_t>(n_key.m_kind);
+		}
+	};
+
+	struct error_site_counter {
+
+		std::atomic<boost::uint64_t> m_count{ 0 };
+	};
+
+	/*! One per thread, only the owner counts. It only locks to insert new sites
+		so a concurrent snapshot doesn't iterate a changing map.
+	 */
+	struct error_count_buffer {
+
+		std::mutex                                                                      m_mutex;
+		std::atomic<boost::uint64_t>                                                    m_kinds[error_kind_count] = {};
+		std::unordered_map<error_site_key, error_site_counter, error_site_key_hash>     m_sites;
+	};
+
+	/*! Buffers of running threads plus the sum of those that ended, so
+		short lived threads don't make this grow. Lock before any buffer.
+	 */
+	struct error_count_registry {
+
+		std::mutex                                                                  m_mutex;
+		std::vector<error_count_buffer *>                                           m_buffers;
+		boost::uint64_t                                                             m_retired_kinds[error_kind_count] = {};
+		std::unordered_map<error_site_key, boost::uint64_t, error_site_key_hash>    m_retired_sites;
+	};
+
+	error_count_registry &error_count_buffers() {
+
+		static error_count_registry registry;
+		return registry;
+	}
+
+	//! hands the counts over to the registry when its thread ends
+	struct error_count_buffer_owner {
+
+		std::unique_ptr<error_count_buffer>  m_buffer;
+
+		~error_count_buffer_owner() noexcept {
+
+			if (!m_buffer) {
+				return;
+			}
+
+			error_count_registry &registry = error_count_buffers();
+			std::lock_guard<std::mutex> rlock(registry.m_mutex);
+			registry.m_buffers.erase(std::find(registry.m_buffers.begin(), registry.m_buffers.end(), m_buffer.get()));
+
+			for (std::size_t k = 0; k < error_kind_count; ++k) {
+				registry.m_retired_kinds[k] += m_buffer->m_kinds[k].load(std::memory_order_relaxed);
+			}
+
+			try {
+				for (const auto &site : m_buffer->m_sites) {
+					registry.m_retired_sites[site.first] += site.second.m_count.load(std::memory_order_relaxed);
+				}
+			} catch (...) {
+				// Out of memory. The sites are lost but the kinds are in
+			}
+		}
+	};
+
+	error_count_buffer &local_error_count_buffer() {
+
+		thread_local error_count_buffer_owner owner;
+		if (!owner.m_buffer) {
+			std::unique_ptr<error_count_buffer> buffer = std::make_unique<error_count_buffer>();
+			error_count_registry &registry = error_count_buffers();
+			std::lock_guard<std::mutex> slock(registry.m_mutex);
+			registry.m_buffers.push_back(buffer.get());
+			owner.m_buffer = std::move(buffer);
+		}
+		return *owner.m_buffer;
+	}
+
+	void count_error(const error_kind n_kind, const char *n_file, const unsigned int n_line) noexcept {
+
+		try {
+			error_count_buffer &buffer = local_error_count_buffer();
+			error_count_bump(buffer.m_kinds[static_cast<std::size_t>(n_kind)]);
+
+			const error_site_key key{ n_file ? n_file : "", n_line, n_kind };
+			auto i = buffer.m_sites.find(key);
+			if (i == buffer.m_sites.end()) {
+				std::lock_guard<std::mutex> slock(buffer.m_mutex);
+				i = buffer.m_sites.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple()).first;
+			}
+			error_count_bump(i->second.m_count);
+		} catch (...) {
+			// Out of memory while creating an error. Not counting is the least of my problems
+		}
+	}
+}
+
+error_statistics error_stats() {
+
+	error_statistics ret;
+	ret.taken = std::chrono::steady_clock::now();
+
+	// Held throughout so no thread hands its counts over while I'm adding them up
+	error_count_registry &registry = error_count_buffers();
+	std::unique_lock<std::mutex> rlock(registry.m_mutex);
+
+	// the same site from all threads ends up in one
+	std::unordered_map<error_site_key, boost::uint64_t, error_site_key_hash> sites(registry.m_retired_sites);
+	for (std::size_t k = 0; k < error_kind_count; ++k) {
+		ret.by_kind[k] = registry.m_retired_kinds[k];
+	}
+
+	for (error_count_buffer *buffer : registry.m_buffers) {
+		std::lock_guard<std::mutex> slock(buffer->m_mutex);
+		for (std::size_t k = 0; k < error_kind_count; ++k) {
+			ret.by_kind[k] += buffer->m_kinds[k].load(std::memory_order_relaxed);
+		}
+		for (const auto &site : buffer->m_sites) {
+			sites[site.first] += site.second.m_count.load(std::memory_order_relaxed);
+		}
+	}
+	rlock.unlock();
+
+	ret.sites.reserve(sites.size());
+	for (const auto &site : sites) {
+		if (site.second) {
+			ret.sites.push_back({ site.first.m_kind, site.first.m_file, site.first.m_line, site.second });
+		}
+	}
+
+	// Sites are told apart by the file pointer. One in a header has a pointer per
+	// translation unit it is inlined into, so these are merged by file name here.
+	std::sort(ret.sites.begin(), ret.sites.end(), [](const error_site_count &n_lhs, const error_site_count &n_rhs) {
+		return std::tie(n_lhs.kind, n_lhs.line, n_lhs.file) < std::tie(n_rhs.kind, n_rhs.line, n_rhs.file);
+	});
+	std::vector<error_site_count>::iterator merged = ret.sites.begin();
+	for (std::vector<error_site_count>::iterator i = ret.sites.begin(); i != ret.sites.end(); ++i) {
+		if (i == merged) {
+			continue;
+		}
+		if ((i->kind == merged->kind) && (i->line == merged->line) && (i->file == merged->file)) {
+			merged->count += i->count;
+		} else if (++merged != i) {
+			*merged = std::move(*i);
+		}
+	}
+	if (merged != ret.sites.end()) {
+		ret.sites.erase(merged + 1, ret.sites.end());
+	}
+
+	std::sort(ret.sites.begin(), ret.sites.end(), [](const error_site_count &n_lhs, const error_site_count &n_rhs) {
+		return n_lhs.count > n_rhs.count;
+	});
+
+	return ret;
+}
+
+void reset_error_stats() noexcept {
+
+	error_count_registry &registry = error_count_buffers();
+	std::lock_guard<std::mutex> rlock(registry.m_mutex);
+	for (std::size_t k = 0; k < error_kind_count; ++k) {
+		registry.m_retired_kinds[k] = 0;
+	}
+	registry.m_retired_sites.clear();
+
+	for (error_count_buffer *buffer : registry.m_buffers) {
+		std::lock_guard<std::mutex> slock(buffer->m_mutex);
+		for (std::size_t k = 0; k < error_kind_count; ++k) {
+			buffer->m_kinds[k].store(0, std::memory_order_relaxed);
+		}
+		for (auto &site : buffer->m_sites) {
+			site.second.m_count.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+double error_rate(const error_statistics &n_earlier, const error_statistics &n_later, const error_kind n_kind) noexcept {
+
+	const std::chrono::duration<double> elapsed = n_later.taken - n_earlier.taken;
+	if ((elapsed.count() <= 0.0) || (n_later.count(n_kind) < n_earlier.count(n_kind))) {
+		return 0.0;
+	}
+
+	return static_cast<double>(n_later.count(n_kind) - n_earlier.count(n_kind)) / elapsed.count();
+}
+
+namespace {
+
+	/*! @brief tell if a location is inside boost's exception wrappers
+
+		Default arguments are evaluated where the c'tor is called, for a virtual base
+		that is the most derived class's c'tor. So the location alone tells
+		boost::wrapexcept (boost/throw_exception.hpp) or, in boost before 1.73,
+		clone_impl (boost/exception/exception.hpp) apart, on every compiler.
+	 */
+	bool boost_wrapper_location(const char *n_file) noexcept {
+
+		if (!n_file) {
+			return false;
+		}
+
+		const std::string_view file(n_file);
+		for (const std::string_view wrapper : { std::string_view("boost/throw_exception.hpp"), std::string_view("boost/exception/exception.hpp") }) {
+			if (file.size() < wrapper.size()) {
+				continue;
+			}
+
+			// Windows paths may come with either separator
+			if (std::equal(wrapper.rbegin(), wrapper.rend(), file.rbegin(), [](const char n_wrapper, const char n_file) {
+					return (n_wrapper == n_file) || ((n_wrapper == '/') && (n_file == '\\'));
+				})) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	//! not inlined so both c'tors skip the same number of frames
+	BOOST_NOINLINE void init_error(moose_error &n_error, const error_kind n_kind, const char *n_file, const unsigned int n_line) {
+
+		count_error(n_kind, n_file, n_line);
 
 #if defined(MOOSE_DEBUG)
-	// inject stacktrace for every error
-	*this << error_stacktrace(boost::stacktrace::stacktrace{});
+		// inject stacktrace for every error
+		n_error << error_stacktrace(boost::stacktrace::stacktrace{});
+#else
+		if (error_backtrace_sampled()) {
+			raw_backtrace backtrace;
+			// skipping this and the c'tors. The count includes a null at the end
+			const std::size_t stored = boost::stacktrace::safe_dump_to(3, backtrace.m_frames, sizeof(backtrace.m_frames));
+			backtrace.m_size = stored ? stored - 1 : 0;
+			n_error << error_backtrace(backtrace);
+		}
 #endif
+	}
+}
+
+moose_error::moose_error(const char *n_file, const unsigned int n_line) {
+
+	// BOOST_THROW_EXCEPTION's wrapper is the most derived class of what it throws and so
+	// initializes me again, for an error that was counted when it was created
+	if (boost_wrapper_location(n_file)) {
+		return;
+	}
+
+	init_error(*this, error_kind::generic, n_file, n_line);
+}
+
+moose_error::moose_error(const error_kind n_kind, const char *n_file, const unsigned int n_line) {
+
+	init_error(*this, n_kind, n_file, n_line);
+}
+
+unit_test_error::unit_test_error(const char *n_file, const unsigned int n_line)
+		: moose_error(error_kind::unit_test, n_file, n_line) {
+}
+
+protocol_error::protocol_error(const char *n_file, const unsigned int n_line)
+		: moose_error(error_kind::protocol, n_file, n_line) {
+}
+
+internal_error::internal_error(const char *n_file, const unsigned int n_line)
+		: moose_error(error_kind::internal, n_file, n_line) {
+}
+
+ui_error::ui_error(const char *n_file, const unsigned int n_line)
+		: moose_error(error_kind::ui, n_file, n_line) {
+}
+
+io_error::io_error(const char *n_file, const unsigned int n_line)
+		: moose_error(error_kind::io, n_file, n_line) {
+}
+
+serialization_error::serialization_error(const char *n_file, const unsigned int n_line)
+		: moose_error(error_kind::serialization, n_file, n_line) {
+}
+
+file_error::file_error(const char *n_file, const unsigned int n_line)
+		: moose_error(error_kind::file, n_file, n_line) {
+}
+
+network_error::network_error(const char *n_file, const unsigned int n_line)
+		: moose_error(error_kind::network, n_file, n_line) {
+}
+
+namespace detail {
+
+std::string format_error_argument(const long long n_value) {
+
+	char buffer[24];
+	const std::to_chars_result r = std::to_chars(buffer, buffer + sizeof(buffer), n_value);
+	return std::string(buffer, r.ptr);
+}
+
+std::string format_error_argument(const unsigned long long n_value) {
+
+	char buffer[24];
+	const std::to_chars_result r = std::to_chars(buffer, buffer + sizeof(buffer), n_value);
+	return std::string(buffer, r.ptr);
+}
+
+std::string format_error_argument(const double n_value) {
+
+	char buffer[32];
+	const std::to_chars_result r = std::to_chars(buffer, buffer + sizeof(buffer), n_value, std::chars_format::scientific, 15);
+	return std::string(buffer, r.ptr);
 }
 
-namespace karma = boost::spirit::karma;
-namespace ascii = boost::spirit::ascii;
+} // namespace detail
 
 error_argument::error_argument(const char *n_string)
 		: error_argument_type(n_string) {
@@ -54,97 +469,161 @@ error_argument::error_argument(const std::string &n_string)
 		: error_argument_type(n_string) {
 }
 
-// define a new real number formatting policy
-template <typename Num>
-struct scientific_policy : karma::real_policies<Num> {
+error_argument::error_argument(const std::string_view n_string)
+		: error_argument_type(std::string(n_string)) {
+}
 
-	// we want the numbers always to be in scientific format
-	static int floatfield(Num n) {
-		
-		boost::ignore_unused(n);
-		return karma::real_policies<Num>::fmtflags::scientific;
-	}
+namespace {
 
-	static unsigned int precision(Num n) {
+	//! try if n_something holds a T and format it if so
+	template< typename T >
+	bool format_any_error_argument(const boost::any &n_something, std::string &n_target) {
 
-		boost::ignore_unused(n);
-		return 15;
-	};
-};
+		if (const T *value = boost::any_cast<T>(&n_something)) {
+			n_target = detail::format_error_argument_value(*value);
+			return true;
+		}
+		return false;
+	}
+}
 
 error_argument::error_argument(const boost::any &n_something)
 		: error_argument_type("<cannot determine argument type>") {
 
-	if (n_something.type() == typeid(unsigned int)) {
-		std::back_insert_iterator<std::string> out(value());
-		karma::generate(out, karma::uint_, boost::any_cast<unsigned int>(n_something));
-		// don't care if that fails nothing I could do anyway except allocate more mem
-	} else if (n_something.type() == typeid(int)) {
-		std::back_insert_iterator<std::string> out(value());
-		karma::generate(out, karma::int_, boost::any_cast<int>(n_something));
-	} else if (n_something.type() == typeid(double)) {
-		// define a new generator type based on the new policy
-		using science_type = karma::real_generator<double, scientific_policy<double> >;
-		science_type const scientific = science_type();
-		std::back_insert_iterator<std::string> out(value());
-		karma::generate(out, scientific, boost::any_cast<double>(n_something));
-	} else if (n_something.type() == typeid(float)) {
-		// define a new generator type based on the new policy
-		using science_type = karma::real_generator<float, scientific_policy<float> >;
-		science_type const scientific = science_type();
-		std::back_insert_iterator<std::string> out(value());
-		karma::generate(out, scientific, boost::any_cast<float>(n_something));
-	}
+	std::string &v = value();
+	format_any_error_argument<int>(n_something, v)
+		|| format_any_error_argument<unsigned int>(n_something, v)
+		|| format_any_error_argument<long>(n_something, v)
+		|| format_any_error_argument<unsigned long>(n_something, v)
+		|| format_any_error_argument<long long>(n_something, v)
+		|| format_any_error_argument<unsigned long long>(n_something, v)
+		|| format_any_error_argument<short>(n_something, v)
+		|| format_any_error_argument<unsigned short>(n_something, v)
+		|| format_any_error_argument<double>(n_something, v)
+		|| format_any_error_argument<float>(n_something, v)
+		|| format_any_error_argument<bool>(n_something, v);
 }
 
 error_argument::~error_argument() noexcept {
 
 }
 
+const char *error_kind_name(const error_kind n_kind) noexcept {
+
+	switch (n_kind) {
+		case error_kind::none:
+			return "No error";
+		case error_kind::generic:
+			return "Generic error";
+		case error_kind::unit_test:
+			return "Unit Test specific error";
+		case error_kind::protocol:
+			return "Protocol implementation error";
+		case error_kind::internal:
+			return "Internal error";
+		case error_kind::ui:
+			return "UI setup error";
+		case error_kind::io:
+			return "Generic I/O error";
+		case error_kind::serialization:
+			return "Serialization error";
+		case error_kind::file:
+			return "Filesystem error";
+		case error_kind::network:
+			return "Network error";
+	}
+	return "Unknown error";
+}
+
 char const * moose_error::what() const noexcept {
 
 	return "Generic error";
 }
 
+error_kind moose_error::kind() const noexcept {
+
+	return error_kind::generic;
+}
+
 char const * unit_test_error::what() const noexcept {
 
 	return "Unit Test specific error";
 }
 
+error_kind unit_test_error::kind() const noexcept {
+
+	return error_kind::unit_test;
+}
+
 char const * protocol_error::what() const noexcept {
 
 	return "Protocol implementation error";
 }
 
+error_kind protocol_error::kind() const noexcept {
+
+	return error_kind::protocol;
+}
+
 char const * internal_error::what() const noexcept {
 
 	return "Internal error";
 }
 
+error_kind internal_error::kind() const noexcept {
+
+	return error_kind::internal;
+}
+
 char const * ui_error::what() const noexcept {
 
 	return "UI setup error";
 }
 
+error_kind ui_error::kind() const noexcept {
+
+	return error_kind::ui;
+}
+
 char const * io_error::what() const noexcept {
 
 	return "Generic I/O error";
 }
 
+error_kind io_error::kind() const noexcept {
+
+	return error_kind::io;
+}
+
 char const * serialization_error::what() const noexcept {
 
 	return "Serialization error";
 }
 
+error_kind serialization_error::kind() const noexcept {
+
+	return error_kind::serialization;
+}
+
 char const * file_error::what() const noexcept {
 
 	return "Filesystem error";
 }
 
+error_kind file_error::kind() const noexcept {
+
+	return error_kind::file;
+}
+
 char const * network_error::what() const noexcept {
 
 	return "Network error";
 }
 
+error_kind network_error::kind() const noexcept {
+
+	return error_kind::network;
+}
+
 }
 }
@@ -18,21 +18,92 @@
 #endif
 #include <boost/stacktrace.hpp>
 
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
 #include <string>
+#include <string_view>
 #include <sstream>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace moose {
 namespace tools {
 
+//! The categories of the exception hierarchy below, for non-throwing error reporting
+enum class error_kind : boost::uint8_t {
+	none = 0,       //!< no error
+	generic,        //!< moose_error
+	unit_test,      //!< unit_test_error
+	protocol,       //!< protocol_error
+	internal,       //!< internal_error
+	ui,             //!< ui_error
+	io,             //!< io_error
+	serialization,  //!< serialization_error
+	file,           //!< file_error
+	network         //!< network_error
+};
+
+//! number of error_kind values, including none
+const std::size_t error_kind_count = 10;
+
+//! the same as what() of the respective exception says
+MOOSE_TOOLS_API const char *error_kind_name(const error_kind n_kind) noexcept;
+
+//! longer last error messages are cut
+const std::size_t last_error_capacity = 256;
+
+//! how many last errors each thread remembers
+const std::size_t last_error_history = 8;
+
+//! @return a copy of the calling thread's last error, empty if none
 MOOSE_TOOLS_API std::string get_last_error();
-MOOSE_TOOLS_API void set_last_error(const std::string &n_error_message);
+
+/*! @return the calling thread's last error, empty if none
+	The view remains valid until the thread sets the next one
+ */
+MOOSE_TOOLS_API std::string_view last_error() noexcept;
+
+/*! @brief set the calling thread's last error, for C style APIs
+	Doesn't allocate. Messages longer than last_error_capacity are cut.
+ */
+MOOSE_TOOLS_API void set_last_error(const std::string_view n_error_message) noexcept;
+
+struct recent_error {
+
+	std::chrono::system_clock::time_point  when;
+	std::string                            message;
+};
+
+//! @return the calling thread's last errors with their time, newest first
+MOOSE_TOOLS_API std::vector<recent_error> recent_errors();
 	
+/*! @brief base of all our exceptions
+
+	Every construction of the subclasses below is counted per kind and source
+	location, see error_stats(). The location is where the exception object was
+	created, which in the usual BOOST_THROW_EXCEPTION(network_error() << ...)
+	is the throw site.
+	As virtual base moose_error is initialized by the most derived class only, so
+	that alone decides what is counted. Classes not passing a kind, such as
+	moose_error itself or subclasses defined elsewhere, count as error_kind::generic.
+	Copies, like the one BOOST_THROW_EXCEPTION's wrapper makes, are not counted. The
+	wrapper is recognized by the location it initializes moose_error from.
+ */
 struct MOOSE_TOOLS_API moose_error: virtual std::exception, virtual boost::exception {
 
 	public:
-		MOOSE_TOOLS_API moose_error();
+		MOOSE_TOOLS_API moose_error(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE());
 		MOOSE_TOOLS_API virtual char const *what() const noexcept override;
 		MOOSE_TOOLS_API virtual ~moose_error() noexcept { }
+
+		MOOSE_TOOLS_API virtual error_kind kind() const noexcept;
+
+	protected:
+		//! for subclasses to be counted
+		MOOSE_TOOLS_API moose_error(const error_kind n_kind, const char *n_file, const unsigned int n_line);
 };
 
 
@@ -40,49 +111,65 @@ struct MOOSE_TOOLS_API moose_error: virtual std::exception, virtual boost::excep
 //! for separation of test specific exceptions and 'real' ones
 struct MOOSE_TOOLS_API unit_test_error : virtual moose_error {
 	
+	MOOSE_TOOLS_API unit_test_error(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE());
 	MOOSE_TOOLS_API virtual char const *what() const noexcept override;
+	MOOSE_TOOLS_API virtual error_kind kind() const noexcept override;
 };
 
 //! Some component violated protocol specifications and talked BS
 struct MOOSE_TOOLS_API protocol_error : virtual moose_error {
 
+	MOOSE_TOOLS_API protocol_error(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE());
 	MOOSE_TOOLS_API virtual char const *what() const noexcept override;
+	MOOSE_TOOLS_API virtual error_kind kind() const noexcept override;
 };
 
 //! Unspecified internal fuckup
 struct MOOSE_TOOLS_API internal_error : virtual moose_error {
 	
+	MOOSE_TOOLS_API internal_error(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE());
 	MOOSE_TOOLS_API virtual char const *what() const noexcept override;
+	MOOSE_TOOLS_API virtual error_kind kind() const noexcept override;
 };
 
 //! UI structuring internal error
 struct MOOSE_TOOLS_API ui_error : virtual internal_error {
 
+	MOOSE_TOOLS_API ui_error(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE());
 	MOOSE_TOOLS_API virtual char const *what() const noexcept override;
+	MOOSE_TOOLS_API virtual error_kind kind() const noexcept override;
 };
 
 //! Generic IO error
 struct MOOSE_TOOLS_API io_error : virtual moose_error {
 
+	MOOSE_TOOLS_API io_error(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE());
 	MOOSE_TOOLS_API virtual char const *what() const noexcept override;
+	MOOSE_TOOLS_API virtual error_kind kind() const noexcept override;
 };
 
 //! Serialization failed (not impl specific)
 struct MOOSE_TOOLS_API serialization_error : virtual io_error {
 
+	MOOSE_TOOLS_API serialization_error(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE());
 	MOOSE_TOOLS_API virtual char const *what() const noexcept override;
+	MOOSE_TOOLS_API virtual error_kind kind() const noexcept override;
 };
 
 //! Disk IO failed
 struct MOOSE_TOOLS_API file_error : virtual io_error {
 
+	MOOSE_TOOLS_API file_error(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE());
 	MOOSE_TOOLS_API virtual char const *what() const noexcept override;
+	MOOSE_TOOLS_API virtual error_kind kind() const noexcept override;
 };
 
 //! Network IO failed
 struct MOOSE_TOOLS_API network_error : virtual io_error {
 
+	MOOSE_TOOLS_API network_error(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE());
 	MOOSE_TOOLS_API virtual char const *what() const noexcept override;
+	MOOSE_TOOLS_API virtual error_kind kind() const noexcept override;
 };
 
 
@@ -107,14 +194,165 @@ using error_argument_type = boost::error_info<struct tag_error_argument, std::st
 //! tag exceptions with stacktrace info
 using error_stacktrace = boost::error_info<struct tag_stacktrace_dump, boost::stacktrace::stacktrace>;
 
-//! Must be convertible from all sorts of stuff
+/*! @brief return addresses of where an error was created
+
+	Capturing these is cheap compared to a full stacktrace as nothing is
+	looked up. Symbols are only resolved when it is printed, for example
+	by boost::diagnostic_information().
+ */
+struct MOOSE_TOOLS_API raw_backtrace {
+
+	//! including a terminating null
+	static constexpr std::size_t max_frames = 32;
+
+	std::size_t                                     m_size = 0;
+	boost::stacktrace::frame::native_frame_ptr_t    m_frames[max_frames] = {};
+
+	//! resolve all symbols
+	MOOSE_TOOLS_API boost::stacktrace::stacktrace resolve() const;
+};
+
+//! symbolizes, so it's slow
+MOOSE_TOOLS_API std::ostream &operator<<(std::ostream &n_stream, const raw_backtrace &n_backtrace);
+
+//! tag exceptions with a raw backtrace, see set_error_backtrace_sampling()
+using error_backtrace = boost::error_info<struct tag_error_backtrace, raw_backtrace>;
+
+/*! @brief attach a raw backtrace to every n-th moose_error created in each thread
+
+	0 switches it off, which is the default, 1 gives one to all.
+	Cheap enough to keep on in production with a rate of 100 or so.
+	Builds with MOOSE_DEBUG ignore this as they attach a full error_stacktrace to all.
+ */
+MOOSE_TOOLS_API void set_error_backtrace_sampling(const unsigned int n_every) noexcept;
+
+//! how often one place created errors of one kind
+struct error_site_count {
+
+	error_kind       kind = error_kind::none;
+	std::string      file;
+	unsigned int     line = 0;
+	boost::uint64_t  count = 0;
+};
+
+//! errors created since start or reset_error_stats()
+struct error_statistics {
+
+	std::chrono::steady_clock::time_point          taken;
+	std::array<boost::uint64_t, error_kind_count>  by_kind = {};  //!< indexed by error_kind
+	std::vector<error_site_count>                  sites;         //!< most frequent first
+
+	boost::uint64_t count(const error_kind n_kind) const noexcept {
+
+		return by_kind[static_cast<std::size_t>(n_kind)];
+	}
+
+	boost::uint64_t total() const noexcept {
+
+		boost::uint64_t ret = 0;
+		for (const boost::uint64_t c : by_kind) {
+			ret += c;
+		}
+		return ret;
+	}
+};
+
+/*! @brief sum up the error counts of all threads
+
+	Counting happens in per-thread buffers without shared writes, so it's
+	cheap compared to throwing and always on. Take two of these to get rates.
+ */
+MOOSE_TOOLS_API error_statistics error_stats();
+
+//! Counts of threads creating errors at the same time may survive this
+MOOSE_TOOLS_API void reset_error_stats() noexcept;
+
+//! @return errors of n_kind per second between two snapshots
+MOOSE_TOOLS_API double error_rate(const error_statistics &n_earlier, const error_statistics &n_later, const error_kind n_kind) noexcept;
+
+namespace detail {
+
+MOOSE_TOOLS_API std::string format_error_argument(const long long n_value);
+MOOSE_TOOLS_API std::string format_error_argument(const unsigned long long n_value);
+
+//! scientific notation with 15 digits precision
+MOOSE_TOOLS_API std::string format_error_argument(const double n_value);
+
+//! arithmetic types and enums, formatted without any stream or allocation beyond the result
+template< typename T >
+std::string format_error_argument_value(const T n_value) {
+
+	if constexpr (std::is_enum<T>::value) {
+		// a number even if the underlying type is char or bool
+		if constexpr (std::is_signed<std::underlying_type_t<T> >::value) {
+			return format_error_argument(static_cast<long long>(n_value));
+		} else {
+			return format_error_argument(static_cast<unsigned long long>(n_value));
+		}
+	} else if constexpr (std::is_same<T, bool>::value) {
+		return n_value ? "true" : "false";
+	} else if constexpr (std::is_same<T, char>::value) {
+		return std::string(1, n_value);
+	} else if constexpr (std::is_floating_point<T>::value) {
+		return format_error_argument(static_cast<double>(n_value));
+	} else if constexpr (std::is_signed<T>::value) {
+		return format_error_argument(static_cast<long long>(n_value));
+	} else {
+		return format_error_argument(static_cast<unsigned long long>(n_value));
+	}
+}
+
+template< typename T, typename = void >
+struct is_error_streamable : std::false_type {};
+
+template< typename T >
+struct is_error_streamable< T, std::void_t<decltype(std::declval<std::ostream &>() << std::declval<const T &>())> > : std::true_type {};
+
+//! all else which can be written to a stream, like endpoints or uuids
+template< typename T >
+constexpr bool use_error_argument_stream = !std::is_arithmetic<T>::value && !std::is_enum<T>::value
+		&& !std::is_convertible<const T &, std::string>::value && !std::is_convertible<const T &, std::string_view>::value
+		&& !std::is_same<T, boost::any>::value && is_error_streamable<T>::value;
+
+} // namespace detail
+
+/*! @brief Must be convertible from all sorts of stuff
+
+	Numbers, bools and enums (as their underlying number) are formatted
+	right away without boxing them. Anything else with an operator<<
+	such as endpoints goes through a stream.
+ */
 struct MOOSE_TOOLS_API error_argument : error_argument_type {
 
 	public:
 		MOOSE_TOOLS_API explicit error_argument(const char *n_string);
 		MOOSE_TOOLS_API explicit error_argument(const std::string &n_string);
+		MOOSE_TOOLS_API explicit error_argument(const std::string_view n_string);
+
+		//! integers, floats, bools, chars and enums
+		template< typename T, typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value, int>::type = 0 >
+		explicit error_argument(const T n_value)
+				: error_argument_type(detail::format_error_argument_value(n_value)) {
+		}
+
+		//! whatever has an operator<<
+		template< typename T, typename std::enable_if<detail::use_error_argument_stream<T>, int>::type = 0 >
+		explicit error_argument(const T &n_value)
+				: error_argument_type(stream(n_value)) {
+		}
+
+		//! Only knows arithmetic types. Others become "<cannot determine argument type>"
 		MOOSE_TOOLS_API explicit error_argument(const boost::any &n_something);
 		MOOSE_TOOLS_API virtual ~error_argument() noexcept;
+
+	private:
+		template< typename T >
+		static std::string stream(const T &n_value) {
+
+			std::ostringstream oss;
+			oss << n_value;
+			return oss.str();
+		}
 };
 
 } // namespace tools
@@ -0,0 +1,61 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include "Expected.hpp"
+
+#include <string>
+
+namespace moose {
+namespace tools {
+
+namespace {
+
+	template< typename ErrorType >
+	[[noreturn]] void throw_compact_error_as(const compact_error &n_error, const char *n_file, const unsigned int n_line) {
+
+		// created with the caller's location so it's counted there, see error_stats()
+		ErrorType e(n_file, n_line);
+		e << error_message(std::string(n_error.message()));
+		if (n_error.code()) {
+			e << compact_error_code(n_error.code());
+		}
+		e << boost::throw_file(n_file) << boost::throw_line(static_cast<int>(n_line));
+		boost::throw_exception(e);
+	}
+}
+
+void throw_error(const compact_error &n_error, const char *n_file, const unsigned int n_line) {
+
+	switch (n_error.kind()) {
+		case error_kind::generic:
+			throw_compact_error_as<moose_error>(n_error, n_file, n_line);
+		case error_kind::unit_test:
+			throw_compact_error_as<unit_test_error>(n_error, n_file, n_line);
+		case error_kind::protocol:
+			throw_compact_error_as<protocol_error>(n_error, n_file, n_line);
+		case error_kind::internal:
+			throw_compact_error_as<internal_error>(n_error, n_file, n_line);
+		case error_kind::ui:
+			throw_compact_error_as<ui_error>(n_error, n_file, n_line);
+		case error_kind::io:
+			throw_compact_error_as<io_error>(n_error, n_file, n_line);
+		case error_kind::serialization:
+			throw_compact_error_as<serialization_error>(n_error, n_file, n_line);
+		case error_kind::file:
+			throw_compact_error_as<file_error>(n_error, n_file, n_line);
+		case error_kind::network:
+			throw_compact_error_as<network_error>(n_error, n_file, n_line);
+		case error_kind::none:
+			break;
+	}
+
+	BOOST_THROW_EXCEPTION(internal_error() << error_message("throw_error() called without an error"));
+}
+
+#if defined(BOOST_MSVC)
+void ExpectedGetRidOfLNK4221() {}
+#endif
+
+} // namespace tools
+} // namespace moose
@@ -0,0 +1,243 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+#include "MooseToolsConfig.hpp"
+#include "Error.hpp"
+
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace moose {
+namespace tools {
+
+//! tag exceptions with a compact_error's code, which is not necessarily an errno
+using compact_error_code = boost::error_info<struct tag_compact_error_code, int>;
+
+/*! @brief an error that fits in a cache line and never allocates
+
+	For paths where failure is common enough that throwing is too slow,
+	such as parsing untrusted input. The kind maps to the exception
+	hierarchy, see throw_error(). Messages longer than max_message are cut.
+ */
+class compact_error {
+
+	public:
+		static constexpr std::size_t max_message = 58;
+
+		//! no error
+		compact_error() noexcept
+				: m_code(0)
+				, m_kind(error_kind::none)
+				, m_length(0) {
+		}
+
+		compact_error(const error_kind n_kind, const std::string_view n_message, const int n_code = 0) noexcept
+				: m_code(n_code)
+				, m_kind(n_kind)
+				, m_length(static_cast<boost::uint8_t>(std::min(n_message.size(), max_message))) {
+
+			std::memcpy(m_message, n_message.data(), m_length);
+		}
+
+		error_kind kind() const noexcept {
+
+			return m_kind;
+		}
+
+		//! whatever the source deems helpful, like an errno or an enum value. 0 if not set
+		int code() const noexcept {
+
+			return m_code;
+		}
+
+		std::string_view message() const noexcept {
+
+			return std::string_view(m_message, m_length);
+		}
+
+		//! true if this is an error
+		explicit operator bool() const noexcept {
+
+			return m_kind != error_kind::none;
+		}
+
+	private:
+		int             m_code;
+		error_kind      m_kind;
+		boost::uint8_t  m_length;
+		char            m_message[max_message];
+};
+
+/*! @brief throw the exception matching n_error's kind
+
+	The message goes into error_message, a non-zero code into compact_error_code.
+	Not errno_code as many sources report their own codes, see endpoint_parse_error.
+	The exception is created, thrown and counted with the caller's location.
+	@throw always, internal_error for error_kind::none
+ */
+[[noreturn]] MOOSE_TOOLS_API void throw_error(const compact_error &n_error,
+		const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE());
+
+/*! @brief either a T or a compact_error
+
+	Like std::expected which is not yet there. Calling value() on an error
+	throws as throw_error() would, so callers who'd rather have an exception
+	can have one.
+
+	@code
+	const expected<udp::endpoint> ep = try_string_to_udp_endpoint(input);
+	if (!ep) {
+		BOOST_LOG_SEV(logger(), warning) << "ignoring " << ep.error().message();
+		return;
+	}
+	socket.send_to(buffer, *ep);
+	@endcode
+ */
+template< typename T >
+class expected {
+
+	static_assert(!std::is_same<std::decay_t<T>, compact_error>::value, "expected cannot hold an error as value");
+	static_assert(!std::is_reference<T>::value, "expected cannot hold references");
+
+	public:
+		using value_type = T;
+
+		expected(const T &n_value)
+				: m_storage(std::in_place_index<0>, n_value) {
+		}
+
+		expected(T &&n_value)
+				: m_storage(std::in_place_index<0>, std::move(n_value)) {
+		}
+
+		expected(const compact_error &n_error) noexcept
+				: m_storage(std::in_place_index<1>, n_error) {
+		}
+
+		bool has_value() const noexcept {
+
+			return m_storage.index() == 0;
+		}
+
+		explicit operator bool() const noexcept {
+
+			return has_value();
+		}
+
+		//! @throw what throw_error() throws if this is an error
+		T &value(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE()) & {
+
+			check(n_file, n_line);
+			return *std::get_if<0>(&m_storage);
+		}
+
+		const T &value(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE()) const & {
+
+			check(n_file, n_line);
+			return *std::get_if<0>(&m_storage);
+		}
+
+		T &&value(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE()) && {
+
+			check(n_file, n_line);
+			return std::move(*std::get_if<0>(&m_storage));
+		}
+
+		template< typename U >
+		T value_or(U &&n_default) const & {
+
+			return has_value() ? *std::get_if<0>(&m_storage) : static_cast<T>(std::forward<U>(n_default));
+		}
+
+		//! must have a value
+		T &operator*() noexcept {
+
+			return *std::get_if<0>(&m_storage);
+		}
+
+		const T &operator*() const noexcept {
+
+			return *std::get_if<0>(&m_storage);
+		}
+
+		T *operator->() noexcept {
+
+			return std::get_if<0>(&m_storage);
+		}
+
+		const T *operator->() const noexcept {
+
+			return std::get_if<0>(&m_storage);
+		}
+
+		//! no error if this has a value
+		compact_error error() const noexcept {
+
+			return has_value() ? compact_error() : *std::get_if<1>(&m_storage);
+		}
+
+	private:
+		void check(const char *n_file, const unsigned int n_line) const {
+
+			if (!has_value()) {
+				throw_error(*std::get_if<1>(&m_storage), n_file, n_line);
+			}
+		}
+
+		std::variant<T, compact_error> m_storage;
+};
+
+//! success or an error
+template<>
+class expected<void> {
+
+	public:
+		using value_type = void;
+
+		expected() noexcept = default;
+
+		expected(const compact_error &n_error) noexcept
+				: m_error(n_error) {
+		}
+
+		bool has_value() const noexcept {
+
+			return !m_error;
+		}
+
+		explicit operator bool() const noexcept {
+
+			return has_value();
+		}
+
+		//! @throw what throw_error() throws if this is an error
+		void value(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE()) const {
+
+			if (m_error) {
+				throw_error(m_error, n_file, n_line);
+			}
+		}
+
+		compact_error error() const noexcept {
+
+			return m_error;
+		}
+
+	private:
+		compact_error m_error;
+};
+
+#if defined(BOOST_MSVC)
+MOOSE_TOOLS_API void ExpectedGetRidOfLNK4221();
+#endif
+
+} // namespace tools
+} // namespace moose
@@ -7,8 +7,11 @@
 
 #include "MooseToolsConfig.hpp"
 #include "IdTagged.hpp"
+#include "BloomFilter.hpp"
 #include "Error.hpp"
+#include "Expected.hpp"
 #include "Carne.hpp"
+#include "Random.hpp"
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
@@ -16,16 +19,205 @@
 #include <boost/multi_index/random_access_index.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/type_traits/is_base_of.hpp>
+#include <boost/assert.hpp>
 #include <boost/static_assert.hpp>
 #include <boost/container/set.hpp>
 #include <boost/shared_container_iterator.hpp>
 #include <boost/iterator/iterator_facade.hpp>
 
 #include <memory>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <unordered_set>
+#include <vector>
 
 namespace moose {
 namespace tools {
 
+/*! @brief estimated memory footprint of an IdTaggedContainer
+
+	Node and index sizes are derived from the multi-index layout, control block and object
+	sizes are estimates as we cannot see into the allocations made by the user.
+ */
+struct IdTaggedContainerMemoryUsage {
+
+	std::size_t elements            = 0;    //!< number of contained objects
+	std::size_t node_bytes          = 0;    //!< multi-index nodes including the headers of both indices
+	std::size_t index_bytes         = 0;    //!< pointer array of the random access index, including reserve
+	std::size_t filter_bytes        = 0;    //!< negative lookup filter, if enabled
+	std::size_t control_block_bytes = 0;    //!< shared_ptr control blocks (estimated)
+	std::size_t object_bytes        = 0;    //!< the pointed-to objects (estimated)
+	double      load_factor         = 0.0;  //!< size / capacity of the random access index
+	std::size_t tree_depth          = 0;    //!< upper bound for the depth of the ordered index
+
+	std::size_t total() const noexcept {
+
+		return node_bytes + index_bytes + filter_bytes + control_block_bytes + object_bytes;
+	}
+};
+
+/*! @brief operation counters of an IdTaggedContainer
+
+	Those are only counted when the library was built with MOOSE_TOOLS_CONTAINER_STATS.
+	Otherwise all values remain 0. It is off by default as every lookup then increases
+	a counter shared by all readers, which costs concurrent lookups dearly.
+ */
+struct IdTaggedContainerStatistics {
+
+	boost::uint64_t lookups           = 0;  //!< has() and get() calls
+	boost::uint64_t misses            = 0;  //!< lookups that did not find the id
+	boost::uint64_t inserts           = 0;  //!< objects successfully inserted
+	boost::uint64_t erases            = 0;  //!< objects removed, including clear()
+	boost::uint64_t incarnation_bumps = 0;  //!< times a modification increased the incarnation
+	boost::uint64_t filter_rejections = 0;  //!< misses answered by the negative lookup filter alone
+	boost::uint64_t filter_false_positives = 0;  //!< misses the filter let through to the index
+	boost::uint64_t evictions         = 0;  //!< objects evicted in bounded mode
+
+	//! lookups that found what they were looking for
+	boost::uint64_t hits() const noexcept {
+
+		return lookups - misses;
+	}
+
+	//! @return ratio of misses the negative lookup filter failed to catch
+	double filter_false_positive_rate() const noexcept {
+
+		const boost::uint64_t negatives = filter_rejections + filter_false_positives;
+		return negatives ? static_cast<double>(filter_false_positives) / static_cast<double>(negatives) : 0.0;
+	}
+};
+
+namespace detail {
+
+#if defined(MOOSE_TOOLS_CONTAINER_STATS)
+//! relaxed counter to be increased from const methods too
+class container_counter {
+
+	public:
+		void increase(const boost::uint64_t n_amount = 1) const noexcept {
+
+			m_value.fetch_add(n_amount, std::memory_order_relaxed);
+		}
+
+		boost::uint64_t value() const noexcept {
+
+			return m_value.load(std::memory_order_relaxed);
+		}
+
+		void reset() noexcept {
+
+			m_value.store(0, std::memory_order_relaxed);
+		}
+
+		//! only for moving containers, which requires exclusive access anyway
+		void swap(container_counter &n_other) noexcept {
+
+			const boost::uint64_t mine = value();
+			m_value.store(n_other.value(), std::memory_order_relaxed);
+			n_other.m_value.store(mine, std::memory_order_relaxed);
+		}
+
+	private:
+		mutable std::atomic<boost::uint64_t> m_value{ 0 };
+};
+#else
+//! counting disabled at compile time, compiles to nothing
+class container_counter {
+
+	public:
+		void increase(const boost::uint64_t = 1) const noexcept {}
+		boost::uint64_t value() const noexcept { return 0; }
+		void reset() noexcept {}
+		void swap(container_counter &) noexcept {}
+};
+#endif
+
+/*! @brief one CLOCK reference bit per element of the random access index
+
+	Bits are atomic so they can be set from const lookups running concurrently
+	under a shared lock. Resizing requires exclusive access like any modification.
+ */
+class clock_bits {
+
+	public:
+		std::size_t size() const noexcept {
+
+			return m_size;
+		}
+
+		std::size_t capacity() const noexcept {
+
+			return m_capacity;
+		}
+
+		//! make sure n_size bits fit so push_back() cannot fail
+		void reserve(const std::size_t n_size) {
+
+			if (n_size > m_capacity) {
+				const std::size_t capacity = std::max<std::size_t>({ 16, m_capacity * 2, n_size });
+				std::unique_ptr<std::atomic<boost::uint8_t>[]> bits(new std::atomic<boost::uint8_t>[capacity]);
+				for (std::size_t i = 0; i < m_size; ++i) {
+					bits[i].store(m_bits[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+				}
+				m_bits.swap(bits);
+				m_capacity = capacity;
+			}
+		}
+
+		//! new elements start referenced so they survive at least one sweep. Call reserve() first.
+		void push_back() noexcept {
+
+			BOOST_ASSERT(m_size < m_capacity);
+			m_bits[m_size++].store(1, std::memory_order_relaxed);
+		}
+
+		//! shift like the random access index does
+		void erase(const std::size_t n_position) noexcept {
+
+			for (std::size_t i = n_position + 1; i < m_size; ++i) {
+				m_bits[i - 1].store(m_bits[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+			}
+			--m_size;
+		}
+
+		void clear() noexcept {
+
+			m_size = 0;
+		}
+
+		//! only write when not set already to keep the cache line shared among readers
+		void touch(const std::size_t n_position) const noexcept {
+
+			if (!m_bits[n_position].load(std::memory_order_relaxed)) {
+				m_bits[n_position].store(1, std::memory_order_relaxed);
+			}
+		}
+
+		bool test_and_clear(const std::size_t n_position) noexcept {
+
+			if (m_bits[n_position].load(std::memory_order_relaxed)) {
+				m_bits[n_position].store(0, std::memory_order_relaxed);
+				return true;
+			}
+			return false;
+		}
+
+	private:
+		std::unique_ptr<std::atomic<boost::uint8_t>[]>  m_bits;
+		std::size_t                                     m_size = 0;
+		std::size_t                                     m_capacity = 0;
+};
+
+} // namespace detail
+
+//! how a bounded IdTaggedContainer chooses what to evict
+enum class eviction_policy {
+	clock,   //!< approximated LRU. Sweep a hand over all objects, evict the first not used since last sweep
+	ttl      //!< same as clock but objects past their expiry time are evicted first, see set_expiry_extractor()
+};
+
 template< class TaggedContainerType >
 class IdTaggedContainerIterator
 		: public boost::iterator_facade<
@@ -119,12 +311,48 @@ class IdTaggedContainer : public Incarnated< IdTaggedContainer<TaggedType> > {
 		IdTaggedContainer(IdTaggedContainer &&n_other) noexcept {
 		
 			std::swap(m_objects, n_other.m_objects);
+			std::swap(m_filter, n_other.m_filter);
+			std::swap(m_filter_removals, n_other.m_filter_removals);
+			std::swap(m_filter_bits_per_element, n_other.m_filter_bits_per_element);
+			std::swap(m_clock, n_other.m_clock);
+			std::swap(m_clock_hand, n_other.m_clock_hand);
+			std::swap(m_capacity, n_other.m_capacity);
+			std::swap(m_eviction_policy, n_other.m_eviction_policy);
+			std::swap(m_expiry_extractor, n_other.m_expiry_extractor);
+			std::swap(m_next_expiry, n_other.m_next_expiry);
+			std::swap(m_eviction_handler, n_other.m_eviction_handler);
+			m_lookups.swap(n_other.m_lookups);
+			m_misses.swap(n_other.m_misses);
+			m_inserts.swap(n_other.m_inserts);
+			m_erases.swap(n_other.m_erases);
+			m_incarnation_bumps.swap(n_other.m_incarnation_bumps);
+			m_filter_rejections.swap(n_other.m_filter_rejections);
+			m_filter_false_positives.swap(n_other.m_filter_false_positives);
+			m_evictions.swap(n_other.m_evictions);
 		};
 
 		virtual ~IdTaggedContainer() noexcept = default;
 		IdTaggedContainer< TaggedType > &operator=(IdTaggedContainer &&n_other) noexcept {
 		
 			std::swap(m_objects, n_other.m_objects);
+			std::swap(m_filter, n_other.m_filter);
+			std::swap(m_filter_removals, n_other.m_filter_removals);
+			std::swap(m_filter_bits_per_element, n_other.m_filter_bits_per_element);
+			std::swap(m_clock, n_other.m_clock);
+			std::swap(m_clock_hand, n_other.m_clock_hand);
+			std::swap(m_capacity, n_other.m_capacity);
+			std::swap(m_eviction_policy, n_other.m_eviction_policy);
+			std::swap(m_expiry_extractor, n_other.m_expiry_extractor);
+			std::swap(m_next_expiry, n_other.m_next_expiry);
+			std::swap(m_eviction_handler, n_other.m_eviction_handler);
+			m_lookups.swap(n_other.m_lookups);
+			m_misses.swap(n_other.m_misses);
+			m_inserts.swap(n_other.m_inserts);
+			m_erases.swap(n_other.m_erases);
+			m_incarnation_bumps.swap(n_other.m_incarnation_bumps);
+			m_filter_rejections.swap(n_other.m_filter_rejections);
+			m_filter_false_positives.swap(n_other.m_filter_false_positives);
+			m_evictions.swap(n_other.m_evictions);
 			return *this;
 		}
 
@@ -170,15 +398,68 @@ class IdTaggedContainer : public Incarnated< IdTaggedContainer<TaggedType> > {
 				BOOST_THROW_EXCEPTION(internal_error() << error_message("null pointer given"));
 			}
 			
+			return insert_present(n_object);
+		}
+
+		/*! @brief like insert() but reports null as internal error instead of throwing
+
+			@return true if object was added, false if already present
+		 */
+		expected<bool> try_insert(const pointer_type n_object) {
+
+			if (!n_object) {
+				return compact_error(error_kind::internal, "null pointer given");
+			}
+
+			return insert_present(n_object);
+		}
+
+		/*! @brief add a range of objects, skipping those already present
+
+			Inserts are hinted at the end of the id index, so ranges sorted by
+			ascending id are inserted in amortized constant time per object.
+			The incarnation is increased once if anything was inserted.
+
+			@throw internal_error on null. Objects before the null one remain inserted
+			@return number of objects inserted
+		 */
+		template <typename InputIterator>
+		std::size_t insert(InputIterator n_first, const InputIterator n_last) {
+
 			objects_by_id &idx = m_objects.template get<by_id>();
-			if (idx.count(n_object->id())) {
-				// object already present
-				return false;
-			} else {
-				idx.insert(n_object);
-				Incarnated< IdTaggedContainer<TaggedType> >::increase_incarnation();
-				return true;
+			std::size_t inserted = 0;
+
+			for (; n_first != n_last; ++n_first) {
+				const pointer_type &object = *n_first;
+				if (!object) {
+					if (inserted) {
+						bump_incarnation();
+					}
+					BOOST_THROW_EXCEPTION(internal_error() << error_message("null pointer given"));
+				}
+
+				if (m_capacity && (size() >= m_capacity) && idx.count(object->id())) {
+					continue;
+				}
+
+				make_room();
+				inserting(*object);
+				// The hinted insert returns the existing element on collision, which may be
+				// this very pointer if it is present already. Only the size tells for sure.
+				const std::size_t size_before = size();
+				idx.insert(idx.end(), object);
+				if (size() != size_before) {
+					this->inserted();
+					++inserted;
+				}
+			}
+
+			if (inserted) {
+				m_inserts.increase(inserted);
+				bump_incarnation();
 			}
+
+			return inserted;
 		}
 
 		/*! @brief insert a new object, replacing an existing one
@@ -196,7 +477,11 @@ class IdTaggedContainer : public Incarnated< IdTaggedContainer<TaggedType> > {
 			}
 
 			objects_by_id &idx = m_objects.template get<by_id>();
-			bool ret = (idx.erase(n_object->id()) == 1);
+			typename objects_by_id::iterator i = idx.find(n_object->id());
+			const bool ret = (i != idx.end());
+			if (ret) {
+				erase_node(position_of(i), false);
+			}
 			insert(n_object);
 			return ret;
 		}
@@ -209,12 +494,13 @@ class IdTaggedContainer : public Incarnated< IdTaggedContainer<TaggedType> > {
 		bool remove(const typename TaggedType::id_type n_id) noexcept {
 
 			objects_by_id &idx = m_objects.template get<by_id>();
-			bool ret = (idx.erase(n_id) == 1);
-			if (ret) {
-				Incarnated< IdTaggedContainer<TaggedType> >::increase_incarnation();
+			typename objects_by_id::iterator i = idx.find(n_id);
+			if (i == idx.end()) {
+				return false;
 			}
 
-			return ret;
+			erase_node(position_of(i), true);
+			return true;
 		}
 		
 		// mimic std::map erase
@@ -229,45 +515,59 @@ class IdTaggedContainer : public Incarnated< IdTaggedContainer<TaggedType> > {
 			// and simply return a new iterator with the same position I cannot be sure
 			// the elements after this would be the same as they were before the removal.
 			// If you know this for sure, please change accordingly.
-			objects_by_random &ridx = m_objects.template get<by_random>();
-			typename objects_by_random::iterator rai = ridx.begin() + n_position.m_idx;
-
-			typename objects_by_id::iterator deli = m_objects.template project<by_id>(rai);
-			objects_by_id &oidx = m_objects.template get<by_id>();
-			oidx.erase(deli);
-			Incarnated< IdTaggedContainer<TaggedType> >::increase_incarnation();
+			erase_node(n_position.m_idx, true);
 			return iterator(this) + n_position.m_idx;
 		}
 
 		void clear() noexcept {
 	
 			if (size()) {
+				m_erases.increase(size());
 				m_objects.clear();
-				Incarnated< IdTaggedContainer<TaggedType> >::increase_incarnation();
+				if (m_filter) {
+					m_filter->clear();
+					m_filter_removals = 0;
+				}
+				if (m_clock) {
+					m_clock->clear();
+					m_clock_hand = 0;
+				}
+				bump_incarnation();
 			}
 		}
 
 		//! Is there one with that id?
 		bool has(const typename TaggedType::id_type n_id) const noexcept {
 
+			if (filter_rejects(n_id)) {
+				return count_lookup(false);
+			}
+
 			const objects_by_id &idx = m_objects.template get<by_id>();
-			return idx.count(n_id) > 0;
+			return count_filtered_lookup(idx.count(n_id) > 0);
 		}
 		
 		//! Is there one with that id?
 		bool has(const TaggedType &n_object) const noexcept {
 
-			const objects_by_id &idx = m_objects.template get<by_id>();
-			return idx.count(n_object.id()) > 0;
+			return has(n_object.id());
 		}
 
 		//! How did I get this long without actually retrieving things?
 		//! @return null on not found
 		pointer_type get(const typename TaggedType::id_type n_id) const noexcept {
 
+			if (filter_rejects(n_id)) {
+				count_lookup(false);
+				return pointer_type();
+			}
+
 			const objects_by_id &idx = m_objects.template get<by_id>();
 			typename objects_by_id::const_iterator i = idx.find(n_id);
-			if (i != idx.end()) {
+			if (count_filtered_lookup(i != idx.end())) {
+				if (m_clock) {
+					m_clock->touch(position_of(i));
+				}
 				return *i;
 			} else {
 				return pointer_type();
@@ -348,8 +648,518 @@ class IdTaggedContainer : public Incarnated< IdTaggedContainer<TaggedType> > {
 			return ret;
 		};
 
+		/*! @brief pick one object uniformly at random in O(1)
+			@return null when empty
+		 */
+		pointer_type random_element() const noexcept {
+
+			const objects_by_random &idx = m_objects.template get<by_random>();
+			if (idx.empty()) {
+				return pointer_type();
+			}
+			return idx[static_cast<std::size_t>(fast_urand(idx.size()))];
+		}
+
+		/*! @brief pick n_count distinct objects uniformly at random
+
+			Uses Floyd's algorithm which costs O(n_count) regardless of size.
+			When asked for a large part of the container a partial shuffle is cheaper.
+			@return min(n_count, size()) objects in no particular order
+			@throw std::bad_alloc
+		 */
+		std::vector<pointer_type> sample(const std::size_t n_count) const {
+
+			const objects_by_random &idx = m_objects.template get<by_random>();
+			const std::size_t n = idx.size();
+			std::vector<pointer_type> ret;
+
+			if (n_count >= n) {
+				ret.assign(idx.begin(), idx.end());
+				return ret;
+			}
+
+			ret.reserve(n_count);
+			if (n_count > n / 4) {
+				std::vector<std::size_t> positions(n);
+				for (std::size_t i = 0; i < n; ++i) {
+					positions[i] = i;
+				}
+				for (std::size_t i = 0; i < n_count; ++i) {
+					std::swap(positions[i], positions[i + static_cast<std::size_t>(fast_urand(n - i))]);
+					ret.push_back(idx[positions[i]]);
+				}
+			} else {
+				std::unordered_set<std::size_t> chosen;
+				chosen.reserve(n_count);
+				for (std::size_t j = n - n_count; j < n; ++j) {
+					const std::size_t t = static_cast<std::size_t>(fast_urand(j + 1));
+					const std::size_t pick = chosen.insert(t).second ? t : j;
+					if (pick == j) {
+						chosen.insert(j);
+					}
+					ret.push_back(idx[pick]);
+				}
+			}
+
+			return ret;
+		}
+
+		/*! @brief pick two objects at random and return the one with the lower score
+
+			Good enough for load balancing with a fraction of the cost of scanning all,
+			while avoiding the herd behavior of always picking the minimum.
+			@param n_score called exactly twice unless there are less than two objects
+			@return null when empty
+		 */
+		pointer_type power_of_two_choices(const std::function<double (const TaggedType &)> &n_score) const {
+
+			const objects_by_random &idx = m_objects.template get<by_random>();
+			const std::size_t n = idx.size();
+			if (n < 2) {
+				return n ? idx[0] : pointer_type();
+			}
+
+			const std::size_t first = static_cast<std::size_t>(fast_urand(n));
+			std::size_t second = static_cast<std::size_t>(fast_urand(n - 1));
+			if (second >= first) {
+				++second;
+			}
+
+			return (n_score(*idx[second]) < n_score(*idx[first])) ? idx[second] : idx[first];
+		}
+
+		/*! @brief estimate how much memory this container occupies
+
+			Object sizes are assumed to be sizeof(TaggedType), which is wrong for types
+			owning heap memory themselves. Use the overload with a size function for those.
+			@throw nil
+		 */
+		IdTaggedContainerMemoryUsage memory_usage() const noexcept {
+
+			IdTaggedContainerMemoryUsage ret = container_memory_usage();
+			ret.object_bytes = ret.elements * sizeof(TaggedType);
+			return ret;
+		}
+
+		/*! @brief estimate how much memory this container occupies
+			@param n_object_size called for every object to tell its (deep) size in bytes.
+				This makes the call O(n)
+		 */
+		IdTaggedContainerMemoryUsage memory_usage(const std::function<std::size_t (const TaggedType &)> &n_object_size) const {
+
+			IdTaggedContainerMemoryUsage ret = container_memory_usage();
+			const objects_by_random &idx = m_objects.template get<by_random>();
+			for (std::size_t i = 0; i < idx.size(); ++i) {
+				ret.object_bytes += n_object_size(*idx[i]);
+			}
+			return ret;
+		}
+
+		//! @return operation counters, all 0 unless built with MOOSE_TOOLS_CONTAINER_STATS
+		IdTaggedContainerStatistics statistics() const noexcept {
+
+			IdTaggedContainerStatistics ret;
+			ret.lookups           = m_lookups.value();
+			ret.misses            = m_misses.value();
+			ret.inserts           = m_inserts.value();
+			ret.erases            = m_erases.value();
+			ret.incarnation_bumps = m_incarnation_bumps.value();
+			ret.filter_rejections = m_filter_rejections.value();
+			ret.filter_false_positives = m_filter_false_positives.value();
+			ret.evictions = m_evictions.value();
+			return ret;
+		}
+
+		void reset_statistics() noexcept {
+
+			m_lookups.reset();
+			m_misses.reset();
+			m_inserts.reset();
+			m_erases.reset();
+			m_incarnation_bumps.reset();
+			m_filter_rejections.reset();
+			m_filter_false_positives.reset();
+			m_evictions.reset();
+		}
+
+		/*! @brief answer most misses of has() and get() without walking the id index
+
+			Maintains a blocked bloom filter next to the index. Each miss it catches costs
+			one cache line instead of a tree walk, at n_bits_per_element bits per element.
+			The filter grows with the container but removals leave stale bits behind.
+			Call rebuild_negative_lookup_filter() when negative_lookup_filter_stale() says so.
+
+			@param n_expected_elements size the filter for that many. Defaults to the current size
+			@throw std::bad_alloc
+		 */
+		void enable_negative_lookup_filter(const std::size_t n_expected_elements = 0, const unsigned int n_bits_per_element = 10) {
+
+			m_filter_bits_per_element = n_bits_per_element;
+			m_filter.reset(new BloomFilter(std::max(n_expected_elements, size()), n_bits_per_element));
+			fill_filter();
+		}
+
+		void disable_negative_lookup_filter() noexcept {
+
+			m_filter.reset();
+		}
+
+		bool negative_lookup_filter_enabled() const noexcept {
+
+			return static_cast<bool>(m_filter);
+		}
+
+		//! @return true when so many objects were removed since the last rebuild that the false positive rate suffers
+		bool negative_lookup_filter_stale() const noexcept {
+
+			return m_filter && (m_filter_removals > (size() / 2));
+		}
+
+		/*! @brief rebuild the filter from the current content, sized for it
+			@throw std::bad_alloc
+		 */
+		void rebuild_negative_lookup_filter() {
+
+			if (m_filter) {
+				m_filter->reset(size(), m_filter_bits_per_element);
+				fill_filter();
+			}
+		}
+
+		/*! @brief limit the number of objects, evicting others on insert
+
+			A successful get() marks an object as used by setting a bit, which is cheap
+			enough to do under a shared lock. On insert into a full container a clock hand
+			sweeps the objects, clearing those bits and evicting the first one found unset.
+
+			@param n_capacity maximum number of objects, 0 for unbounded.
+				Shrinking below the current size evicts immediately
+			@param n_policy how to pick victims
+		 */
+		void set_capacity(const std::size_t n_capacity, const eviction_policy n_policy = eviction_policy::clock) {
+
+			m_capacity = n_capacity;
+			m_eviction_policy = n_policy;
+			m_next_expiry = std::chrono::steady_clock::time_point::min();
+
+			if (!m_capacity) {
+				m_clock.reset();
+				return;
+			}
+
+			if (!m_clock) {
+				m_clock.reset(new detail::clock_bits());
+				m_clock->reserve(size());
+				for (std::size_t i = 0; i < size(); ++i) {
+					m_clock->push_back();
+				}
+				m_clock_hand = 0;
+			}
+
+			while (size() > m_capacity) {
+				evict_one();
+			}
+		}
+
+		//! 0 means unbounded
+		std::size_t capacity() const noexcept {
+
+			return m_capacity;
+		}
+
+		/*! @brief tell when an object expires for eviction_policy::ttl
+
+			An object's expiry must not move to an earlier time while it is in the container.
+			Eviction remembers the earliest expiry and doesn't look for expired objects before then.
+		 */
+		void set_expiry_extractor(std::function<std::chrono::steady_clock::time_point (const TaggedType &)> &&n_extractor) {
+
+			m_expiry_extractor = std::move(n_extractor);
+			m_next_expiry = std::chrono::steady_clock::time_point::min();
+		}
+
+		//! called with every evicted object after it was removed
+		void set_eviction_handler(std::function<void (const pointer_type &)> &&n_handler) {
+
+			m_eviction_handler = std::move(n_handler);
+		}
+
+		/*! @brief remove all objects past their expiry time in one O(n) sweep
+			Requires an expiry extractor. Removed objects count as evictions.
+			@return number of objects removed
+		 */
+		std::size_t evict_expired() {
+
+			if (!m_expiry_extractor) {
+				return 0;
+			}
+
+			const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			objects_by_random &ridx = m_objects.template get<by_random>();
+			std::size_t ret = 0;
+			std::size_t pos = 0;
+			while (pos < ridx.size()) {
+				if (m_expiry_extractor(*ridx[pos]) <= now) {
+					evict_at(pos);
+					++ret;
+				} else {
+					++pos;
+				}
+			}
+			return ret;
+		}
+
 	private:
 
+		//! every modification goes through here so we can count them
+		void bump_incarnation() noexcept {
+
+			m_incarnation_bumps.increase();
+			Incarnated< IdTaggedContainer<TaggedType> >::increase_incarnation();
+		}
+
+		//! count a lookup and relay its result
+		bool count_lookup(const bool n_found) const noexcept {
+
+			m_lookups.increase();
+			if (!n_found) {
+				m_misses.increase();
+			}
+			return n_found;
+		}
+
+		/*! @brief everything that may throw about inserting an id, done before the index insert
+
+			Should the index insert then not happen, the filter merely has one false positive more.
+			The other way around it would have a false negative.
+		 */
+		void inserting(const TaggedType &n_object) {
+
+			filter_insert(n_object.id());
+			if (m_clock) {
+				m_clock->reserve(size() + 1);
+				if (ttl_eviction()) {
+					m_next_expiry = std::min(m_next_expiry, m_expiry_extractor(n_object));
+				}
+			}
+		}
+
+		//! bookkeeping after the index insert succeeded
+		void inserted() noexcept {
+
+			if (m_clock) {
+				m_clock->push_back();
+			}
+		}
+
+		//! position of an element in the random access index
+		template <typename IdIterator>
+		std::size_t position_of(const IdIterator n_iterator) const noexcept {
+
+			return static_cast<std::size_t>(m_objects.template project<by_random>(n_iterator) - m_objects.template get<by_random>().begin());
+		}
+
+		//! remove a node and keep the auxiliary structures in sync
+		void erase_node(const std::size_t n_position, const bool n_bump) noexcept {
+
+			objects_by_random &ridx = m_objects.template get<by_random>();
+			const std::size_t pos = n_position;
+			ridx.erase(ridx.begin() + pos);
+
+			if (m_clock) {
+				m_clock->erase(pos);
+				if (pos < m_clock_hand) {
+					--m_clock_hand;
+				}
+			}
+
+			m_erases.increase();
+			++m_filter_removals;
+			if (n_bump) {
+				bump_incarnation();
+			}
+		}
+
+		void evict_at(const std::size_t n_position) {
+
+			objects_by_random &ridx = m_objects.template get<by_random>();
+			const pointer_type victim = ridx[n_position];
+			erase_node(n_position, true);
+			m_evictions.increase();
+			if (m_eviction_handler) {
+				m_eviction_handler(victim);
+			}
+		}
+
+		//! insert() after the null check
+		bool insert_present(const pointer_type &n_object) {
+
+			objects_by_id &idx = m_objects.template get<by_id>();
+			if (idx.count(n_object->id())) {
+				// object already present
+				return false;
+			} else {
+				make_room();
+				inserting(*n_object);
+				idx.insert(n_object);
+				inserted();
+				m_inserts.increase();
+				bump_incarnation();
+				return true;
+			}
+		}
+
+		//! evict if the next insert would exceed capacity
+		void make_room() {
+
+			if (m_capacity && (size() >= m_capacity)) {
+				evict_one();
+			}
+		}
+
+		bool ttl_eviction() const noexcept {
+
+			return (m_eviction_policy == eviction_policy::ttl) && m_expiry_extractor;
+		}
+
+		/*! @brief evict the first expired object from the hand on
+
+			This is O(n) but only done once the earliest known expiry has passed.
+			@return false if nothing has expired
+		 */
+		bool evict_one_expired() {
+
+			const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			if (now < m_next_expiry) {
+				return false;
+			}
+
+			const objects_by_random &ridx = m_objects.template get<by_random>();
+			std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
+			for (std::size_t i = 0; i < size(); ++i) {
+				const std::size_t pos = (m_clock_hand + i) % size();
+				const std::chrono::steady_clock::time_point expiry = m_expiry_extractor(*ridx[pos]);
+				if (expiry <= now) {
+					evict_at(pos);
+					return true;
+				}
+				next = std::min(next, expiry);
+			}
+
+			m_next_expiry = next;
+			return false;
+		}
+
+		//! sweep the clock hand until a victim is found. Terminates within two rounds
+		void evict_one() {
+
+			if (ttl_eviction() && evict_one_expired()) {
+				return;
+			}
+
+			for (std::size_t steps = 0; (steps < 2 * size() + 1) && !empty(); ++steps) {
+				if (m_clock_hand >= size()) {
+					m_clock_hand = 0;
+				}
+
+				if (!m_clock->test_and_clear(m_clock_hand)) {
+					// the next one moves into the hand's position
+					evict_at(m_clock_hand);
+					return;
+				}
+
+				++m_clock_hand;
+			}
+		}
+
+		static boost::uint64_t filter_key(const typename TaggedType::id_type n_id) noexcept {
+
+			return static_cast<boost::uint64_t>(std::hash<typename TaggedType::id_type>()(n_id));
+		}
+
+		//! @return true if the filter is enabled and knows the id is not in here
+		bool filter_rejects(const typename TaggedType::id_type n_id) const noexcept {
+
+			if (m_filter && !m_filter->may_contain(filter_key(n_id))) {
+				m_filter_rejections.increase();
+				return true;
+			}
+			return false;
+		}
+
+		//! count a lookup that went past the filter
+		bool count_filtered_lookup(const bool n_found) const noexcept {
+
+			if (!n_found && m_filter) {
+				m_filter_false_positives.increase();
+			}
+			return count_lookup(n_found);
+		}
+
+		void filter_insert(const typename TaggedType::id_type n_id) {
+
+			if (!m_filter) {
+				return;
+			}
+
+			// Grow before exceeding what the filter was sized for so the false positive rate
+			// stays put. As it doubles like a hash table would this is amortized O(1).
+			if (m_filter->elements() >= std::max<std::size_t>(m_filter->capacity(), 64)) {
+				m_filter->reset(2 * (size() + 1), m_filter_bits_per_element);
+				fill_filter();
+			}
+			m_filter->insert(filter_key(n_id));
+		}
+
+		void fill_filter() {
+
+			const objects_by_random &idx = m_objects.template get<by_random>();
+			for (std::size_t i = 0; i < idx.size(); ++i) {
+				m_filter->insert(filter_key(idx[i]->id()));
+			}
+			m_filter_removals = 0;
+		}
+
+		IdTaggedContainerMemoryUsage container_memory_usage() const noexcept {
+
+			IdTaggedContainerMemoryUsage ret;
+			const objects_by_random &idx = m_objects.template get<by_random>();
+
+			ret.elements = idx.size();
+
+			// Each node holds the value, the ordered index' parent, left and right pointers
+			// (color is packed into parent) and the random access index' back pointer.
+			// The header node is allocated regardless of size.
+			ret.node_bytes = (ret.elements + 1) * (sizeof(pointer_type) + 4 * sizeof(void *));
+
+			// The random access index keeps an array of node pointers, one more than capacity
+			ret.index_bytes = (idx.capacity() + 1) * sizeof(void *);
+			if (m_clock) {
+				ret.index_bytes += sizeof(detail::clock_bits) + m_clock->capacity();
+			}
+
+			if (m_filter) {
+				ret.filter_bytes = sizeof(BloomFilter) + m_filter->memory_usage();
+			}
+
+			// libstdc++ and MSVC both keep a vtable pointer and two counters. Separately
+			// allocated objects add a pointer, which we don't know about.
+			ret.control_block_bytes = ret.elements * (sizeof(void *) + 2 * sizeof(int));
+
+			if (idx.capacity()) {
+				ret.load_factor = static_cast<double>(ret.elements) / static_cast<double>(idx.capacity());
+			}
+
+			// a red-black tree is never deeper than 2 * log2(n + 1)
+			std::size_t log = 0;
+			for (std::size_t n = ret.elements + 1; n > 1; n >>= 1) {
+				++log;
+			}
+			ret.tree_depth = 2 * log;
+
+			return ret;
+		}
+
 		struct by_id {};
 		struct by_random {};
 
@@ -370,6 +1180,27 @@ class IdTaggedContainer : public Incarnated< IdTaggedContainer<TaggedType> > {
 		using objects_by_random = typename tagged_container_type::template index<by_random>::type;
 
 		tagged_container_type  m_objects;
+
+		detail::container_counter  m_lookups;
+		detail::container_counter  m_misses;
+		detail::container_counter  m_inserts;
+		detail::container_counter  m_erases;
+		detail::container_counter  m_incarnation_bumps;
+		detail::container_counter  m_filter_rejections;
+		detail::container_counter  m_filter_false_positives;
+
+		std::unique_ptr<BloomFilter>  m_filter;
+		unsigned int                  m_filter_bits_per_element = 10;
+		std::size_t                   m_filter_removals = 0;
+
+		detail::container_counter     m_evictions;
+		std::unique_ptr<detail::clock_bits>  m_clock;
+		std::size_t                   m_clock_hand = 0;
+		std::size_t                   m_capacity = 0;
+		eviction_policy               m_eviction_policy = eviction_policy::clock;
+		std::function<std::chrono::steady_clock::time_point (const TaggedType &)>  m_expiry_extractor;
+		std::chrono::steady_clock::time_point  m_next_expiry = std::chrono::steady_clock::time_point::min();  //!< no object expires before
+		std::function<void (const pointer_type &)>  m_eviction_handler;
 };
 
 #if defined(BOOST_MSVC)
@@ -0,0 +1,126 @@
+//  Copyright 2019 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include "IdTaggedReplication.hpp"
+
+namespace moose {
+namespace tools {
+namespace replication {
+
+namespace {
+
+	const boost::uint32_t replication_magic      = 0x4d535250;  // "MSRP"
+	const boost::uint32_t replication_version    = 1;
+	const boost::uint32_t replication_byte_order = 0x01020304;
+}
+
+void append_u8(std::string &n_buffer, const boost::uint8_t n_value) {
+
+	n_buffer.push_back(static_cast<char>(n_value));
+}
+
+void append_u32(std::string &n_buffer, const boost::uint32_t n_value) {
+
+	for (int i = 0; i < 4; ++i) {
+		n_buffer.push_back(static_cast<char>((n_value >> (8 * i)) & 0xff));
+	}
+}
+
+void append_u64(std::string &n_buffer, const boost::uint64_t n_value) {
+
+	for (int i = 0; i < 8; ++i) {
+		n_buffer.push_back(static_cast<char>((n_value >> (8 * i)) & 0xff));
+	}
+}
+
+void begin_frame(std::string &n_buffer, const frame_type n_type) {
+
+	n_buffer.clear();
+	append_u32(n_buffer, 0);
+	append_u8(n_buffer, static_cast<boost::uint8_t>(n_type));
+}
+
+void finish_frame(std::string &n_buffer) {
+
+	const boost::uint32_t length = static_cast<boost::uint32_t>(n_buffer.size() - 4);
+	for (int i = 0; i < 4; ++i) {
+		n_buffer[i] = static_cast<char>((length >> (8 * i)) & 0xff);
+	}
+}
+
+std::string hello_frame(const boost::uint32_t n_id_size) {
+
+	std::string ret;
+	begin_frame(ret, frame_type::hello);
+	append_u32(ret, replication_magic);
+	append_u32(ret, replication_version);
+	append_u32(ret, n_id_size);
+	// this one goes native so we can tell if the other side is different
+	ret.append(reinterpret_cast<const char *>(&replication_byte_order), sizeof(replication_byte_order));
+	finish_frame(ret);
+	return ret;
+}
+
+void check_hello(const char *n_body, const std::size_t n_size, const boost::uint32_t n_id_size) {
+
+	frame_reader reader(n_body, n_size);
+	if ((reader.u32() != replication_magic) || (reader.u32() != replication_version)) {
+		BOOST_THROW_EXCEPTION(protocol_error() << error_message("not a replication stream or wrong version"));
+	}
+
+	if (reader.u32() != n_id_size) {
+		BOOST_THROW_EXCEPTION(protocol_error() << error_message("replication id size mismatch"));
+	}
+
+	boost::uint32_t byte_order = 0;
+	std::memcpy(&byte_order, reader.bytes(sizeof(byte_order)), sizeof(byte_order));
+	if (byte_order != replication_byte_order) {
+		BOOST_THROW_EXCEPTION(protocol_error() << error_message("replication byte order mismatch"));
+	}
+}
+
+boost::uint8_t frame_reader::u8() {
+
+	return static_cast<boost::uint8_t>(*bytes(1));
+}
+
+boost::uint32_t frame_reader::u32() {
+
+	const unsigned char *p = reinterpret_cast<const unsigned char *>(bytes(4));
+	boost::uint32_t ret = 0;
+	for (int i = 3; i >= 0; --i) {
+		ret = (ret << 8) | p[i];
+	}
+	return ret;
+}
+
+boost::uint64_t frame_reader::u64() {
+
+	const unsigned char *p = reinterpret_cast<const unsigned char *>(bytes(8));
+	boost::uint64_t ret = 0;
+	for (int i = 7; i >= 0; --i) {
+		ret = (ret << 8) | p[i];
+	}
+	return ret;
+}
+
+const char *frame_reader::bytes(const std::size_t n_size) {
+
+	if (n_size > (m_size - m_pos)) {
+		BOOST_THROW_EXCEPTION(protocol_error() << error_message("replication frame truncated"));
+	}
+
+	const char *ret = m_data + m_pos;
+	m_pos += n_size;
+	return ret;
+}
+
+} // namespace replication
+
+#if defined(BOOST_MSVC)
+void IdTaggedReplicationGetRidOfLNK4221() {}
+#endif
+
+} // namespace tools
+} // namespace moose
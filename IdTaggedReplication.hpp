@@ -0,0 +1,841 @@
+//  Copyright 2019 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+#include "MooseToolsConfig.hpp"
+#include "IdTaggedContainer.hpp"
+#include "TimedConnect.hpp"
+#include "Error.hpp"
+#include "Log.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace moose {
+namespace tools {
+
+/*! @brief incremental replication of IdTaggedContainer over TCP
+
+	A publisher sends a full snapshot to every subscriber once and then only streams
+	the changes made through it, batched per incarnation. Subscribers apply them to
+	a replica container. The codec is the same as for IdTaggedSnapshot.
+
+	Wire format, all frames are [u32 length][u8 type][body] with little endian integers.
+	Ids are sent in native representation, which the hello frame validates.
+
+	 * hello:          u32 magic, u32 version, u32 id size, u32 byte order marker
+	 * snapshot_begin: u64 incarnation, u64 count
+	 * batch:          u64 incarnation, u32 entry count, entries
+	 * snapshot_end:   u64 incarnation
+
+	An entry is [u8 op][id][u32 size][payload] where op is upsert, remove or clear.
+	Between snapshot_begin and snapshot_end batches only contain upserts,
+	subscribers drop the connection on anything else.
+ */
+namespace replication {
+
+enum class frame_type : boost::uint8_t {
+	hello          = 1,
+	snapshot_begin = 2,
+	batch          = 3,
+	snapshot_end   = 4
+};
+
+enum class entry_op : boost::uint8_t {
+	upsert = 1,
+	remove = 2,
+	clear  = 3
+};
+
+//! frames above this size are considered a protocol violation
+const boost::uint32_t max_frame_size = 256 * 1024 * 1024;
+
+MOOSE_TOOLS_API void append_u8(std::string &n_buffer, const boost::uint8_t n_value);
+MOOSE_TOOLS_API void append_u32(std::string &n_buffer, const boost::uint32_t n_value);
+MOOSE_TOOLS_API void append_u64(std::string &n_buffer, const boost::uint64_t n_value);
+
+/*! @brief build a hello frame announcing the id size of the publisher */
+MOOSE_TOOLS_API std::string hello_frame(const boost::uint32_t n_id_size);
+
+/*! @brief validate a hello frame body
+	@throw protocol_error on mismatch
+ */
+MOOSE_TOOLS_API void check_hello(const char *n_body, const std::size_t n_size, const boost::uint32_t n_id_size);
+
+//! start a frame, reserving the length field. Finish it with finish_frame()
+MOOSE_TOOLS_API void begin_frame(std::string &n_buffer, const frame_type n_type);
+
+//! write the length of a frame started with begin_frame()
+MOOSE_TOOLS_API void finish_frame(std::string &n_buffer);
+
+/*! @brief sequential little endian reader over a frame body
+	All getters throw protocol_error when reading beyond the end
+ */
+class frame_reader {
+
+	public:
+		frame_reader(const char *n_data, const std::size_t n_size) noexcept
+				: m_data(n_data)
+				, m_size(n_size)
+				, m_pos(0) {
+		}
+
+		MOOSE_TOOLS_API boost::uint8_t  u8();
+		MOOSE_TOOLS_API boost::uint32_t u32();
+		MOOSE_TOOLS_API boost::uint64_t u64();
+
+		//! @return pointer to the next n_size bytes, which are skipped
+		MOOSE_TOOLS_API const char *bytes(const std::size_t n_size);
+
+		bool done() const noexcept {
+
+			return m_pos == m_size;
+		}
+
+	private:
+		const char        *m_data;
+		const std::size_t  m_size;
+		std::size_t        m_pos;
+};
+
+} // namespace replication
+
+struct ReplicationOptions {
+
+	//! pending changes are sent when they exceed this size...
+	std::size_t                max_batch_bytes  = 64 * 1024;
+
+	//! ...or when the first of them has waited this long
+	std::chrono::milliseconds  batch_delay{ 10 };
+
+	//! A subscriber with more than this of deltas queued is considered too slow. Its deltas are
+	//! dropped and it gets a new snapshot once it caught up, so memory stays bounded.
+	//! Snapshots don't count against this as they are never dropped.
+	std::size_t                max_queued_bytes = 16 * 1024 * 1024;
+};
+
+/*! @brief publishes changes of an IdTaggedContainer to subscribers
+
+	All changes must go through this object in order to be replicated. Modifying methods
+	may be called from any thread. Network operations run on a strand of the given io_context.
+
+	Must be held by a std::shared_ptr as pending operations keep it alive.
+ */
+template <typename TaggedType, typename Codec>
+class IdTaggedContainerPublisher : public std::enable_shared_from_this<IdTaggedContainerPublisher<TaggedType, Codec> > {
+
+	public:
+		using container_type = IdTaggedContainer<TaggedType>;
+		using pointer_type   = typename container_type::pointer_type;
+		using id_type        = typename TaggedType::id_type;
+
+		static_assert(std::is_trivially_copyable<id_type>::value, "replicated ids must be trivially copyable");
+
+		/*! @param n_container will be replicated. Do not modify it other than via this object
+			@param n_endpoint where to listen for subscribers. Use port 0 for any
+		 */
+		IdTaggedContainerPublisher(boost::asio::io_context &n_io_context, container_type &n_container,
+					const boost::asio::ip::tcp::endpoint &n_endpoint,
+					const ReplicationOptions &n_options = ReplicationOptions(), const Codec &n_codec = Codec())
+				: m_strand(boost::asio::make_strand(n_io_context))
+				, m_acceptor(m_strand)
+				, m_batch_timer(m_strand)
+				, m_container(n_container)
+				, m_endpoint(n_endpoint)
+				, m_options(n_options)
+				, m_codec(n_codec) {
+		}
+
+		IdTaggedContainerPublisher(const IdTaggedContainerPublisher &n_other) = delete;
+
+		/*! @brief open the acceptor and start accepting subscribers
+			@throw network_error when the endpoint cannot be bound
+		 */
+		void start() {
+
+			boost::system::error_code ec;
+			m_acceptor.open(m_endpoint.protocol(), ec);
+			if (!ec) {
+				m_acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), ec);
+				m_acceptor.bind(m_endpoint, ec);
+			}
+			if (!ec) {
+				m_acceptor.listen(boost::asio::socket_base::max_listen_connections, ec);
+			}
+			if (ec) {
+				BOOST_THROW_EXCEPTION(network_error() << error_message("Cannot listen for replication subscribers")
+					<< error_code(ec));
+			}
+
+			boost::asio::post(m_strand, [self{ this->shared_from_this() }] { self->accept(); });
+		}
+
+		//! close the acceptor and all subscriber connections
+		void stop() {
+
+			boost::asio::post(m_strand, [self{ this->shared_from_this() }] {
+				boost::system::error_code ignored;
+				self->m_acceptor.close(ignored);
+				self->m_batch_timer.cancel();
+				for (const std::shared_ptr<session> &s : self->m_sessions) {
+					s->m_socket.close(ignored);
+				}
+				self->m_sessions.clear();
+				self->m_subscribers.store(0, std::memory_order_relaxed);
+			});
+		}
+
+		//! where the acceptor actually listens. Only valid after start()
+		boost::asio::ip::tcp::endpoint local_endpoint() const {
+
+			return m_acceptor.local_endpoint();
+		}
+
+		//! number of connected subscribers
+		std::size_t subscribers() const noexcept {
+
+			return m_subscribers.load(std::memory_order_relaxed);
+		}
+
+		//! same as IdTaggedContainer::insert() but replicated
+		bool insert(const pointer_type &n_object) {
+
+			boost::lock_guard<boost::mutex> lock(m_mutex);
+			if (!m_container.insert(n_object)) {
+				return false;
+			}
+
+			append_upsert(*n_object);
+			return true;
+		}
+
+		//! same as IdTaggedContainer::replace() but replicated
+		bool replace(const pointer_type &n_object) {
+
+			boost::lock_guard<boost::mutex> lock(m_mutex);
+			const bool ret = m_container.replace(n_object);
+			append_upsert(*n_object);
+			return ret;
+		}
+
+		//! same as IdTaggedContainer::remove() but replicated
+		bool remove(const id_type n_id) {
+
+			boost::lock_guard<boost::mutex> lock(m_mutex);
+			if (!m_container.remove(n_id)) {
+				return false;
+			}
+
+			append_entry(replication::entry_op::remove, n_id, nullptr, 0);
+			return true;
+		}
+
+		//! same as IdTaggedContainer::clear() but replicated
+		void clear() {
+
+			boost::lock_guard<boost::mutex> lock(m_mutex);
+			m_container.clear();
+			append_entry(replication::entry_op::clear, id_type(), nullptr, 0);
+		}
+
+		//! send pending changes now rather than waiting for the batch delay
+		void flush() {
+
+			boost::asio::post(m_strand, [self{ this->shared_from_this() }] { self->flush_pending(); });
+		}
+
+	private:
+		struct session {
+
+			explicit session(boost::asio::ip::tcp::socket &&n_socket)
+					: m_socket(std::move(n_socket)) {
+			}
+
+			boost::asio::ip::tcp::socket                   m_socket;
+			std::deque<std::shared_ptr<const std::string> > m_queue;
+			std::size_t                                    m_queued_bytes = 0;    //!< of deltas only
+			std::size_t                                    m_snapshot_frames = 0; //!< at the front of m_queue, not in m_queued_bytes
+			bool                                           m_writing = false;
+			bool                                           m_needs_snapshot = false;
+		};
+
+		//! must hold m_mutex
+		void append_upsert(const TaggedType &n_object) {
+
+			m_encode_buffer.clear();
+			m_codec.encode(n_object, m_encode_buffer);
+			append_entry(replication::entry_op::upsert, n_object.id(), m_encode_buffer.data(), m_encode_buffer.size());
+		}
+
+		//! must hold m_mutex
+		void append_entry(const replication::entry_op n_op, const id_type n_id, const char *n_data, const std::size_t n_size) {
+
+			replication::append_u8(m_pending, static_cast<boost::uint8_t>(n_op));
+			m_pending.append(reinterpret_cast<const char *>(&n_id), sizeof(id_type));
+			replication::append_u32(m_pending, static_cast<boost::uint32_t>(n_size));
+			m_pending.append(n_data, n_size);
+			++m_pending_entries;
+
+			if (m_pending.size() >= m_options.max_batch_bytes) {
+				// enough for a batch, no need to wait any longer. One queued flush takes all that follows
+				m_flush_scheduled = true;
+				if (!m_size_flush_queued) {
+					m_size_flush_queued = true;
+					boost::asio::post(m_strand, [self{ this->shared_from_this() }] { self->flush_pending(); });
+				}
+			} else if (!m_flush_scheduled) {
+				m_flush_scheduled = true;
+				boost::asio::post(m_strand, [self{ this->shared_from_this() }] {
+					self->m_batch_timer.expires_after(self->m_options.batch_delay);
+					self->m_batch_timer.async_wait([self](const boost::system::error_code &n_error) {
+						if (!n_error) {
+							self->flush_pending();
+						}
+					});
+				});
+			}
+		}
+
+		//! on strand. Send everything pending as one batch stamped with the current incarnation
+		void flush_pending() {
+
+			std::string entries;
+			boost::uint32_t count = 0;
+			boost::uint64_t incarnation = 0;
+			{
+				boost::lock_guard<boost::mutex> lock(m_mutex);
+				entries.swap(m_pending);
+				count = m_pending_entries;
+				m_pending_entries = 0;
+				m_flush_scheduled = false;
+				m_size_flush_queued = false;
+				incarnation = m_container.incarnation();
+			}
+
+			if (!count) {
+				return;
+			}
+
+			std::shared_ptr<std::string> frame = std::make_shared<std::string>();
+			frame->reserve(entries.size() + 32);
+			replication::begin_frame(*frame, replication::frame_type::batch);
+			replication::append_u64(*frame, incarnation);
+			replication::append_u32(*frame, count);
+			frame->append(entries);
+			replication::finish_frame(*frame);
+
+			for (const std::shared_ptr<session> &s : m_sessions) {
+				enqueue(s, frame);
+			}
+		}
+
+		//! on strand. Queue full state for a session, encoded under the mutex so it's consistent.
+		//! Batches pending at this time will also reach the session later. They re-apply
+		//! changes already contained in the snapshot in order, which results in the same state.
+		void send_snapshot(const std::shared_ptr<session> &n_session) {
+
+			std::vector<std::shared_ptr<const std::string> > frames;
+			{
+				boost::lock_guard<boost::mutex> lock(m_mutex);
+				const boost::uint64_t incarnation = m_container.incarnation();
+
+				std::shared_ptr<std::string> frame = std::make_shared<std::string>();
+				replication::begin_frame(*frame, replication::frame_type::snapshot_begin);
+				replication::append_u64(*frame, incarnation);
+				replication::append_u64(*frame, m_container.size());
+				replication::finish_frame(*frame);
+				frames.push_back(frame);
+
+				std::string entries;
+				boost::uint32_t count = 0;
+				std::string buffer;
+				for (const pointer_type &o : m_container) {
+					buffer.clear();
+					m_codec.encode(*o, buffer);
+					const id_type id = o->id();
+					replication::append_u8(entries, static_cast<boost::uint8_t>(replication::entry_op::upsert));
+					entries.append(reinterpret_cast<const char *>(&id), sizeof(id_type));
+					replication::append_u32(entries, static_cast<boost::uint32_t>(buffer.size()));
+					entries.append(buffer);
+					++count;
+
+					if (entries.size() >= m_options.max_batch_bytes) {
+						frames.push_back(batch_frame(incarnation, count, entries));
+						entries.clear();
+						count = 0;
+					}
+				}
+
+				if (count) {
+					frames.push_back(batch_frame(incarnation, count, entries));
+				}
+
+				frame = std::make_shared<std::string>();
+				replication::begin_frame(*frame, replication::frame_type::snapshot_end);
+				replication::append_u64(*frame, incarnation);
+				replication::finish_frame(*frame);
+				frames.push_back(frame);
+			}
+
+			// A snapshot may well exceed the queue limit by itself. It is therefore not counted
+			// and never dropped, or a large container would resync forever under constant writes.
+			// The queue is always empty here so the snapshot frames are at its front.
+			BOOST_ASSERT(n_session->m_queue.empty());
+			n_session->m_needs_snapshot = false;
+			n_session->m_snapshot_frames = frames.size();
+			for (const std::shared_ptr<const std::string> &f : frames) {
+				n_session->m_queue.push_back(f);
+			}
+			write(n_session);
+		}
+
+		static std::shared_ptr<const std::string> batch_frame(const boost::uint64_t n_incarnation, const boost::uint32_t n_count, const std::string &n_entries) {
+
+			std::shared_ptr<std::string> frame = std::make_shared<std::string>();
+			frame->reserve(n_entries.size() + 32);
+			replication::begin_frame(*frame, replication::frame_type::batch);
+			replication::append_u64(*frame, n_incarnation);
+			replication::append_u32(*frame, n_count);
+			frame->append(n_entries);
+			replication::finish_frame(*frame);
+			return frame;
+		}
+
+		//! on strand
+		void enqueue(const std::shared_ptr<session> &n_session, const std::shared_ptr<const std::string> &n_frame) {
+
+			if (n_session->m_needs_snapshot) {
+				// this one is behind anyway and will get the full state
+				return;
+			}
+
+			n_session->m_queued_bytes += n_frame->size();
+			n_session->m_queue.push_back(n_frame);
+
+			if (n_session->m_queued_bytes > m_options.max_queued_bytes) {
+				// Backpressure. Drop all deltas but the frame being written. Snapshot frames stay.
+				BOOST_LOG_SEV(logger(), warning) << "Replication subscriber too slow, dropping "
+					<< n_session->m_queued_bytes << " bytes of deltas for resync";
+
+				const std::size_t in_flight = n_session->m_writing ? 1 : 0;
+				const std::size_t keep = std::max(n_session->m_snapshot_frames, in_flight);
+				n_session->m_queue.resize(keep);
+				n_session->m_queued_bytes = (keep > n_session->m_snapshot_frames) ? n_session->m_queue.front()->size() : 0;
+				n_session->m_needs_snapshot = true;
+			}
+
+			write(n_session);
+		}
+
+		//! on strand
+		void write(const std::shared_ptr<session> &n_session) {
+
+			if (n_session->m_writing) {
+				return;
+			}
+
+			if (n_session->m_queue.empty()) {
+				if (n_session->m_needs_snapshot) {
+					send_snapshot(n_session);
+				}
+				return;
+			}
+
+			n_session->m_writing = true;
+			const std::shared_ptr<const std::string> frame = n_session->m_queue.front();
+			boost::asio::async_write(n_session->m_socket, boost::asio::buffer(*frame),
+				[self{ this->shared_from_this() }, n_session, frame](const boost::system::error_code &n_error, const std::size_t) {
+
+					n_session->m_writing = false;
+					if (n_error) {
+						self->drop(n_session, n_error);
+						return;
+					}
+
+					if (n_session->m_snapshot_frames) {
+						--n_session->m_snapshot_frames;
+					} else {
+						n_session->m_queued_bytes -= frame->size();
+					}
+					n_session->m_queue.pop_front();
+					self->write(n_session);
+				});
+		}
+
+		//! on strand
+		void drop(const std::shared_ptr<session> &n_session, const boost::system::error_code &n_error) {
+
+			if (n_error != boost::asio::error::operation_aborted) {
+				BOOST_LOG_SEV(logger(), normal) << "Replication subscriber disconnected: " << n_error.message();
+			}
+
+			boost::system::error_code ignored;
+			n_session->m_socket.close(ignored);
+			for (typename std::vector<std::shared_ptr<session> >::iterator i = m_sessions.begin(); i != m_sessions.end(); ++i) {
+				if (*i == n_session) {
+					m_sessions.erase(i);
+					break;
+				}
+			}
+			m_subscribers.store(m_sessions.size(), std::memory_order_relaxed);
+		}
+
+		//! on strand
+		void accept() {
+
+			m_acceptor.async_accept([self{ this->shared_from_this() }](const boost::system::error_code &n_error, boost::asio::ip::tcp::socket n_socket) {
+
+				if (n_error) {
+					if (n_error != boost::asio::error::operation_aborted) {
+						BOOST_LOG_SEV(logger(), warning) << "Cannot accept replication subscriber: " << n_error.message();
+						self->accept();
+					}
+					return;
+				}
+
+				boost::system::error_code ignored;
+				n_socket.set_option(boost::asio::ip::tcp::no_delay(true), ignored);
+
+				std::shared_ptr<session> s = std::make_shared<session>(std::move(n_socket));
+				self->m_sessions.push_back(s);
+				self->m_subscribers.store(self->m_sessions.size(), std::memory_order_relaxed);
+
+				// The subscriber never sends anything. A read tells us when it's gone.
+				self->watch(s);
+
+				const std::shared_ptr<const std::string> hello = std::make_shared<const std::string>(replication::hello_frame(sizeof(id_type)));
+				s->m_queued_bytes += hello->size();
+				s->m_queue.push_back(hello);
+				s->m_needs_snapshot = true;
+				self->write(s);
+
+				self->accept();
+			});
+		}
+
+		//! on strand
+		void watch(const std::shared_ptr<session> &n_session) {
+
+			std::shared_ptr<char> byte = std::make_shared<char>(0);
+			n_session->m_socket.async_read_some(boost::asio::buffer(byte.get(), 1),
+				[self{ this->shared_from_this() }, n_session, byte](const boost::system::error_code &n_error, const std::size_t) {
+					if (n_error) {
+						self->drop(n_session, n_error);
+					} else {
+						self->watch(n_session);
+					}
+				});
+		}
+
+		boost::asio::strand<boost::asio::io_context::executor_type>  m_strand;
+		boost::asio::ip::tcp::acceptor          m_acceptor;
+		boost::asio::steady_timer               m_batch_timer;
+		std::vector<std::shared_ptr<session> >  m_sessions;
+		std::atomic<std::size_t>                m_subscribers{ 0 };
+
+		//! guards the container and the pending batch
+		boost::mutex                            m_mutex;
+		container_type                         &m_container;
+		std::string                             m_pending;
+		boost::uint32_t                         m_pending_entries = 0;
+		bool                                    m_flush_scheduled = false;
+		bool                                    m_size_flush_queued = false;  //!< posted because m_pending is full
+		std::string                             m_encode_buffer;
+
+		const boost::asio::ip::tcp::endpoint    m_endpoint;
+		const ReplicationOptions                m_options;
+		const Codec                             m_codec;
+};
+
+/*! @brief keeps a replica of a published IdTaggedContainer
+
+	Changes are applied on the given io_context. Do not access the replica from other
+	threads while it runs unless you serialize access, e.g. in the update handler.
+
+	Must be held by a std::shared_ptr as pending operations keep it alive.
+ */
+template <typename TaggedType, typename Codec>
+class IdTaggedContainerSubscriber : public std::enable_shared_from_this<IdTaggedContainerSubscriber<TaggedType, Codec> > {
+
+	public:
+		using container_type = IdTaggedContainer<TaggedType>;
+		using pointer_type   = typename container_type::pointer_type;
+		using id_type        = typename TaggedType::id_type;
+
+		//! called after each applied batch with the publisher's incarnation
+		using update_handler = std::function<void (const boost::uint64_t n_incarnation)>;
+
+		//! called once when the connection ends, with the reason
+		using stop_handler = std::function<void (const boost::system::error_code &n_error)>;
+
+		IdTaggedContainerSubscriber(boost::asio::io_context &n_io_context, container_type &n_replica, const Codec &n_codec = Codec())
+				: m_socket(boost::asio::make_strand(n_io_context))
+				, m_replica(n_replica)
+				, m_codec(n_codec) {
+		}
+
+		IdTaggedContainerSubscriber(const IdTaggedContainerSubscriber &n_other) = delete;
+
+		void set_update_handler(update_handler &&n_handler) {
+
+			m_update_handler = std::move(n_handler);
+		}
+
+		void set_stop_handler(stop_handler &&n_handler) {
+
+			m_stop_handler = std::move(n_handler);
+		}
+
+		/*! @brief connect to a publisher and start replicating
+			@param n_timeout connect timeout in seconds
+		 */
+		void start(const std::string &n_hostname, const boost::uint16_t n_port, const unsigned int n_timeout = 5) {
+
+			async_timed_connect(m_socket, n_hostname, n_port, n_timeout,
+				[self{ this->shared_from_this() }](const boost::system::error_code &n_error) {
+					if (n_error) {
+						self->finish(n_error);
+						return;
+					}
+					self->read_header();
+				});
+		}
+
+		void stop() {
+
+			boost::asio::post(m_socket.get_executor(), [self{ this->shared_from_this() }] {
+				boost::system::error_code ignored;
+				self->m_socket.close(ignored);
+			});
+		}
+
+		//! the last incarnation of the publisher's container applied to the replica
+		boost::uint64_t remote_incarnation() const noexcept {
+
+			return m_remote_incarnation.load(std::memory_order_acquire);
+		}
+
+		//! true once the initial snapshot has been applied
+		bool synchronized() const noexcept {
+
+			return m_synchronized.load(std::memory_order_acquire);
+		}
+
+	private:
+		void read_header() {
+
+			boost::asio::async_read(m_socket, boost::asio::buffer(m_header, sizeof(m_header)),
+				[self{ this->shared_from_this() }](const boost::system::error_code &n_error, const std::size_t) {
+
+					if (n_error) {
+						self->finish(n_error);
+						return;
+					}
+
+					const boost::uint32_t length = replication::frame_reader(self->m_header, sizeof(self->m_header)).u32();
+					if ((length == 0) || (length > replication::max_frame_size)) {
+						self->finish(boost::asio::error::message_size);
+						return;
+					}
+
+					self->m_body.resize(length);
+					self->read_body();
+				});
+		}
+
+		void read_body() {
+
+			boost::asio::async_read(m_socket, boost::asio::buffer(m_body),
+				[self{ this->shared_from_this() }](const boost::system::error_code &n_error, const std::size_t) {
+
+					if (n_error) {
+						self->finish(n_error);
+						return;
+					}
+
+					// Nothing may escape into io_context::run(), not even from the codec
+					try {
+						self->apply();
+					} catch (const moose_error &merr) {
+						BOOST_LOG_SEV(logger(), warning) << "Replication stream invalid: " << boost::diagnostic_information(merr);
+						self->finish(boost::asio::error::invalid_argument);
+						return;
+					} catch (const std::exception &sex) {
+						BOOST_LOG_SEV(logger(), warning) << "Cannot apply replication stream: " << sex.what();
+						self->finish(boost::asio::error::invalid_argument);
+						return;
+					}
+
+					self->read_header();
+				});
+		}
+
+		//! @throw protocol_error on invalid frames
+		void apply() {
+
+			replication::frame_reader reader(m_body.data(), m_body.size());
+			const replication::frame_type type = static_cast<replication::frame_type>(reader.u8());
+
+			switch (type) {
+				case replication::frame_type::hello:
+					replication::check_hello(m_body.data() + 1, m_body.size() - 1, sizeof(id_type));
+					m_hello_seen = true;
+					return;
+				case replication::frame_type::snapshot_begin:
+					expect_hello();
+					// The announced count is not reserved, a bad frame could ask for anything
+					reader.u64();
+					reader.u64();
+					m_staged.clear();
+					m_in_snapshot = true;
+					return;
+				case replication::frame_type::batch:
+					expect_hello();
+					apply_batch(reader);
+					return;
+				case replication::frame_type::snapshot_end: {
+					expect_hello();
+					const boost::uint64_t incarnation = reader.u64();
+					if (!m_in_snapshot) {
+						BOOST_THROW_EXCEPTION(protocol_error() << error_message("snapshot end without begin"));
+					}
+
+					// swap in the snapshot as a whole so the replica is never half populated
+					m_replica.clear();
+					m_replica.insert(m_staged.begin(), m_staged.end());
+					m_staged.clear();
+					m_staged.shrink_to_fit();
+					m_in_snapshot = false;
+					m_synchronized.store(true, std::memory_order_release);
+					updated(incarnation);
+					return;
+				}
+			}
+
+			BOOST_THROW_EXCEPTION(protocol_error() << error_message("unknown replication frame type")
+				<< error_argument(static_cast<int>(type)));
+		}
+
+		void apply_batch(replication::frame_reader &n_reader) {
+
+			const boost::uint64_t incarnation = n_reader.u64();
+			const boost::uint32_t count = n_reader.u32();
+
+			for (boost::uint32_t i = 0; i < count; ++i) {
+				const replication::entry_op op = static_cast<replication::entry_op>(n_reader.u8());
+				id_type id;
+				std::memcpy(&id, n_reader.bytes(sizeof(id_type)), sizeof(id_type));
+				const boost::uint32_t size = n_reader.u32();
+				const char *data = n_reader.bytes(size);
+
+				switch (op) {
+					case replication::entry_op::upsert: {
+						pointer_type object = m_codec.decode(id, data, size);
+						if (!object || (object->id() != id)) {
+							BOOST_THROW_EXCEPTION(serialization_error() << error_message("replication codec failed to decode object"));
+						}
+						if (m_in_snapshot) {
+							m_staged.push_back(object);
+						} else {
+							m_replica.replace(object);
+						}
+						break;
+					}
+					case replication::entry_op::remove:
+						expect_no_snapshot();
+						m_replica.remove(id);
+						break;
+					case replication::entry_op::clear:
+						expect_no_snapshot();
+						m_replica.clear();
+						break;
+					default:
+						BOOST_THROW_EXCEPTION(protocol_error() << error_message("unknown replication operation"));
+				}
+			}
+
+			if (!n_reader.done()) {
+				BOOST_THROW_EXCEPTION(protocol_error() << error_message("trailing bytes in replication batch"));
+			}
+
+			if (!m_in_snapshot) {
+				updated(incarnation);
+			}
+		}
+
+		void expect_hello() const {
+
+			if (!m_hello_seen) {
+				BOOST_THROW_EXCEPTION(protocol_error() << error_message("replication stream without hello"));
+			}
+		}
+
+		//! snapshots only contain upserts, anything else would hit the live replica
+		void expect_no_snapshot() const {
+
+			if (m_in_snapshot) {
+				BOOST_THROW_EXCEPTION(protocol_error() << error_message("replication snapshot with other than upserts"));
+			}
+		}
+
+		void updated(const boost::uint64_t n_incarnation) {
+
+			m_remote_incarnation.store(n_incarnation, std::memory_order_release);
+			if (m_update_handler) {
+				m_update_handler(n_incarnation);
+			}
+		}
+
+		void finish(const boost::system::error_code &n_error) {
+
+			boost::system::error_code ignored;
+			m_socket.close(ignored);
+			m_synchronized.store(false, std::memory_order_release);
+			if (m_stop_handler) {
+				m_stop_handler(n_error);
+			}
+		}
+
+		boost::asio::ip::tcp::socket  m_socket;
+		char                          m_header[4];
+		std::vector<char>             m_body;
+
+		container_type               &m_replica;
+		std::vector<pointer_type>     m_staged;
+		bool                          m_in_snapshot = false;
+		bool                          m_hello_seen = false;
+		std::atomic<boost::uint64_t>  m_remote_incarnation{ 0 };
+		std::atomic<bool>             m_synchronized{ false };
+
+		update_handler                m_update_handler;
+		stop_handler                  m_stop_handler;
+		const Codec                   m_codec;
+};
+
+#if defined(BOOST_MSVC)
+MOOSE_TOOLS_API void IdTaggedReplicationGetRidOfLNK4221();
+#endif
+
+} // namespace tools
+} // namespace moose
@@ -0,0 +1,185 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include "IdTaggedSnapshot.hpp"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <cstring>
+#include <fstream>
+
+namespace moose {
+namespace tools {
+
+namespace fs = boost::filesystem;
+namespace bip = boost::interprocess;
+
+namespace {
+
+	const char            snapshot_magic[8]    = { 'M', 'O', 'O', 'S', 'E', 'S', 'N', 'P' };
+	const boost::uint32_t snapshot_version     = 1;
+	const boost::uint32_t snapshot_byte_order  = 0x01020304;
+
+	//! sections start at 8 byte boundaries so the mapped arrays are aligned
+	inline boost::uint64_t snapshot_align(const boost::uint64_t n_offset) noexcept {
+
+		return (n_offset + 7) & ~boost::uint64_t(7);
+	}
+}
+
+void write_id_tagged_snapshot(const fs::path &n_path, const boost::uint64_t n_incarnation,
+		const boost::uint32_t n_id_size, const void *n_ids, const boost::uint64_t n_count,
+		const std::function<void (const std::size_t n_index, std::string &n_buffer)> &n_payload) {
+
+	IdTaggedSnapshotHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+	header.version        = snapshot_version;
+	header.byte_order     = snapshot_byte_order;
+	header.id_size        = n_id_size;
+	header.incarnation    = n_incarnation;
+	header.count          = n_count;
+	header.ids_offset     = snapshot_align(sizeof(IdTaggedSnapshotHeader));
+	header.offsets_offset = snapshot_align(header.ids_offset + n_count * n_id_size);
+	header.payload_offset = header.offsets_offset + (n_count + 1) * sizeof(boost::uint64_t);
+
+	const fs::path tmp_path = n_path.string() + ".tmp";
+
+	{
+		std::ofstream out(tmp_path.string(), std::ios::binary | std::ios::trunc);
+		if (!out) {
+			BOOST_THROW_EXCEPTION(file_error() << error_message("Cannot open snapshot file for writing")
+				<< error_argument(tmp_path.string()));
+		}
+
+		// As all section sizes except the payload are known up front I can stream
+		// the payload right into place and write the offsets afterwards.
+		std::vector<boost::uint64_t> offsets;
+		offsets.reserve(static_cast<std::size_t>(n_count + 1));
+		std::string buffer;
+		boost::uint64_t payload_size = 0;
+
+		out.seekp(static_cast<std::streamoff>(header.payload_offset));
+		for (std::size_t i = 0; i < n_count; ++i) {
+			buffer.clear();
+			n_payload(i, buffer);
+			offsets.push_back(payload_size);
+			out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+			payload_size += buffer.size();
+		}
+		offsets.push_back(payload_size);
+		header.payload_size = payload_size;
+
+		const char padding[8] = { 0 };
+		out.seekp(0);
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		out.write(padding, static_cast<std::streamsize>(header.ids_offset - sizeof(header)));
+		out.write(static_cast<const char *>(n_ids), static_cast<std::streamsize>(n_count * n_id_size));
+		out.write(padding, static_cast<std::streamsize>(header.offsets_offset - (header.ids_offset + n_count * n_id_size)));
+		out.write(reinterpret_cast<const char *>(offsets.data()), static_cast<std::streamsize>(offsets.size() * sizeof(boost::uint64_t)));
+
+		out.flush();
+		if (!out) {
+			BOOST_THROW_EXCEPTION(file_error() << error_message("Cannot write snapshot file")
+				<< error_argument(tmp_path.string()));
+		}
+	}
+
+	boost::system::error_code ec;
+	fs::rename(tmp_path, n_path, ec);
+	if (ec) {
+		BOOST_THROW_EXCEPTION(file_error() << error_message("Cannot move snapshot file into place")
+			<< error_argument(n_path.string()) << error_code(ec));
+	}
+}
+
+struct IdTaggedSnapshotFileImpl : public Pimplee {
+
+	bip::file_mapping   m_mapping;
+	bip::mapped_region  m_region;
+	IdTaggedSnapshotHeader const *m_header = nullptr;
+};
+
+IdTaggedSnapshotFile::IdTaggedSnapshotFile(const fs::path &n_path, const boost::uint32_t n_id_size) {
+
+	try {
+		d().m_mapping = bip::file_mapping(n_path.string().c_str(), bip::read_only);
+		d().m_region = bip::mapped_region(d().m_mapping, bip::read_only);
+	} catch (const bip::interprocess_exception &iex) {
+		BOOST_THROW_EXCEPTION(file_error() << error_message("Cannot map snapshot file")
+			<< error_argument(n_path.string()) << errno_code(iex.get_native_error()));
+	}
+
+	const std::size_t size = d().m_region.get_size();
+	if (size < sizeof(IdTaggedSnapshotHeader)) {
+		BOOST_THROW_EXCEPTION(serialization_error() << error_message("Snapshot file too small")
+			<< error_argument(n_path.string()));
+	}
+
+	const IdTaggedSnapshotHeader *header = static_cast<const IdTaggedSnapshotHeader *>(d().m_region.get_address());
+	if (std::memcmp(header->magic, snapshot_magic, sizeof(snapshot_magic)) != 0) {
+		BOOST_THROW_EXCEPTION(serialization_error() << error_message("Not a snapshot file")
+			<< error_argument(n_path.string()));
+	}
+
+	if ((header->version != snapshot_version) || (header->byte_order != snapshot_byte_order) || (header->id_size != n_id_size)) {
+		BOOST_THROW_EXCEPTION(serialization_error() << error_message("Snapshot version, byte order or id size mismatch")
+			<< error_argument(n_path.string()));
+	}
+
+	// All sections must be where the count says they are and within the file.
+	// Every count is checked against the remaining size before it is multiplied so that
+	// hostile values cannot wrap around and pass. I don't validate the offsets table
+	// as this would touch all pages.
+	const boost::uint64_t ids_offset = snapshot_align(sizeof(IdTaggedSnapshotHeader));
+	bool valid = (header->ids_offset == ids_offset) && (n_id_size > 0) && (ids_offset <= size)
+			&& (header->count <= (size - ids_offset) / n_id_size);
+
+	const boost::uint64_t offsets_offset = valid ? snapshot_align(ids_offset + header->count * n_id_size) : 0;
+	valid = valid && (header->offsets_offset == offsets_offset) && (offsets_offset <= size)
+			&& (header->count < (size - offsets_offset) / sizeof(boost::uint64_t));
+
+	const boost::uint64_t payload_offset = valid ? offsets_offset + (header->count + 1) * sizeof(boost::uint64_t) : 0;
+	valid = valid && (header->payload_offset == payload_offset) && (header->payload_size == size - payload_offset);
+
+	if (!valid) {
+		BOOST_THROW_EXCEPTION(serialization_error() << error_message("Snapshot file truncated or corrupt")
+			<< error_argument(n_path.string()));
+	}
+
+	d().m_header = header;
+}
+
+IdTaggedSnapshotFile::~IdTaggedSnapshotFile() noexcept {
+
+}
+
+const IdTaggedSnapshotHeader &IdTaggedSnapshotFile::header() const noexcept {
+
+	return *d().m_header;
+}
+
+const void *IdTaggedSnapshotFile::ids() const noexcept {
+
+	return static_cast<const char *>(d().m_region.get_address()) + d().m_header->ids_offset;
+}
+
+const boost::uint64_t *IdTaggedSnapshotFile::offsets() const noexcept {
+
+	return reinterpret_cast<const boost::uint64_t *>(static_cast<const char *>(d().m_region.get_address()) + d().m_header->offsets_offset);
+}
+
+const char *IdTaggedSnapshotFile::payload() const noexcept {
+
+	return static_cast<const char *>(d().m_region.get_address()) + d().m_header->payload_offset;
+}
+
+#if defined(BOOST_MSVC)
+void IdTaggedSnapshotGetRidOfLNK4221() {}
+#endif
+
+} // namespace tools
+} // namespace moose
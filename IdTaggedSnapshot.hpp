@@ -0,0 +1,253 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+#include "MooseToolsConfig.hpp"
+#include "IdTaggedContainer.hpp"
+#include "Pimpled.hpp"
+#include "Error.hpp"
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace moose {
+namespace tools {
+
+/*! @brief binary snapshot format for IdTaggedContainer
+
+	The file consists of:
+	 * a fixed header with incarnation, element count and the offsets of all following sections
+	 * the ids of all elements in ascending order
+	 * count + 1 offsets into the payload region, so element i spans [offset[i], offset[i + 1])
+	 * the payload region holding whatever the codec wrote per element
+
+	All values are in native byte order. The header contains a marker so files from
+	machines with different endianness or id size are rejected instead of misread.
+
+	A codec must look like this:
+
+	struct MyCodec {
+		//! append the serialized form of n_object to n_buffer
+		void encode(const MyType &n_object, std::string &n_buffer) const;
+
+		//! create an object with the given id from the serialized form
+		std::shared_ptr<MyType> decode(const MyType::id_type n_id, const char *n_data, const std::size_t n_size) const;
+	};
+ */
+struct IdTaggedSnapshotHeader {
+
+	char            magic[8];          //!< "MOOSESNP"
+	boost::uint32_t version;
+	boost::uint32_t byte_order;        //!< 0x01020304 as written by the creator
+	boost::uint32_t id_size;           //!< sizeof(id_type)
+	boost::uint32_t reserved;
+	boost::uint64_t incarnation;       //!< incarnation of the container when saved
+	boost::uint64_t count;             //!< number of elements
+	boost::uint64_t ids_offset;        //!< file offset of the sorted id array
+	boost::uint64_t offsets_offset;    //!< file offset of the payload offsets table
+	boost::uint64_t payload_offset;    //!< file offset of the payload region
+	boost::uint64_t payload_size;      //!< bytes in the payload region
+};
+
+/*! @brief write a snapshot file from pre-sorted ids and a payload producer
+
+	Used by save_snapshot(), you probably want to use that instead.
+	The file is written to a temporary name next to n_path and renamed when complete
+	so readers never see partial files.
+
+	@param n_ids pointer to n_count ids of n_id_size bytes each, sorted ascending
+	@param n_payload called for every index in order and must append that element's payload
+	@throw file_error on IO errors
+ */
+MOOSE_TOOLS_API void write_id_tagged_snapshot(const boost::filesystem::path &n_path, const boost::uint64_t n_incarnation,
+		const boost::uint32_t n_id_size, const void *n_ids, const boost::uint64_t n_count,
+		const std::function<void (const std::size_t n_index, std::string &n_buffer)> &n_payload);
+
+struct IdTaggedSnapshotFileImpl;
+
+/*! @brief a read-only memory mapped snapshot file
+
+	This only validates the header and the section bounds. No element is touched
+	so opening is O(1) regardless of size.
+ */
+class IdTaggedSnapshotFile : private Pimpled<IdTaggedSnapshotFileImpl> {
+
+	public:
+		/*! @brief map the file and validate the header against the expected id size
+			@throw file_error when the file cannot be mapped
+			@throw serialization_error when the content is not a valid snapshot
+		 */
+		MOOSE_TOOLS_API IdTaggedSnapshotFile(const boost::filesystem::path &n_path, const boost::uint32_t n_id_size);
+		MOOSE_TOOLS_API ~IdTaggedSnapshotFile() noexcept;
+
+		MOOSE_TOOLS_API const IdTaggedSnapshotHeader &header() const noexcept;
+
+		//! start of the sorted id array
+		MOOSE_TOOLS_API const void *ids() const noexcept;
+
+		//! count + 1 payload offsets
+		MOOSE_TOOLS_API const boost::uint64_t *offsets() const noexcept;
+
+		//! start of the payload region
+		MOOSE_TOOLS_API const char *payload() const noexcept;
+};
+
+/*! @brief write the content of n_container into a snapshot file at n_path
+
+	@throw file_error on IO errors
+	@throw whatever the codec throws
+ */
+template <typename TaggedType, typename Codec>
+void save_snapshot(const IdTaggedContainer<TaggedType> &n_container, const boost::filesystem::path &n_path, const Codec &n_codec = Codec()) {
+
+	using id_type = typename TaggedType::id_type;
+	static_assert(std::is_trivially_copyable<id_type>::value, "snapshot ids must be trivially copyable");
+
+	// gather and sort the pointers so payloads come in id order
+	std::vector<typename IdTaggedContainer<TaggedType>::pointer_type> objects(n_container.begin(), n_container.end());
+	std::sort(objects.begin(), objects.end(), [](const auto &n_lhs, const auto &n_rhs) {
+		return n_lhs->id() < n_rhs->id();
+	});
+
+	std::vector<id_type> ids;
+	ids.reserve(objects.size());
+	for (const auto &o : objects) {
+		ids.push_back(o->id());
+	}
+
+	write_id_tagged_snapshot(n_path, n_container.incarnation(), sizeof(id_type), ids.data(), ids.size(),
+		[&](const std::size_t n_index, std::string &n_buffer) {
+			n_codec.encode(*objects[n_index], n_buffer);
+		});
+}
+
+/*! @brief zero-copy view on a snapshot file of IdTaggedContainer<TaggedType>
+
+	The file is mapped, not read. Lookups use binary search on the mapped id array
+	and objects are decoded only when asked for, so there is no per-element work at startup.
+	Use load() to populate a real container from it.
+ */
+template <typename TaggedType>
+class IdTaggedSnapshot {
+
+	public:
+		using id_type      = typename TaggedType::id_type;
+		using pointer_type = typename IdTaggedContainer<TaggedType>::pointer_type;
+
+		static_assert(std::is_trivially_copyable<id_type>::value, "snapshot ids must be trivially copyable");
+
+		/*! @brief map a snapshot file
+			@throw file_error when the file cannot be mapped
+			@throw serialization_error when the content is not a valid snapshot
+		 */
+		explicit IdTaggedSnapshot(const boost::filesystem::path &n_path)
+				: m_file(n_path, sizeof(id_type))
+				, m_ids(static_cast<const id_type *>(m_file.ids())) {
+		}
+
+		IdTaggedSnapshot(const IdTaggedSnapshot &n_other) = delete;
+
+		//! incarnation of the container when the snapshot was taken
+		boost::uint64_t incarnation() const noexcept {
+
+			return m_file.header().incarnation;
+		}
+
+		std::size_t size() const noexcept {
+
+			return static_cast<std::size_t>(m_file.header().count);
+		}
+
+		bool empty() const noexcept {
+
+			return size() == 0;
+		}
+
+		//! the n-th id in ascending order
+		id_type id(const std::size_t n_index) const {
+
+			if (n_index >= size()) {
+				BOOST_THROW_EXCEPTION(internal_error() << error_message("snapshot index out of bounds")
+					<< error_argument(n_index));
+			}
+			return m_ids[n_index];
+		}
+
+		//! Is there one with that id? O(log n) on the mapped ids
+		bool has(const id_type n_id) const noexcept {
+
+			return std::binary_search(m_ids, m_ids + size(), n_id);
+		}
+
+		/*! @brief decode the object with the given id
+			@return null on not found
+			@throw whatever the codec throws
+		 */
+		template <typename Codec>
+		pointer_type get(const id_type n_id, const Codec &n_codec = Codec()) const {
+
+			const id_type *i = std::lower_bound(m_ids, m_ids + size(), n_id);
+			if ((i == m_ids + size()) || (*i != n_id)) {
+				return pointer_type();
+			}
+
+			return decode(static_cast<std::size_t>(i - m_ids), n_codec);
+		}
+
+		/*! @brief decode all objects and insert them into n_container
+
+			As ids come in order, insertion into the ordered index is amortized O(1).
+			@return number of objects inserted
+			@throw serialization_error when the codec returns null or a wrong id
+		 */
+		template <typename Codec>
+		std::size_t load(IdTaggedContainer<TaggedType> &n_container, const Codec &n_codec = Codec()) const {
+
+			std::vector<pointer_type> objects;
+			objects.reserve(size());
+			for (std::size_t i = 0; i < size(); ++i) {
+				objects.push_back(decode(i, n_codec));
+			}
+
+			return n_container.insert(objects.begin(), objects.end());
+		}
+
+	private:
+		template <typename Codec>
+		pointer_type decode(const std::size_t n_index, const Codec &n_codec) const {
+
+			const boost::uint64_t *offsets = m_file.offsets();
+			if ((offsets[n_index] > offsets[n_index + 1]) || (offsets[n_index + 1] > m_file.header().payload_size)) {
+				BOOST_THROW_EXCEPTION(serialization_error() << error_message("snapshot payload offsets corrupt")
+					<< error_argument(n_index));
+			}
+
+			pointer_type ret = n_codec.decode(m_ids[n_index], m_file.payload() + offsets[n_index],
+					static_cast<std::size_t>(offsets[n_index + 1] - offsets[n_index]));
+
+			if (!ret || (ret->id() != m_ids[n_index])) {
+				BOOST_THROW_EXCEPTION(serialization_error() << error_message("snapshot codec failed to decode object")
+					<< error_argument(n_index));
+			}
+
+			return ret;
+		}
+
+		IdTaggedSnapshotFile  m_file;
+		const id_type        *m_ids;
+};
+
+#if defined(BOOST_MSVC)
+MOOSE_TOOLS_API void IdTaggedSnapshotGetRidOfLNK4221();
+#endif
+
+} // namespace tools
+} // namespace moose
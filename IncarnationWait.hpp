@@ -0,0 +1,123 @@
+//  Copyright 2019 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+#include "MooseToolsConfig.hpp"
+#include "Carne.hpp"
+
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <chrono>
+#include <memory>
+
+#include <boost/asio/yield.hpp>
+
+// only used by async_wait_changed. Do not use this, look below
+template <typename IncarnatedType>
+struct async_wait_changed_implementation {
+
+	// The object is owned outside and must outlive the operation
+	const IncarnatedType              &m_object;
+	const boost::uint64_t              m_known_incarnation;
+
+	// Runs on a strand, which serializes our own steps with the cancel a writer posts.
+	// Otherwise a notification could arrive between checking and starting the wait
+	std::shared_ptr<boost::asio::steady_timer> m_timer;
+	boost::uint64_t                    m_ticket;
+
+	boost::asio::coroutine             m_coro;
+
+	template <typename Self>
+	void operator()(Self &n_self, const boost::system::error_code &n_error = boost::system::error_code()) {
+
+		reenter(m_coro) {
+
+			// get on the strand first, this also keeps us from completing inside the initiating function
+			yield boost::asio::post(m_timer->get_executor(), std::move(n_self));
+
+			for (;;) {
+				// Register before checking so a change in between is not lost.
+				// The writer's thread only posts the cancel, which can't overtake us on the strand
+				m_ticket = moose::tools::detail::incarnation_add_async_waiter(&m_object, [timer{ m_timer }]() {
+					boost::asio::post(timer->get_executor(), [timer]() {
+						timer->cancel();
+					});
+				});
+
+				if (m_object.changed(m_known_incarnation)) {
+					moose::tools::detail::incarnation_remove_async_waiter(&m_object, m_ticket);
+					n_self.complete(boost::system::error_code());
+					return;
+				}
+
+				yield m_timer->async_wait(std::move(n_self));
+
+				moose::tools::detail::incarnation_remove_async_waiter(&m_object, m_ticket);
+
+				if (m_object.changed(m_known_incarnation)) {
+					n_self.complete(boost::system::error_code());
+					return;
+				}
+
+				// Not cancelled means the timer ran out
+				if (!n_error) {
+					n_self.complete(boost::asio::error::timed_out);
+					return;
+				}
+
+				// Cancelled by a notification for another object hashing the same or
+				// a stale one. The timer keeps its expiry so I can just wait again.
+			}
+		}
+	}
+};
+
+#include <boost/asio/unyield.hpp>
+
+namespace moose {
+namespace tools {
+
+/*! @brief a composed operation waiting for an Incarnated object to change
+
+	Same as Incarnated::wait_changed() but completes on n_executor instead of blocking.
+	Writers only pay for this when an operation is waiting.
+
+	@param n_executor where the completion handler is called
+	@param n_object must outlive the operation
+	@param n_known_incarnation complete once the incarnation is higher than this
+	@param n_timeout complete with boost::asio::error::timed_out after this
+	@param n_token a completion handler with signature void (boost::system::error_code)
+ */
+template <typename Executor, typename DerivedType, typename ParentType, typename Counter, typename CompletionToken>
+auto async_wait_changed(const Executor &n_executor, const Incarnated<DerivedType, ParentType, Counter> &n_object,
+			const boost::uint64_t n_known_incarnation, const std::chrono::steady_clock::duration n_timeout,
+			CompletionToken &&n_token)
+	-> typename boost::asio::async_result<
+			typename std::decay<CompletionToken>::type,
+			void (boost::system::error_code)
+	>::return_type {
+
+	std::shared_ptr<boost::asio::steady_timer> timer{ std::make_shared<boost::asio::steady_timer>(boost::asio::make_strand(n_executor)) };
+	timer->expires_after(n_timeout);
+
+	return boost::asio::async_compose<CompletionToken, void (boost::system::error_code)>(
+		async_wait_changed_implementation<Incarnated<DerivedType, ParentType, Counter> >{
+				n_object,
+				n_known_incarnation,
+				timer,
+				0,
+				boost::asio::coroutine() },
+		n_token, *timer);
+}
+
+#if defined(BOOST_MSVC)
+MOOSE_TOOLS_API void IncarnationWaitGetRidOfLNK4221();
+#endif
+
+}
+}
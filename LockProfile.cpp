@@ -0,0 +1,337 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include "LockProfile.hpp"
+#include "Log.hpp"
+
+#include <boost/core/demangle.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+namespace moose {
+namespace tools {
+
+namespace detail {
+
+//! One per site and thread. Only the owning thread writes, so no atomic increments
+struct lock_profile_record {
+
+	using counter = std::atomic<boost::uint64_t>;
+
+	counter  m_acquisitions{ 0 };
+	counter  m_contended{ 0 };
+	counter  m_wait_ns{ 0 };
+	counter  m_hold_ns{ 0 };
+	counter  m_wait_histogram[lock_profile_buckets] = {};
+	counter  m_hold_histogram[lock_profile_buckets] = {};
+};
+
+} // namespace detail
+
+namespace {
+
+	using lock_profile_record = detail::lock_profile_record;
+
+	inline void lock_profile_bump(std::atomic<boost::uint64_t> &n_counter, const boost::uint64_t n_value = 1) noexcept {
+
+		n_counter.store(n_counter.load(std::memory_order_relaxed) + n_value, std::memory_order_relaxed);
+	}
+
+	inline std::size_t lock_profile_bucket(boost::uint64_t n_ns) noexcept {
+
+		std::size_t ret = 0;
+		while ((n_ns >>= 1) && (ret < lock_profile_buckets - 1)) {
+			++ret;
+		}
+		return ret;
+	}
+
+	struct lock_site_key {
+
+		const std::type_info *m_type;
+		const char           *m_file;
+		unsigned int          m_line;
+
+		bool operator==(const lock_site_key &n_other) const noexcept {
+
+			return (m_type == n_other.m_type) && (m_file == n_other.m_file) && (m_line == n_other.m_line);
+		}
+	};
+
+	struct lock_site_key_hash {
+
+		std::size_t operator()(const lock_site_key &n_key) const noexcept {
+
+			return std::hash<const void *>()(n_key.m_type) ^ (std::hash<const void *>()(n_key.m_file) << 1) ^ n_key.m_line;
+		}
+	};
+
+	/*! The owning thread looks up without lock as nobody else modifies the map.
+		It only locks to insert so a concurrent snapshot doesn't iterate a changing map.
+	 */
+	struct lock_profile_buffer {
+
+		boost::uint64_t                                                                  m_serial;  //!< never reused, unlike the address
+		std::mutex                                                                       m_mutex;
+		std::unordered_map<lock_site_key, lock_profile_record, lock_site_key_hash>       m_sites;
+	};
+
+	/*! Buffers of running threads plus the sum of those that ended, so
+		short lived threads don't make this grow. Lock before any buffer.
+	 */
+	struct lock_profile_registry {
+
+		std::mutex                                                               m_mutex;
+		std::vector<lock_profile_buffer *>                                       m_buffers;
+		std::unordered_map<lock_site_key, LockSiteProfile, lock_site_key_hash>   m_retired;
+	};
+
+	lock_profile_registry &lock_profile_buffers() {
+
+		static lock_profile_registry registry;
+		return registry;
+	}
+
+	void lock_profile_add(LockProfileHistogram &n_target, const std::atomic<boost::uint64_t> (&n_source)[lock_profile_buckets]) noexcept {
+
+		for (std::size_t i = 0; i < lock_profile_buckets; ++i) {
+			n_target[i] += n_source[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	void lock_profile_add(LockSiteProfile &n_target, const lock_profile_record &n_source) noexcept {
+
+		n_target.acquisitions += n_source.m_acquisitions.load(std::memory_order_relaxed);
+		n_target.contended += n_source.m_contended.load(std::memory_order_relaxed);
+		n_target.wait_ns += n_source.m_wait_ns.load(std::memory_order_relaxed);
+		n_target.hold_ns += n_source.m_hold_ns.load(std::memory_order_relaxed);
+		lock_profile_add(n_target.wait_histogram, n_source.m_wait_histogram);
+		lock_profile_add(n_target.hold_histogram, n_source.m_hold_histogram);
+	}
+
+	//! hands the numbers over to the registry when its thread ends
+	struct lock_profile_buffer_owner {
+
+		std::unique_ptr<lock_profile_buffer>  m_buffer;
+
+		~lock_profile_buffer_owner() noexcept {
+
+			if (!m_buffer) {
+				return;
+			}
+
+			lock_profile_registry &registry = lock_profile_buffers();
+			std::lock_guard<std::mutex> rlock(registry.m_mutex);
+			registry.m_buffers.erase(std::find(registry.m_buffers.begin(), registry.m_buffers.end(), m_buffer.get()));
+
+			try {
+				for (const auto &site : m_buffer->m_sites) {
+					lock_profile_add(registry.m_retired[site.first], site.second);
+				}
+			} catch (...) {
+				// Out of memory. What this thread recorded is lost
+			}
+		}
+	};
+
+	lock_profile_buffer &local_lock_profile_buffer() {
+
+		static std::atomic<boost::uint64_t> serials{ 0 };
+		thread_local lock_profile_buffer_owner owner;
+		if (!owner.m_buffer) {
+			std::unique_ptr<lock_profile_buffer> buffer = std::make_unique<lock_profile_buffer>();
+			buffer->m_serial = serials.fetch_add(1, std::memory_order_relaxed) + 1;
+			lock_profile_registry &registry = lock_profile_buffers();
+			std::lock_guard<std::mutex> slock(registry.m_mutex);
+			registry.m_buffers.push_back(buffer.get());
+			owner.m_buffer = std::move(buffer);
+		}
+		return *owner.m_buffer;
+	}
+
+	/*! A moved lock may be used on another thread. That one must not write the acquiring
+		thread's record, which may even be gone by now, so it switches to its own for the same site.
+		Only the serial is compared, the record is not touched.
+		@return false if the calling thread has no record and cannot get one
+	 */
+	bool lock_profile_rebind(detail::lock_profile_site_ref &n_site) noexcept {
+
+		try {
+			if (n_site.m_thread != local_lock_profile_buffer().m_serial) {
+				n_site = detail::lock_profile_site(*n_site.m_type, n_site.m_file, n_site.m_line);
+			}
+		} catch (const std::exception &) {
+			return false;
+		}
+		return true;
+	}
+
+	void lock_profile_dump_loop(std::shared_ptr<boost::asio::steady_timer> n_timer, const std::chrono::steady_clock::duration n_interval) {
+
+		n_timer->expires_after(n_interval);
+		n_timer->async_wait([n_timer, n_interval](const boost::system::error_code &n_error) {
+
+			if (n_error) {
+				return;
+			}
+
+			try {
+				dump_lock_profile();
+			} catch (const std::exception &sex) {
+				BOOST_LOG_SEV(logger(), warning) << "Cannot dump lock profile: " << sex.what();
+			}
+
+			lock_profile_dump_loop(n_timer, n_interval);
+		});
+	}
+}
+
+bool lock_profiling_enabled() noexcept {
+
+#if defined(MOOSE_TOOLS_LOCK_PROFILING)
+	return true;
+#else
+	return false;
+#endif
+}
+
+LockProfileSnapshot lock_profile() {
+
+	LockProfileSnapshot ret;
+	ret.taken = std::chrono::system_clock::now();
+
+	// Held throughout so no thread hands its numbers over while I'm adding them up
+	lock_profile_registry &registry = lock_profile_buffers();
+	std::unique_lock<std::mutex> rlock(registry.m_mutex);
+
+	// the same site from all threads ends up in one
+	std::unordered_map<lock_site_key, LockSiteProfile, lock_site_key_hash> sites(registry.m_retired);
+	for (lock_profile_buffer *buffer : registry.m_buffers) {
+		std::lock_guard<std::mutex> slock(buffer->m_mutex);
+		for (const auto &site : buffer->m_sites) {
+			lock_profile_add(sites[site.first], site.second);
+		}
+	}
+	rlock.unlock();
+
+	ret.sites.reserve(sites.size());
+	for (auto &site : sites) {
+		LockSiteProfile &p = site.second;
+		p.type = boost::core::demangle(site.first.m_type->name());
+		p.file = site.first.m_file;
+		p.line = site.first.m_line;
+		ret.sites.push_back(std::move(p));
+	}
+
+	std::sort(ret.sites.begin(), ret.sites.end(), [](const LockSiteProfile &n_lhs, const LockSiteProfile &n_rhs) {
+		return n_lhs.wait_ns > n_rhs.wait_ns;
+	});
+
+	return ret;
+}
+
+void reset_lock_profile() noexcept {
+
+	lock_profile_registry &registry = lock_profile_buffers();
+	std::lock_guard<std::mutex> rlock(registry.m_mutex);
+	registry.m_retired.clear();
+
+	for (lock_profile_buffer *buffer : registry.m_buffers) {
+		std::lock_guard<std::mutex> slock(buffer->m_mutex);
+		for (auto &site : buffer->m_sites) {
+			lock_profile_record &record = site.second;
+			record.m_acquisitions.store(0, std::memory_order_relaxed);
+			record.m_contended.store(0, std::memory_order_relaxed);
+			record.m_wait_ns.store(0, std::memory_order_relaxed);
+			record.m_hold_ns.store(0, std::memory_order_relaxed);
+			for (std::size_t i = 0; i < lock_profile_buckets; ++i) {
+				record.m_wait_histogram[i].store(0, std::memory_order_relaxed);
+				record.m_hold_histogram[i].store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+}
+
+void dump_lock_profile() {
+
+	const LockProfileSnapshot profile = lock_profile();
+	for (const LockSiteProfile &site : profile.sites) {
+		if (!site.acquisitions) {
+			continue;
+		}
+
+		BOOST_LOG_SEV(logger(), normal) << "Lock profile " << site.type << " at " << site.file << ":" << site.line
+			<< " acquired " << site.acquisitions << " times, " << site.contended << " contended, waited "
+			<< (site.wait_ns / 1000) << "us, held " << (site.hold_ns / 1000) << "us in total";
+	}
+}
+
+std::shared_ptr<boost::asio::steady_timer> start_lock_profile_dump(boost::asio::io_context &n_io,
+		const std::chrono::steady_clock::duration n_interval) {
+
+	std::shared_ptr<boost::asio::steady_timer> timer = std::make_shared<boost::asio::steady_timer>(n_io);
+	lock_profile_dump_loop(timer, n_interval);
+	return timer;
+}
+
+namespace detail {
+
+lock_profile_site_ref lock_profile_site(const std::type_info &n_type, const char *n_file, const unsigned int n_line) {
+
+	lock_profile_buffer &buffer = local_lock_profile_buffer();
+	const lock_site_key key{ &n_type, n_file, n_line };
+	lock_profile_site_ref ret;
+	ret.m_thread = buffer.m_serial;
+	ret.m_type = &n_type;
+	ret.m_file = n_file;
+	ret.m_line = n_line;
+
+	auto i = buffer.m_sites.find(key);
+	if (i != buffer.m_sites.end()) {
+		ret.m_record = &i->second;
+		return ret;
+	}
+
+	std::lock_guard<std::mutex> slock(buffer.m_mutex);
+	ret.m_record = &buffer.m_sites[key];
+	return ret;
+}
+
+void lock_profile_acquired(lock_profile_site_ref &n_site, const bool n_contended, const boost::uint64_t n_wait_ns) noexcept {
+
+	if (!lock_profile_rebind(n_site)) {
+		return;
+	}
+
+	lock_profile_record *record = n_site.m_record;
+	lock_profile_bump(record->m_acquisitions);
+	if (n_contended) {
+		lock_profile_bump(record->m_contended);
+	}
+	lock_profile_bump(record->m_wait_ns, n_wait_ns);
+	lock_profile_bump(record->m_wait_histogram[lock_profile_bucket(n_wait_ns)]);
+}
+
+void lock_profile_released(lock_profile_site_ref &n_site, const boost::uint64_t n_hold_ns) noexcept {
+
+	if (!lock_profile_rebind(n_site)) {
+		return;
+	}
+
+	lock_profile_record *record = n_site.m_record;
+	lock_profile_bump(record->m_hold_ns, n_hold_ns);
+	lock_profile_bump(record->m_hold_histogram[lock_profile_bucket(n_hold_ns)]);
+}
+
+} // namespace detail
+
+#if defined(BOOST_MSVC)
+void LockProfileGetRidOfLNK4221() {}
+#endif
+
+}
+}
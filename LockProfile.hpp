@@ -0,0 +1,113 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+#include "MooseToolsConfig.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/cstdint.hpp>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace moose {
+namespace tools {
+
+/*! @brief lock contention profiling for Mutexed
+
+	Only collects data when built with MOOSE_TOOLS_LOCK_PROFILING. Then every
+	Mutexed::scoped_lock records how long it waited, whether it had to wait at all
+	and how long it was held, keyed by the Mutexed type and the source location
+	that acquired it. Data goes into per-thread buffers without any shared writes,
+	so the cost per lock is a hash lookup and two or three clock reads.
+	A lock released by another thread than the one that acquired it counts its
+	hold time in the releasing thread's buffer. When a thread ends its numbers
+	are added to a common total and its buffer is freed.
+ */
+
+//! Histogram bucket i counts durations in [2^i, 2^(i+1)) nanoseconds, bucket 0 also 0
+const std::size_t lock_profile_buckets = 32;
+
+using LockProfileHistogram = std::array<boost::uint64_t, lock_profile_buckets>;
+
+//! aggregated numbers for one lock acquisition site
+struct LockSiteProfile {
+
+	std::string           type;           //!< the Mutexed derived type, demangled
+	std::string           file;
+	unsigned int          line = 0;
+
+	boost::uint64_t       acquisitions = 0;
+	boost::uint64_t       contended = 0;  //!< acquisitions that had to wait
+	boost::uint64_t       wait_ns = 0;    //!< total time spent waiting
+	boost::uint64_t       hold_ns = 0;    //!< total time held
+	LockProfileHistogram  wait_histogram = {};
+	LockProfileHistogram  hold_histogram = {};
+};
+
+struct LockProfileSnapshot {
+
+	std::chrono::system_clock::time_point  taken;
+	std::vector<LockSiteProfile>           sites;  //!< sorted by total wait time, longest first
+};
+
+//! true if built with MOOSE_TOOLS_LOCK_PROFILING
+MOOSE_TOOLS_API bool lock_profiling_enabled() noexcept;
+
+/*! @brief sum up what all threads recorded so far
+	@throw std::bad_alloc
+ */
+MOOSE_TOOLS_API LockProfileSnapshot lock_profile();
+
+//! set all counters to 0. Locks released concurrently may still count
+MOOSE_TOOLS_API void reset_lock_profile() noexcept;
+
+//! write the current profile to the log, one line per site
+MOOSE_TOOLS_API void dump_lock_profile();
+
+/*! @brief dump_lock_profile() every n_interval on n_io
+	@return the timer driving it, cancel to stop
+ */
+MOOSE_TOOLS_API std::shared_ptr<boost::asio::steady_timer> start_lock_profile_dump(boost::asio::io_context &n_io,
+		const std::chrono::steady_clock::duration n_interval);
+
+namespace detail {
+
+struct lock_profile_record;
+
+/*! @brief what a lock records into
+
+	The record lives in the buffer of the thread that looked it up and is freed when
+	that thread ends. So it is only ever touched from that thread, others look up their own.
+ */
+struct lock_profile_site_ref {
+
+	lock_profile_record   *m_record = nullptr;
+	boost::uint64_t        m_thread = 0;     //!< serial of the thread m_record belongs to
+	const std::type_info  *m_type = nullptr;
+	const char            *m_file = nullptr;
+	unsigned int           m_line = 0;
+};
+
+//! find or create the calling thread's record for a site. Cheap after the first call
+MOOSE_TOOLS_API lock_profile_site_ref lock_profile_site(const std::type_info &n_type, const char *n_file, const unsigned int n_line);
+
+//! n_site is moved to the calling thread's record if it was looked up by another one
+MOOSE_TOOLS_API void lock_profile_acquired(lock_profile_site_ref &n_site, const bool n_contended, const boost::uint64_t n_wait_ns) noexcept;
+
+MOOSE_TOOLS_API void lock_profile_released(lock_profile_site_ref &n_site, const boost::uint64_t n_hold_ns) noexcept;
+
+} // namespace detail
+
+#if defined(BOOST_MSVC)
+MOOSE_TOOLS_API void LockProfileGetRidOfLNK4221();
+#endif
+
+}
+}
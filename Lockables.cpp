@@ -0,0 +1,100 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include "Lockables.hpp"
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <thread>
+
+namespace moose {
+namespace tools {
+
+namespace {
+
+	//! a bit more than a futex round trip on current hardware
+	const unsigned int adaptive_spin_limit = 1024;
+
+	//! re-read the node after this many calls as threads may migrate
+	const unsigned int numa_node_refresh = 256;
+}
+
+namespace detail {
+
+void futex_wait(std::atomic<boost::uint32_t> &n_address, const boost::uint32_t n_expected) noexcept {
+
+#if defined(__linux__)
+	// std::atomic<uint32_t> is layout compatible with uint32_t on all platforms we care about
+	::syscall(SYS_futex, reinterpret_cast<boost::uint32_t *>(&n_address), FUTEX_WAIT_PRIVATE, n_expected, nullptr, nullptr, 0);
+#else
+	if (n_address.load(std::memory_order_relaxed) == n_expected) {
+		std::this_thread::yield();
+	}
+#endif
+}
+
+void futex_wake_one(std::atomic<boost::uint32_t> &n_address) noexcept {
+
+#if defined(__linux__)
+	::syscall(SYS_futex, reinterpret_cast<boost::uint32_t *>(&n_address), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+	(void)n_address;
+#endif
+}
+
+unsigned int current_numa_node() noexcept {
+
+	thread_local unsigned int node = 0;
+	thread_local unsigned int calls = 0;
+
+	if ((calls++ % numa_node_refresh) == 0) {
+#if defined(__linux__) && defined(SYS_getcpu)
+		unsigned int cpu = 0;
+		unsigned int n = 0;
+		if (::syscall(SYS_getcpu, &cpu, &n, nullptr) == 0) {
+			node = n;
+		}
+#endif
+	}
+
+	return node;
+}
+
+} // namespace detail
+
+void adaptive_mutex::lock_slow() noexcept {
+
+	// spin, doubling the pause each round, as long as the holder is not sleeping
+	for (unsigned int backoff = 1; backoff < adaptive_spin_limit; backoff <<= 1) {
+		for (unsigned int i = 0; i < backoff; ++i) {
+			cpu_relax();
+		}
+
+		boost::uint32_t state = m_state.load(std::memory_order_relaxed);
+		if (state == 0) {
+			if (m_state.compare_exchange_weak(state, 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+				return;
+			}
+		} else if (state == 2) {
+			break;
+		}
+	}
+
+	// Mark as contended and sleep. Whoever gets it this way has to keep it marked
+	// as there may be more sleepers.
+	while (m_state.exchange(2, std::memory_order_acquire) != 0) {
+		detail::futex_wait(m_state, 2);
+	}
+}
+
+#if defined(BOOST_MSVC)
+void LockablesGetRidOfLNK4221() {}
+#endif
+
+}
+}
@@ -0,0 +1,228 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+#include "MooseToolsConfig.hpp"
+
+#include <boost/cstdint.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+
+namespace moose {
+namespace tools {
+
+/*! @brief Lockables for Mutexed with very short critical sections
+
+	When a section is held for less than a microsecond, going to sleep in
+	the kernel costs more than the wait itself. These spin briefly first
+	or don't sleep at all. All of them satisfy the Lockable concept
+	(lock(), try_lock(), unlock()) and can be used with Mutexed or boost::unique_lock.
+ */
+
+//! tell the CPU we are spinning. Saves power and lets the sibling hyperthread run
+inline void cpu_relax() noexcept {
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	_mm_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__))
+	__builtin_ia32_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__aarch64__) || defined(__arm__))
+	asm volatile("yield" ::: "memory");
+#endif
+}
+
+namespace detail {
+
+//! sleep while *n_address equals n_expected. Futex on Linux, yield elsewhere
+MOOSE_TOOLS_API void futex_wait(std::atomic<boost::uint32_t> &n_address, const boost::uint32_t n_expected) noexcept;
+
+//! wake one thread sleeping in futex_wait() on n_address
+MOOSE_TOOLS_API void futex_wake_one(std::atomic<boost::uint32_t> &n_address) noexcept;
+
+//! the NUMA node the calling thread runs on, cached for a while. 0 where unknown
+MOOSE_TOOLS_API unsigned int current_numa_node() noexcept;
+
+} // namespace detail
+
+/*! @brief spin with exponential backoff, then sleep on a futex
+
+	The usual three state futex mutex: 0 is free, 1 is locked and 2 is locked with
+	sleepers. Uncontended lock and unlock are one atomic each and never enter the kernel.
+ */
+class adaptive_mutex {
+
+	public:
+		adaptive_mutex() = default;
+		adaptive_mutex(const adaptive_mutex &) = delete;
+		adaptive_mutex &operator=(const adaptive_mutex &) = delete;
+
+		void lock() noexcept {
+
+			boost::uint32_t expected = 0;
+			if (m_state.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+				return;
+			}
+
+			lock_slow();
+		}
+
+		bool try_lock() noexcept {
+
+			boost::uint32_t expected = 0;
+			return m_state.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed);
+		}
+
+		void unlock() noexcept {
+
+			if (m_state.exchange(0, std::memory_order_release) == 2) {
+				detail::futex_wake_one(m_state);
+			}
+		}
+
+	private:
+		MOOSE_TOOLS_API void lock_slow() noexcept;
+
+		std::atomic<boost::uint32_t>  m_state{ 0 };
+};
+
+/*! @brief fair FIFO spin lock
+
+	Threads draw a ticket and wait for their number. Under heavy contention this
+	avoids starvation and the thundering herd of a plain spin lock, but it never sleeps.
+	Waiters yield their time slice after spinning for a while, as with more threads
+	than cores the next in line may not even be running. Still, don't use it like that.
+ */
+class ticket_mutex {
+
+	public:
+		ticket_mutex() = default;
+		ticket_mutex(const ticket_mutex &) = delete;
+		ticket_mutex &operator=(const ticket_mutex &) = delete;
+
+		void lock() noexcept {
+
+			const boost::uint32_t ticket = m_next.fetch_add(1, std::memory_order_relaxed);
+			boost::uint32_t serving = m_serving.load(std::memory_order_acquire);
+			unsigned int spun = 0;
+			while (serving != ticket) {
+				if (spun < ticket_spin_limit) {
+					// back off proportionally to how many are before me
+					const boost::uint32_t pause = (ticket - serving) * 16;
+					for (boost::uint32_t i = 0; i < pause; ++i) {
+						cpu_relax();
+					}
+					spun += pause;
+				} else {
+					std::this_thread::yield();
+				}
+				serving = m_serving.load(std::memory_order_acquire);
+			}
+		}
+
+		bool try_lock() noexcept {
+
+			boost::uint32_t serving = m_serving.load(std::memory_order_acquire);
+			return m_next.compare_exchange_strong(serving, serving + 1, std::memory_order_acquire, std::memory_order_relaxed);
+		}
+
+		void unlock() noexcept {
+
+			m_serving.store(m_serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+		//! are others waiting? Only meaningful while holding the lock
+		bool has_waiters() const noexcept {
+
+			return (m_next.load(std::memory_order_relaxed) - m_serving.load(std::memory_order_relaxed)) > 1;
+		}
+
+	private:
+		//! pause instructions before starting to yield
+		static constexpr unsigned int ticket_spin_limit = 2048;
+
+		std::atomic<boost::uint32_t>  m_next{ 0 };
+		std::atomic<boost::uint32_t>  m_serving{ 0 };
+};
+
+/*! @brief NUMA aware cohort lock
+
+	A ticket lock per node plus a global one. The global lock is passed among threads
+	of the same node for up to HandoffLimit times in a row before it is released for
+	other nodes, so the protected data and the lock stay in one node's caches.
+	Nodes beyond MaxNodes share locks.
+ */
+template< std::size_t MaxNodes = 8, unsigned int HandoffLimit = 64 >
+class cohort_mutex {
+
+	public:
+		cohort_mutex() = default;
+		cohort_mutex(const cohort_mutex &) = delete;
+		cohort_mutex &operator=(const cohort_mutex &) = delete;
+
+		void lock() noexcept {
+
+			const std::size_t node = detail::current_numa_node() % MaxNodes;
+			m_nodes[node].m_local.lock();
+			if (!m_nodes[node].m_global_owned) {
+				m_global.lock();
+			}
+			m_owner = node;
+		}
+
+		bool try_lock() noexcept {
+
+			const std::size_t node = detail::current_numa_node() % MaxNodes;
+			if (!m_nodes[node].m_local.try_lock()) {
+				return false;
+			}
+
+			if (!m_nodes[node].m_global_owned && !m_global.try_lock()) {
+				m_nodes[node].m_local.unlock();
+				return false;
+			}
+
+			m_owner = node;
+			return true;
+		}
+
+		void unlock() noexcept {
+
+			node_lock &owner = m_nodes[m_owner];
+			if (owner.m_local.has_waiters() && (owner.m_handoffs < HandoffLimit)) {
+				// keep the global lock in this node for the next local waiter
+				owner.m_global_owned = true;
+				++owner.m_handoffs;
+			} else {
+				owner.m_global_owned = false;
+				owner.m_handoffs = 0;
+				m_global.unlock();
+			}
+			owner.m_local.unlock();
+		}
+
+	private:
+		// Members other than the locks are only touched by the holder of the local lock
+		struct alignas(64) node_lock {
+			ticket_mutex  m_local;
+			bool          m_global_owned = false;
+			unsigned int  m_handoffs = 0;
+		};
+
+		alignas(64) ticket_mutex  m_global;
+		std::size_t               m_owner = 0;
+		node_lock                 m_nodes[MaxNodes];
+};
+
+#if defined(BOOST_MSVC)
+MOOSE_TOOLS_API void LockablesGetRidOfLNK4221();
+#endif
+
+}
+}
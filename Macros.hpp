@@ -6,25 +6,40 @@
 #pragma once
 #include "MooseToolsConfig.hpp"
 
-#include <memory>
-
-#define MOOSE_FWD_DECLARE_CLASS(mt_macro_classname)                              \
-class mt_macro_classname;                                                        \
-typedef std::shared_ptr<mt_macro_classname>       mt_macro_classname ## SPtr;    \
-typedef std::shared_ptr<const mt_macro_classname> mt_macro_classname ## CSPtr;   \
-typedef std::weak_ptr<mt_macro_classname>         mt_macro_classname ## WPtr;    \
-typedef std::weak_ptr<const mt_macro_classname>   mt_macro_classname ## CWPtr;   \
-typedef std::unique_ptr<mt_macro_classname>       mt_macro_classname ## UPtr;
-
+#include <boost/smart_ptr/intrusive_ptr.hpp>
 
+#include <memory>
 
-#define MOOSE_FWD_DECLARE_STRUCT(mt_macro_structname)                            \
-struct mt_macro_structname;                                                      \
-typedef std::shared_ptr<mt_macro_structname>       mt_macro_structname ## SPtr;  \
-typedef std::shared_ptr<const mt_macro_structname> mt_macro_structname ## CSPtr; \
-typedef std::weak_ptr<mt_macro_structname>         mt_macro_structname ## WPtr;  \
-typedef std::weak_ptr<const mt_macro_structname>   mt_macro_structname ## CWPtr; \
-typedef std::unique_ptr<mt_macro_structname>       mt_macro_structname ## UPtr;
+/*! The IPtr and LPtr typedefs are both boost::intrusive_ptr and only work
+	when the class derives from RefCounted or LocalRefCounted (RefCounted.hpp).
+	Whether the count is atomic depends on that base, not on the typedef.
+	Use LPtr for the thread confined ones so readers know.
+ */
+#define MOOSE_FWD_DECLARE_CLASS(mt_macro_classname)                                 \
+class mt_macro_classname;                                                           \
+typedef std::shared_ptr<mt_macro_classname>         mt_macro_classname ## SPtr;     \
+typedef std::shared_ptr<const mt_macro_classname>   mt_macro_classname ## CSPtr;    \
+typedef std::weak_ptr<mt_macro_classname>           mt_macro_classname ## WPtr;     \
+typedef std::weak_ptr<const mt_macro_classname>     mt_macro_classname ## CWPtr;    \
+typedef std::unique_ptr<mt_macro_classname>         mt_macro_classname ## UPtr;     \
+typedef boost::intrusive_ptr<mt_macro_classname>       mt_macro_classname ## IPtr;  \
+typedef boost::intrusive_ptr<const mt_macro_classname> mt_macro_classname ## CIPtr; \
+typedef boost::intrusive_ptr<mt_macro_classname>       mt_macro_classname ## LPtr;  \
+typedef boost::intrusive_ptr<const mt_macro_classname> mt_macro_classname ## CLPtr;
+
+
+
+#define MOOSE_FWD_DECLARE_STRUCT(mt_macro_structname)                                \
+struct mt_macro_structname;                                                          \
+typedef std::shared_ptr<mt_macro_structname>         mt_macro_structname ## SPtr;    \
+typedef std::shared_ptr<const mt_macro_structname>   mt_macro_structname ## CSPtr;   \
+typedef std::weak_ptr<mt_macro_structname>           mt_macro_structname ## WPtr;    \
+typedef std::weak_ptr<const mt_macro_structname>     mt_macro_structname ## CWPtr;   \
+typedef std::unique_ptr<mt_macro_structname>         mt_macro_structname ## UPtr;    \
+typedef boost::intrusive_ptr<mt_macro_structname>       mt_macro_structname ## IPtr;  \
+typedef boost::intrusive_ptr<const mt_macro_structname> mt_macro_structname ## CIPtr; \
+typedef boost::intrusive_ptr<mt_macro_structname>       mt_macro_structname ## LPtr;  \
+typedef boost::intrusive_ptr<const mt_macro_structname> mt_macro_structname ## CLPtr;
 
 
 
@@ -0,0 +1,213 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+#include "MooseToolsConfig.hpp"
+
+#include <boost/cstdint.hpp>
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+namespace moose {
+namespace tools {
+
+/*! @brief cache a value derived from one or more Incarnated objects
+
+	The value is computed on first use and stored along with the incarnations
+	of all sources as they were before computing. get() returns the cached value
+	as long as none of the sources changed(), otherwise it computes again.
+	The fast path doesn't take the mutex that serializes computation. It is an atomic
+	load of a shared_ptr, one reference count increase on the cached entry and one
+	incarnation check per source. It's not lock free though: libstdc++ implements atomic
+	shared_ptr access with a global pool of mutexes and all readers increase the same count.
+	So hold on to the returned pointer rather than calling get() in a hot loop.
+
+	@code
+	Memoized<std::string, Container> json([](const Container &n_c) { return to_json(n_c); }, container);
+	std::shared_ptr<const std::string> current = json.get();
+	@endcode
+
+	Sources must outlive this. The compute function is responsible for accessing
+	the sources in a thread safe way, e.g. by taking their read lock.
+	Concurrent get() calls finding the value outdated compute it only once.
+ */
+template< typename Result, typename... Sources >
+class Memoized {
+
+	static_assert(sizeof...(Sources) > 0, "need at least one source");
+
+	public:
+		using result_type  = Result;
+		using compute_type = std::function<Result (const Sources &...)>;
+
+		//! Something that runs the given function somewhere else, like a post to an io_context
+		using scheduler_type = std::function<void (std::function<void ()> &&)>;
+
+		Memoized(compute_type &&n_compute, const Sources &... n_sources)
+				: m_compute(std::move(n_compute))
+				, m_sources(&n_sources...) {
+		}
+
+		Memoized(const Memoized &) = delete;
+		Memoized &operator=(const Memoized &) = delete;
+
+		/*! @brief recompute outdated values in the background rather than in get()
+
+			Once a value was computed, get() will hand out the outdated value and
+			schedule a recomputation instead of blocking the caller.
+			The first get() still computes in place as there is nothing to return.
+			@note this must outlive all scheduled functions
+		 */
+		void set_background_scheduler(scheduler_type &&n_scheduler) {
+
+			std::lock_guard<std::mutex> slock(m_mutex);
+			m_scheduler = std::move(n_scheduler);
+		}
+
+		/*! @brief get the current value, computing it if the sources changed
+			@throw whatever the compute function throws. Nothing is cached then
+			@throw whatever the background scheduler throws. The next get() schedules again
+		 */
+		std::shared_ptr<const Result> get() {
+
+			std::shared_ptr<const entry> current = std::atomic_load_explicit(&m_entry, std::memory_order_acquire);
+			if (current && !outdated(*current)) {
+				return std::shared_ptr<const Result>(current, &current->m_result);
+			}
+
+			if (current && m_background.load(std::memory_order_relaxed)) {
+				schedule();
+				return std::shared_ptr<const Result>(current, &current->m_result);
+			}
+
+			current = recompute();
+			return std::shared_ptr<const Result>(current, &current->m_result);
+		}
+
+		//! true when there is a value and none of the sources changed since
+		bool valid() const noexcept {
+
+			const std::shared_ptr<const entry> current = std::atomic_load_explicit(&m_entry, std::memory_order_acquire);
+			return current && !outdated(*current);
+		}
+
+		//! drop the cached value so the next get() computes
+		void invalidate() noexcept {
+
+			std::atomic_store_explicit(&m_entry, std::shared_ptr<const entry>(), std::memory_order_release);
+		}
+
+	private:
+		using incarnations_type = std::array<boost::uint64_t, sizeof...(Sources)>;
+
+		struct entry {
+
+			entry(Result &&n_result, const incarnations_type &n_incarnations)
+					: m_result(std::move(n_result))
+					, m_incarnations(n_incarnations) {
+			}
+
+			const Result             m_result;
+			const incarnations_type  m_incarnations;
+		};
+
+		bool outdated(const entry &n_entry) const noexcept {
+
+			return outdated(n_entry, std::index_sequence_for<Sources...>());
+		}
+
+		template< std::size_t... I >
+		bool outdated(const entry &n_entry, std::index_sequence<I...>) const noexcept {
+
+			return (std::get<I>(m_sources)->changed(n_entry.m_incarnations[I]) || ...);
+		}
+
+		template< std::size_t... I >
+		incarnations_type incarnations(std::index_sequence<I...>) const noexcept {
+
+			return incarnations_type{ { std::get<I>(m_sources)->incarnation()... } };
+		}
+
+		template< std::size_t... I >
+		Result compute(std::index_sequence<I...>) const {
+
+			return m_compute(*std::get<I>(m_sources)...);
+		}
+
+		std::shared_ptr<const entry> recompute() {
+
+			std::lock_guard<std::mutex> slock(m_mutex);
+
+			// someone else may have done it while I waited
+			std::shared_ptr<const entry> current = std::atomic_load_explicit(&m_entry, std::memory_order_acquire);
+			if (current && !outdated(*current)) {
+				return current;
+			}
+
+			// Incarnations before computing. If a source changes while I compute
+			// the result is outdated right away and computed again next time.
+			const incarnations_type before = incarnations(std::index_sequence_for<Sources...>());
+			current = std::make_shared<const entry>(compute(std::index_sequence_for<Sources...>()), before);
+			std::atomic_store_explicit(&m_entry, current, std::memory_order_release);
+
+			if (m_scheduler) {
+				m_background.store(true, std::memory_order_relaxed);
+			}
+
+			return current;
+		}
+
+		void schedule() {
+
+			// only one at a time
+			if (m_scheduled.exchange(true, std::memory_order_acq_rel)) {
+				return;
+			}
+
+			scheduler_type scheduler;
+			{
+				std::lock_guard<std::mutex> slock(m_mutex);
+				scheduler = m_scheduler;
+			}
+
+			try {
+				scheduler([this]() {
+					try {
+						recompute();
+					} catch (...) {
+						// get() will try again and throw in place next time
+						invalidate();
+						m_background.store(false, std::memory_order_relaxed);
+					}
+					m_scheduled.store(false, std::memory_order_release);
+				});
+			} catch (...) {
+				// nothing was scheduled, or the stale value would be served forever
+				m_scheduled.store(false, std::memory_order_release);
+				throw;
+			}
+		}
+
+		const compute_type                     m_compute;
+		const std::tuple<const Sources *...>   m_sources;
+
+		std::shared_ptr<const entry>           m_entry;         //!< accessed atomically only
+		std::mutex                             m_mutex;         //!< serializes computation
+		scheduler_type                         m_scheduler;
+		std::atomic<bool>                      m_background{ false };  //!< there is a value to hand out while recomputing
+		std::atomic<bool>                      m_scheduled{ false };
+};
+
+#if defined(BOOST_MSVC)
+MOOSE_TOOLS_API void MemoizedGetRidOfLNK4221();
+#endif
+
+}
+}
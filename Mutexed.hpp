@@ -1,85 +1,802 @@
-
 //  Copyright 2015 Stephan Menzel. Distributed under the Boost
 //  Software License, Version 1.0. (See accompanying file
 //  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 
 #pragma once
 #include "MooseToolsConfig.hpp"
+#include "Assert.hpp"
+#include "Error.hpp"
+#include "Lockables.hpp"
+#include "ThreadId.hpp"
 
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
 #include <boost/thread/lock_types.hpp>
 #include <boost/cstdint.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if defined(MOOSE_TOOLS_LOCK_PROFILING)
+#include "LockProfile.hpp"
+
+#include <chrono>
+#include <typeinfo>
+#endif
+
 namespace moose {
 namespace tools {
 
+namespace detail {
+
+//! Does the Lockable have shared ownership?
+template< typename Lockable, typename = void >
+struct has_lock_shared : std::false_type {};
+
+template< typename Lockable >
+struct has_lock_shared< Lockable, std::void_t<decltype(std::declval<Lockable &>().lock_shared())> > : std::true_type {};
+
+//! Does the Lockable have upgrade ownership like boost::upgrade_mutex?
+template< typename Lockable, typename = void >
+struct has_lock_upgrade : std::false_type {};
+
+template< typename Lockable >
+struct has_lock_upgrade< Lockable, std::void_t<decltype(std::declval<Lockable &>().lock_upgrade())> > : std::true_type {};
+
+//! Can the Lockable go from exclusive to shared atomically?
+template< typename Lockable, typename = void >
+struct has_unlock_and_lock_shared : std::false_type {};
+
+template< typename Lockable >
+struct has_unlock_and_lock_shared< Lockable, std::void_t<decltype(std::declval<Lockable &>().unlock_and_lock_shared())> > : std::true_type {};
+
+//! a write operation published for Mutexed::combine(), lives on the publisher's stack
+struct combining_request {
+
+	void               (*m_function)(void *n_context) = nullptr;
+	void                *m_context = nullptr;
+	std::exception_ptr   m_error;
+	std::atomic<bool>    m_done{ false };
+};
+
+//! one per thread index, threads sharing a slot don't combine
+struct alignas(64) combining_slot {
+
+	std::atomic<combining_request *> m_request{ nullptr };
+};
+
+const std::size_t combining_slot_count = 64;
+
+//! pauses before a waiting combine() tries the lock again, then yields
+const unsigned int combining_spin_limit = 64;
+
+//! rounds of trying before a waiting combine() blocks on the lock
+const unsigned int combining_try_limit = 1024;
+
+//! lets lock_all() give back write locks it didn't use
+struct lock_all_access;
+
+} // namespace detail
+
 /*! @brief shortcut base for classes with a mutex
+
+	With the default boost::upgrade_mutex read locks are shared among readers,
+	upgradable locks are shared with readers but exclusive among themselves and
+	write locks are exclusive. Any Lockable works, if it lacks shared or upgrade
+	ownership the respective locks are exclusive instead. So classes with mostly
+	writers may pass boost::mutex to keep the cheaper exclusive locking.
+	The incarnation increases whenever a write lock is released.
+
+	Migrating from the old scoped_lock, which was a boost::unique_lock<Lockable>:
+	 - it is BasicLockable now, so wait on a boost::condition_variable_any instead of
+	   a boost::condition_variable. Waiting on a write lock ends the write and
+	   increases the incarnation.
+	 - m_writing is mode() == lock_mode::write
+	 - m_issuer is issuer()
+
+	Many threads writing small changes to one hot object may use combine()
+	instead, which batches their operations under a single write lock.
+
+	Internally the incarnation is kept as a sequence counter which is odd while
+	a write lock is held. This lets optimistic_read() run readers without touching
+	the mutex at all, which is worthwhile for small structures read very often.
+
+	Built with MOOSE_TOOLS_LOCK_PROFILING every lock records wait and hold times
+	per DerivedType and call site, see LockProfile.hpp.
  */
-template< typename DerivedType, typename Lockable = boost::mutex >
+template< typename DerivedType, typename Lockable = boost::upgrade_mutex >
 class Mutexed {
 
 	public:
-	
-		/*! @brief this is basically a regular unique_lock which
-		 * increases the locked object's incarnation count upon release.
+		enum class lock_mode {
+			none,        //!< lock doesn't own anything (anymore)
+			read,        //!< shared with other readers and one upgradable lock
+			upgradable,  //!< reading with the option to upgrade without letting go
+			write        //!< exclusive. Increases the incarnation upon release
+		};
+
+		/*! @brief a movable lock on a Mutexed object
+		 * which increases the locked object's incarnation count upon release of a write lock.
 		 * Of course this doesn't imply any data have actually been changed
 		 * but it signals the possibility thereof.
 		 */
-		struct scoped_lock : public boost::unique_lock< Lockable > {
-	
-			scoped_lock() = delete;
-			scoped_lock(Mutexed<DerivedType> &n_issuer, bool n_writing)
-					: boost::unique_lock<Lockable>(n_issuer.m_mutex)
-					, m_issuer(n_issuer)
-					, m_writing(n_writing) {};
-			scoped_lock(const scoped_lock &) = delete;
-			scoped_lock(scoped_lock &&) = default;
-			~scoped_lock() noexcept {
-				if (m_writing) {
-					m_issuer.m_incarnation++;
-				}
-			};
-
-			//! upgrade a read_lock to a write_lock
-			void upgrade() noexcept {
-				m_writing = true;
-			}
+		class scoped_lock {
 
-			//! downgrade a write_lock to a read lock
-			void downgrade() noexcept {
-				m_writing = false;
-			}
+			public:
+				scoped_lock() = delete;
+#if defined(MOOSE_TOOLS_LOCK_PROFILING)
+				scoped_lock(Mutexed<DerivedType, Lockable> &n_issuer, const lock_mode n_mode,
+						const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE())
+						: m_issuer(&n_issuer)
+						, m_mode(lock_mode::none)
+						, m_relock_mode(n_mode)
+						, m_profile(detail::lock_profile_site(typeid(DerivedType), n_file, n_line)) {
+
+					lock();
+				}
+
+				scoped_lock(Mutexed<DerivedType, Lockable> &n_issuer, const lock_mode n_mode, boost::try_to_lock_t,
+						const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE())
+						: m_issuer(&n_issuer)
+						, m_mode(lock_mode::none)
+						, m_relock_mode(n_mode)
+						, m_profile(detail::lock_profile_site(typeid(DerivedType), n_file, n_line)) {
+
+					// failed attempts are not recorded
+					if (m_issuer->try_lock(n_mode)) {
+						m_mode = n_mode;
+						m_acquired = std::chrono::steady_clock::now();
+						detail::lock_profile_acquired(m_profile, false, 0);
+					}
+				}
+#else
+				scoped_lock(Mutexed<DerivedType, Lockable> &n_issuer, const lock_mode n_mode)
+						: m_issuer(&n_issuer)
+						, m_mode(lock_mode::none)
+						, m_relock_mode(n_mode) {
+
+					lock();
+				}
+
+				//! doesn't wait. Check owns_lock() to see if I got it
+				scoped_lock(Mutexed<DerivedType, Lockable> &n_issuer, const lock_mode n_mode, boost::try_to_lock_t)
+						: m_issuer(&n_issuer)
+						, m_mode(n_issuer.try_lock(n_mode) ? n_mode : lock_mode::none)
+						, m_relock_mode(n_mode) {
+				}
+#endif
+
+				scoped_lock(const scoped_lock &) = delete;
+				scoped_lock &operator=(const scoped_lock &) = delete;
+
+				scoped_lock(scoped_lock &&n_other) noexcept
+						: m_issuer(n_other.m_issuer)
+						, m_mode(std::exchange(n_other.m_mode, lock_mode::none))
+						, m_relock_mode(n_other.m_relock_mode)
+#if defined(MOOSE_TOOLS_LOCK_PROFILING)
+						, m_profile(n_other.m_profile)
+						, m_acquired(n_other.m_acquired)
+#endif
+				{
+				}
+
+				scoped_lock &operator=(scoped_lock &&n_other) noexcept {
+
+					if (this != &n_other) {
+						unlock();
+						m_issuer = n_other.m_issuer;
+						m_mode = std::exchange(n_other.m_mode, lock_mode::none);
+						m_relock_mode = n_other.m_relock_mode;
+#if defined(MOOSE_TOOLS_LOCK_PROFILING)
+						m_profile = n_other.m_profile;
+						m_acquired = n_other.m_acquired;
+#endif
+					}
+					return *this;
+				}
+
+				~scoped_lock() noexcept {
+
+					unlock();
+				}
+
+				bool owns_lock() const noexcept {
+
+					return m_mode != lock_mode::none;
+				}
+
+				explicit operator bool() const noexcept {
+
+					return owns_lock();
+				}
+
+				lock_mode mode() const noexcept {
+
+					return m_mode;
+				}
+
+				//! the object this lock is on
+				Mutexed<DerivedType, Lockable> &issuer() const noexcept {
+
+					return *m_issuer;
+				}
+
+				/*! @brief take the lock again in the mode it last had
+
+					Together with unlock() this makes scoped_lock BasicLockable,
+					so it can wait on a boost::condition_variable_any.
+				 */
+				void lock() {
+
+					MOOSE_ASSERT_MSG((m_mode == lock_mode::none), "lock already held");
+#if defined(MOOSE_TOOLS_LOCK_PROFILING)
+					// Only look at the clock again when I had to wait
+					const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+					const bool contended = !m_issuer->try_lock(m_relock_mode);
+					if (contended) {
+						m_issuer->lock(m_relock_mode);
+						m_acquired = std::chrono::steady_clock::now();
+					} else {
+						m_acquired = start;
+					}
+
+					detail::lock_profile_acquired(m_profile, contended,
+							std::chrono::duration_cast<std::chrono::nanoseconds>(m_acquired - start).count());
+#else
+					m_issuer->lock(m_relock_mode);
+#endif
+					m_mode = m_relock_mode;
+				}
+
+				//! release early. Increases the incarnation if this was a write lock
+				void unlock() noexcept {
+
+					if (m_mode != lock_mode::none) {
+#if defined(MOOSE_TOOLS_LOCK_PROFILING)
+						detail::lock_profile_released(m_profile,
+								std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_acquired).count());
+#endif
+						m_issuer->unlock(m_mode);
+						m_mode = lock_mode::none;
+					}
+				}
+
+				/*! @brief upgrade a read or upgradable lock to a write lock
+
+					From an upgradable lock this is atomic, nobody else can write in between.
+					A read lock has to be released first as two readers upgrading at once
+					would deadlock. So others may have written when this returns.
+				 */
+				void upgrade() {
 
-			Mutexed<DerivedType> &m_issuer;
-			bool                  m_writing;
+					MOOSE_ASSERT_MSG((m_mode == lock_mode::read) || (m_mode == lock_mode::upgradable), "can only upgrade read locks");
+					m_issuer->upgrade(m_mode);
+					m_mode = lock_mode::write;
+					m_relock_mode = lock_mode::write;
+				}
+
+				/*! @brief downgrade a write lock to a read lock
+					Increases the incarnation as writing ends here
+				 */
+				void downgrade() {
+
+					MOOSE_ASSERT_MSG((m_mode == lock_mode::write), "can only downgrade write locks");
+					m_issuer->downgrade();
+					m_mode = lock_mode::read;
+					m_relock_mode = lock_mode::read;
+				}
+
+			private:
+				friend struct detail::lock_all_access;
+
+				//! release a write lock nothing was written under, the incarnation stays
+				void abandon() noexcept {
+
+					MOOSE_ASSERT_MSG((m_mode == lock_mode::write), "can only abandon write locks");
+#if defined(MOOSE_TOOLS_LOCK_PROFILING)
+					detail::lock_profile_released(m_profile,
+							std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_acquired).count());
+#endif
+					m_issuer->abandon_write();
+					m_mode = lock_mode::none;
+				}
+
+				Mutexed<DerivedType, Lockable>  *m_issuer;
+				lock_mode                        m_mode;
+				lock_mode                        m_relock_mode;  //!< what lock() takes
+#if defined(MOOSE_TOOLS_LOCK_PROFILING)
+				detail::lock_profile_site_ref          m_profile;
+				std::chrono::steady_clock::time_point  m_acquired;
+#endif
 		};
 
+#if defined(MOOSE_TOOLS_LOCK_PROFILING)
+		// The caller's location is recorded with the profile
+		scoped_lock acquire_read_lock(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE()) const {
+
+			return scoped_lock(*const_cast< Mutexed< DerivedType, Lockable > *>(this), lock_mode::read, n_file, n_line);
+		}
+
+		scoped_lock acquire_upgradable_lock(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE()) const {
+
+			return scoped_lock(*const_cast< Mutexed< DerivedType, Lockable > *>(this), lock_mode::upgradable, n_file, n_line);
+		}
+
+		scoped_lock acquire_write_lock(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE()) {
+
+			return scoped_lock(*this, lock_mode::write, n_file, n_line);
+		}
+
+		scoped_lock try_acquire_write_lock(const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE()) {
+
+			return scoped_lock(*this, lock_mode::write, boost::try_to_lock, n_file, n_line);
+		}
+#else
+		//! shared with other readers
 		scoped_lock acquire_read_lock(void) const {
 			
-			return scoped_lock(*const_cast< Mutexed< DerivedType > *>(this), false);
+			return scoped_lock(*const_cast< Mutexed< DerivedType, Lockable > *>(this), lock_mode::read);
+		}
+
+		//! shared with readers, exclusive with other upgradable and write locks
+		scoped_lock acquire_upgradable_lock(void) const {
+
+			return scoped_lock(*const_cast< Mutexed< DerivedType, Lockable > *>(this), lock_mode::upgradable);
 		}
 
 		scoped_lock acquire_write_lock(void) {
 			
-			return scoped_lock(*this, true);
+			return scoped_lock(*this, lock_mode::write);
 		}
+
+		//! doesn't wait. The returned lock may not own anything, check owns_lock()
+		scoped_lock try_acquire_write_lock(void) {
+
+			return scoped_lock(*this, lock_mode::write, boost::try_to_lock);
+		}
+#endif
 		
 		boost::uint64_t incarnation() const noexcept {
 		
-			return m_incarnation;
+			return m_sequence.load(std::memory_order_acquire) >> 1;
+		}
+
+		/*! @brief run a read only function without locking, retrying when a writer interfered
+
+			n_function is run while writers may be changing the data. Its result is only
+			returned if no write lock was held during the whole call, otherwise it is
+			discarded and the function runs again. After n_retries failed attempts
+			it runs once more under a regular read lock.
+
+			The function must be able to cope with inconsistent data without crashing,
+			e.g. not follow pointers or index with what it read and only copy values out.
+			To be strictly correct the data should be atomics read with relaxed ordering.
+			@return whatever n_function returns
+		 */
+		template< typename Function >
+		auto optimistic_read(Function &&n_function, const unsigned int n_retries = 4) const -> decltype(n_function()) {
+
+			for (unsigned int i = 0; i < n_retries; ++i) {
+				const boost::uint64_t before = m_sequence.load(std::memory_order_acquire);
+				if (before & 1) {
+					// writer in there
+					continue;
+				}
+
+				if constexpr (std::is_void<decltype(n_function())>::value) {
+					n_function();
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (m_sequence.load(std::memory_order_relaxed) == before) {
+						return;
+					}
+				} else {
+					auto ret = n_function();
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (m_sequence.load(std::memory_order_relaxed) == before) {
+						return ret;
+					}
+				}
+			}
+
+			const scoped_lock slock = acquire_read_lock();
+			return n_function();
+		}
+
+		/*! @brief run a write operation, possibly batched with those of other threads
+
+			The operation is published in a per-thread slot. Whichever combining thread
+			gets the write lock runs all published operations in one go, so a batch costs
+			a single lock handoff and increases the incarnation only once.
+			Threads waiting for their operation spin and retry the lock in the meantime.
+
+			n_operation runs under the write lock, possibly on another thread. It must not
+			lock this object itself nor rely on thread local state. Exceptions it throws
+			are rethrown in the calling thread.
+			@return whatever n_operation returns
+		 */
+		template< typename Function >
+		auto combine(Function &&n_operation) -> decltype(n_operation()) {
+
+			using result_type = decltype(n_operation());
+			using function_type = std::remove_reference_t<Function>;
+			static_assert(!std::is_reference<result_type>::value, "combined operations cannot return references");
+
+			detail::combining_request request;
+			if constexpr (std::is_void<result_type>::value) {
+				request.m_function = [](void *n_context) {
+					(*static_cast<function_type *>(n_context))();
+				};
+				request.m_context = const_cast<void *>(static_cast<const void *>(std::addressof(n_operation)));
+				run_combined(request);
+			} else {
+				struct context {
+					function_type               &m_function;
+					std::optional<result_type>   m_result;
+				} ctx{ n_operation, std::nullopt };
+
+				request.m_function = [](void *n_context) {
+					context &c = *static_cast<context *>(n_context);
+					c.m_result.emplace(c.m_function());
+				};
+				request.m_context = &ctx;
+				run_combined(request);
+				return std::move(*ctx.m_result);
+			}
 		}
 
 	protected:
 		// I start with incarnation 1 rather than 0 to mark 0 as overflow case
-		Mutexed(void) : m_incarnation(1) {};
+		Mutexed(void) : m_sequence(2) {};
 		Mutexed(const Mutexed &n_other) = delete;
-		virtual ~Mutexed() noexcept = default;
+		virtual ~Mutexed() noexcept {
+
+			delete[] m_combining_slots.load(std::memory_order_relaxed);
+		}
 
 	private:
-		mutable Lockable     m_mutex;
-		boost::uint64_t      m_incarnation;
+		static constexpr bool shared_capable  = detail::has_lock_shared<Lockable>::value;
+		static constexpr bool upgrade_capable = detail::has_lock_upgrade<Lockable>::value;
+
+		void lock(const lock_mode n_mode) {
+
+			if ((n_mode == lock_mode::read) && shared_capable) {
+				if constexpr (shared_capable) {
+					m_mutex.lock_shared();
+				}
+			} else if ((n_mode == lock_mode::upgradable) && upgrade_capable) {
+				if constexpr (upgrade_capable) {
+					m_mutex.lock_upgrade();
+				}
+			} else if (n_mode != lock_mode::none) {
+				m_mutex.lock();
+				if (n_mode == lock_mode::write) {
+					begin_write();
+				}
+			}
+		}
+
+		bool try_lock(const lock_mode n_mode) {
+
+			if ((n_mode == lock_mode::read) && shared_capable) {
+				if constexpr (shared_capable) {
+					return m_mutex.try_lock_shared();
+				}
+			} else if ((n_mode == lock_mode::upgradable) && upgrade_capable) {
+				if constexpr (upgrade_capable) {
+					return m_mutex.try_lock_upgrade();
+				}
+			} else if (n_mode != lock_mode::none) {
+				if (!m_mutex.try_lock()) {
+					return false;
+				}
+				if (n_mode == lock_mode::write) {
+					begin_write();
+				}
+			}
+			return true;
+		}
+
+		//! sequence becomes odd, optimistic readers from now on retry
+		void begin_write() noexcept {
+
+			m_sequence.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+
+		//! sequence becomes even again and the incarnation is one higher
+		void end_write() noexcept {
+
+			m_sequence.fetch_add(1, std::memory_order_release);
+		}
+
+		void unlock(const lock_mode n_mode) noexcept {
+
+			if ((n_mode == lock_mode::read) && shared_capable) {
+				if constexpr (shared_capable) {
+					m_mutex.unlock_shared();
+				}
+			} else if ((n_mode == lock_mode::upgradable) && upgrade_capable) {
+				if constexpr (upgrade_capable) {
+					m_mutex.unlock_upgrade();
+				}
+			} else if (n_mode != lock_mode::none) {
+				if (n_mode == lock_mode::write) {
+					end_write();
+				}
+				m_mutex.unlock();
+			}
+		}
+
+		/*! The sequence goes back to where it was. Optimistic readers who saw it
+			before still read valid data as nothing changed.
+		 */
+		void abandon_write() noexcept {
+
+			m_sequence.fetch_sub(1, std::memory_order_release);
+			m_mutex.unlock();
+		}
+
+		void upgrade(const lock_mode n_mode) {
+
+			if ((n_mode == lock_mode::upgradable) && upgrade_capable) {
+				if constexpr (upgrade_capable) {
+					m_mutex.unlock_upgrade_and_lock();
+				}
+			} else if ((n_mode == lock_mode::read) && shared_capable) {
+				if constexpr (shared_capable) {
+					m_mutex.unlock_shared();
+					m_mutex.lock();
+				}
+			}
+			// otherwise I hold the exclusive lock already
+
+			begin_write();
+		}
+
+		void downgrade() {
+
+			end_write();
+
+			if constexpr (detail::has_unlock_and_lock_shared<Lockable>::value) {
+				m_mutex.unlock_and_lock_shared();
+			} else if constexpr (shared_capable) {
+				m_mutex.unlock();
+				m_mutex.lock_shared();
+			}
+			// otherwise I keep holding the exclusive lock as read lock
+		}
+
+		//! allocated when combine() is first called as most objects never need them
+		detail::combining_slot *combining_slots() {
+
+			detail::combining_slot *slots = m_combining_slots.load(std::memory_order_acquire);
+			if (!slots) {
+				detail::combining_slot *fresh = new detail::combining_slot[detail::combining_slot_count];
+				if (m_combining_slots.compare_exchange_strong(slots, fresh, std::memory_order_acq_rel, std::memory_order_acquire)) {
+					slots = fresh;
+				} else {
+					delete[] fresh;
+				}
+			}
+			return slots;
+		}
+
+		//! publish n_request and wait until it was run, by me or someone else
+		void run_combined(detail::combining_request &n_request) {
+
+			detail::combining_slot &slot = combining_slots()[thread_index() % detail::combining_slot_count];
+			detail::combining_request *expected = nullptr;
+			if (!slot.m_request.compare_exchange_strong(expected, &n_request, std::memory_order_release, std::memory_order_relaxed)) {
+				// Another thread with the same slot is in there. Do it the normal way
+				const scoped_lock slock = acquire_write_lock();
+				n_request.m_function(n_request.m_context);
+				return;
+			}
+
+			for (unsigned int round = 0; !n_request.m_done.load(std::memory_order_acquire); ++round) {
+
+				// After long enough I stop trying and queue up on the lock, so
+				// a steady stream of readers cannot starve me
+				scoped_lock slock = (round < detail::combining_try_limit) ? try_acquire_write_lock() : acquire_write_lock();
+				if (slock) {
+					run_published();
+					break;
+				}
+
+				for (unsigned int spin = 0; (spin < detail::combining_spin_limit) && !n_request.m_done.load(std::memory_order_acquire); ++spin) {
+					cpu_relax();
+				}
+				std::this_thread::yield();
+			}
+
+			if (n_request.m_error) {
+				std::rethrow_exception(n_request.m_error);
+			}
+		}
+
+		//! run everything published so far, I must hold the write lock
+		void run_published() noexcept {
+
+			detail::combining_slot *slots = m_combining_slots.load(std::memory_order_acquire);
+			for (std::size_t i = 0; i < detail::combining_slot_count; ++i) {
+				detail::combining_request *request = slots[i].m_request.load(std::memory_order_acquire);
+				if (!request) {
+					continue;
+				}
+
+				try {
+					request->m_function(request->m_context);
+				} catch (...) {
+					request->m_error = std::current_exception();
+				}
+
+				// The publisher may return and reuse the slot as soon as m_done is set,
+				// so the slot must be free before and the request not touched after.
+				slots[i].m_request.store(nullptr, std::memory_order_relaxed);
+				request->m_done.store(true, std::memory_order_release);
+			}
+		}
+
+		mutable Lockable                      m_mutex;
+		std::atomic<boost::uint64_t>          m_sequence;  //!< twice the incarnation, plus one during writes
+		std::atomic<detail::combining_slot *> m_combining_slots{ nullptr };
 };
 
+namespace detail {
+
+struct lock_all_access {
+
+	template< typename Lock >
+	static void abandon(Lock &n_lock) noexcept {
+
+		n_lock.abandon();
+	}
+};
+
+//! call n_function with std::integral_constant<std::size_t, n_index>
+template< typename Function, std::size_t... Indices >
+void visit_index(const std::size_t n_index, Function &&n_function, std::index_sequence<Indices...>) {
+
+	((Indices == n_index ? n_function(std::integral_constant<std::size_t, Indices>()) : void()), ...);
+}
+
+template< typename... Mutexeds, std::size_t... Indices >
+std::tuple<typename Mutexeds::scoped_lock...> lock_all(std::index_sequence<Indices...> n_indices,
+#if defined(MOOSE_TOOLS_LOCK_PROFILING)
+		const char *n_file, const unsigned int n_line,
+#endif
+		Mutexeds &... n_objects) {
+
+	constexpr std::size_t count = sizeof...(Mutexeds);
+	const std::array<const void *, count> addresses = { { static_cast<const void *>(&n_objects)... } };
+	const std::tuple<Mutexeds &...> objects(n_objects...);
+	std::tuple<std::optional<typename Mutexeds::scoped_lock>...> locks;
+
+	// Everyone locks in address order, so nobody can hold one I need while waiting for one I have
+	std::array<std::size_t, count> order = { { Indices... } };
+	std::sort(order.begin(), order.end(), [&addresses](const std::size_t n_lhs, const std::size_t n_rhs) {
+		return std::less<const void *>()(addresses[n_lhs], addresses[n_rhs]);
+	});
+
+	for (std::size_t i = 1; i < count; ++i) {
+		if (addresses[order[i - 1]] == addresses[order[i]]) {
+			BOOST_THROW_EXCEPTION(internal_error() << error_message("lock_all() called with the same object twice")
+				<< error_argument(order[i]));
+		}
+	}
+
+	// Write locks right away. Taking upgradable ones first and upgrading them after would
+	// wait for the readers of one while holding another, which deadlocks against a reader
+	// that wants to write what I hold.
+	const auto lock_at = [&](const std::size_t n_index, const bool n_wait) {
+		bool locked = false;
+		visit_index(n_index, [&](auto n_constant) {
+			using object_type = std::tuple_element_t<decltype(n_constant)::value, std::tuple<Mutexeds...> >;
+			auto &object = std::get<decltype(n_constant)::value>(objects);
+			auto &lock = std::get<decltype(n_constant)::value>(locks);
+#if defined(MOOSE_TOOLS_LOCK_PROFILING)
+			if (n_wait) {
+				lock.emplace(object, object_type::lock_mode::write, n_file, n_line);
+			} else {
+				lock.emplace(object, object_type::lock_mode::write, boost::try_to_lock, n_file, n_line);
+			}
+#else
+			if (n_wait) {
+				lock.emplace(object, object_type::lock_mode::write);
+			} else {
+				lock.emplace(object, object_type::lock_mode::write, boost::try_to_lock);
+			}
+#endif
+			locked = lock->owns_lock();
+		}, n_indices);
+		return locked;
+	};
+
+	// I only ever wait for the one that was busy last while holding nothing, the others are tried
+	std::size_t first = 0;
+	for (unsigned int attempt = 0; ; ++attempt) {
+		bool complete = true;
+		for (std::size_t i = 0; i < count; ++i) {
+			const std::size_t position = (first + i) % count;
+			if (!lock_at(order[position], i == 0)) {
+				first = position;
+				complete = false;
+				break;
+			}
+		}
+
+		if (complete) {
+			break;
+		}
+
+		// Let go of everything so whoever has the other one can finish.
+		// Nothing was written, so this doesn't count as an incarnation.
+		std::apply([](auto &... n_locks) {
+			(((n_locks && n_locks->owns_lock()) ? lock_all_access::abandon(*n_locks) : void()), ...);
+			(n_locks.reset(), ...);
+		}, locks);
+
+		for (unsigned int spin = 0; spin < (64u << std::min(attempt, 6u)); ++spin) {
+			cpu_relax();
+		}
+		std::this_thread::yield();
+	}
+
+	return std::tuple<typename Mutexeds::scoped_lock...>(std::move(*std::get<Indices>(locks))...);
+}
+
+} // namespace detail
+
+/*! @brief write lock several Mutexed objects at once without risking deadlocks
+
+	Write locks are taken right away, in the order of the objects' addresses. When one
+	is busy all already taken are released again and I back off, then wait for the busy
+	one and try the others. So I never sit on one lock while waiting for another, not even
+	against plain readers that go on to write an object I have. Locks given back that
+	way don't increase the incarnation. Objects may be of different types.
+
+	Taking the locks one by one in ad-hoc order, like in moving elements between
+	two containers from two threads in opposite directions, deadlocks.
+
+	This is a class rather than a function only so the caller's location can follow
+	the objects as default arguments, for the lock profile. Use it like a function
+	returning the write locks in the order of the arguments:
+	@code
+		auto [la, lb] = lock_all(a, b);
+	@endcode
+
+	@throw internal_error if an object is passed twice
+ */
+template< typename... Mutexeds >
+class lock_all : public std::tuple<typename Mutexeds::scoped_lock...> {
+
+	static_assert(sizeof...(Mutexeds) > 0, "lock_all() needs something to lock");
+
+	public:
+#if defined(MOOSE_TOOLS_LOCK_PROFILING)
+		explicit lock_all(Mutexeds &... n_objects, const char *n_file = __builtin_FILE(), const unsigned int n_line = __builtin_LINE())
+				: std::tuple<typename Mutexeds::scoped_lock...>(detail::lock_all(std::index_sequence_for<Mutexeds...>(), n_file, n_line, n_objects...)) {
+		}
+#else
+		explicit lock_all(Mutexeds &... n_objects)
+				: std::tuple<typename Mutexeds::scoped_lock...>(detail::lock_all(std::index_sequence_for<Mutexeds...>(), n_objects...)) {
+		}
+#endif
+};
+
+template< typename... Mutexeds >
+lock_all(Mutexeds &...) -> lock_all<Mutexeds...>;
+
 #if defined(BOOST_MSVC)
 MOOSE_TOOLS_API void MutexedgetRidOfLNK4221();
 #endif
@@ -87,3 +804,15 @@ MOOSE_TOOLS_API void MutexedgetRidOfLNK4221();
 }
 }
 
+// lock_all() unpacks like the tuple it is
+namespace std {
+
+template< typename... Mutexeds >
+struct tuple_size<moose::tools::lock_all<Mutexeds...> >
+		: tuple_size<tuple<typename Mutexeds::scoped_lock...> > {};
+
+template< size_t Index, typename... Mutexeds >
+struct tuple_element<Index, moose::tools::lock_all<Mutexeds...> >
+		: tuple_element<Index, tuple<typename Mutexeds::scoped_lock...> > {};
+
+}
\ No newline at end of file
@@ -0,0 +1,302 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include "ObjectPool.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace moose {
+namespace tools {
+
+namespace {
+
+	//! blocks a thread keeps for itself
+	const std::size_t pool_cache_size = 64;
+
+	//! operations after which a thread adds its counters to the pool
+	const unsigned int pool_stats_interval = 256;
+
+	//! free blocks link through their first bytes
+	inline void *&pool_next_block(void *n_block) noexcept {
+
+		return *static_cast<void **>(n_block);
+	}
+
+	//! All pools there are. Immortal like them
+	struct pool_registry {
+
+		std::mutex                     m_mutex;
+		std::vector<ObjectPoolBase *>  m_pools;
+	};
+
+	pool_registry &pool_registry_instance() {
+
+		static pool_registry *ret = new pool_registry();
+		return *ret;
+	}
+
+	//! blocks must be able to hold the free list link
+	inline std::size_t pool_alignment(const std::size_t n_alignment) noexcept {
+
+		return std::max(n_alignment, alignof(void *));
+	}
+
+	//! rounded up so consecutive blocks would all be aligned
+	inline std::size_t pool_block_size(const std::size_t n_size, const std::size_t n_alignment) noexcept {
+
+		const std::size_t alignment = pool_alignment(n_alignment);
+		return ((std::max(n_size, sizeof(void *)) + alignment - 1) / alignment) * alignment;
+	}
+}
+
+struct ObjectPoolBase::ThreadCache {
+
+	void            *m_head = nullptr;
+	std::size_t      m_count = 0;
+	boost::uint64_t  m_allocations = 0;
+	boost::uint64_t  m_hits = 0;
+	boost::int64_t   m_retained = 0;
+	unsigned int     m_operations = 0;
+};
+
+//! Hands everything back to the pools when the thread ends
+struct ObjectPoolThreadCaches {
+
+	std::vector<ObjectPoolBase::ThreadCache> m_caches;
+
+	~ObjectPoolThreadCaches() noexcept;
+};
+
+namespace {
+
+	thread_local ObjectPoolThreadCaches pool_thread_caches;
+
+	//! Set once the above is gone. Trivial so it remains usable
+	//! for pooled objects destroyed later in thread exit.
+	thread_local bool pool_thread_caches_gone = false;
+}
+
+ObjectPoolThreadCaches::~ObjectPoolThreadCaches() noexcept {
+
+	pool_thread_caches_gone = true;
+
+	pool_registry &r = pool_registry_instance();
+	std::vector<ObjectPoolBase *> pools;
+	{
+		std::lock_guard<std::mutex> lock(r.m_mutex);
+		pools = r.m_pools;
+	}
+
+	for (std::size_t i = 0; i < m_caches.size(); ++i) {
+		pools[i]->spill(m_caches[i], 0);
+		pools[i]->flush_stats(m_caches[i]);
+	}
+}
+
+ObjectPoolBase::ObjectPoolBase(const std::size_t n_size, const std::size_t n_alignment)
+		: m_id([this]() {
+				pool_registry &r = pool_registry_instance();
+				std::lock_guard<std::mutex> lock(r.m_mutex);
+				r.m_pools.push_back(this);
+				return r.m_pools.size() - 1;
+			}())
+		, m_block_size(pool_block_size(n_size, n_alignment))
+		, m_alignment(pool_alignment(n_alignment)) {
+}
+
+ObjectPoolBase::ThreadCache &ObjectPoolBase::thread_cache() const {
+
+	std::vector<ThreadCache> &caches = pool_thread_caches.m_caches;
+	if (m_id >= caches.size()) {
+		caches.resize(m_id + 1);
+	}
+	return caches[m_id];
+}
+
+void *ObjectPoolBase::allocate() {
+
+	if (pool_thread_caches_gone) {
+		m_allocations.fetch_add(1, std::memory_order_relaxed);
+		return ::operator new(m_block_size, std::align_val_t(m_alignment));
+	}
+
+	ThreadCache &cache = thread_cache();
+	++cache.m_allocations;
+
+	if (!cache.m_head) {
+		refill(cache);
+	}
+
+	void *ret;
+	if (cache.m_head) {
+		ret = cache.m_head;
+		cache.m_head = pool_next_block(ret);
+		--cache.m_count;
+		++cache.m_hits;
+		--cache.m_retained;
+	} else {
+		ret = ::operator new(m_block_size, std::align_val_t(m_alignment));
+	}
+
+	if (++cache.m_operations >= pool_stats_interval) {
+		flush_stats(cache);
+	}
+
+	return ret;
+}
+
+void ObjectPoolBase::deallocate(void *n_block) noexcept {
+
+	if (pool_thread_caches_gone) {
+		release(n_block);
+		return;
+	}
+
+	// thread_cache() may have to grow the vector. Should that fail, the block goes
+	ThreadCache *cache;
+	try {
+		cache = &thread_cache();
+	} catch (...) {
+		release(n_block);
+		return;
+	}
+
+	pool_next_block(n_block) = cache->m_head;
+	cache->m_head = n_block;
+	++cache->m_count;
+	++cache->m_retained;
+
+	if (cache->m_count > pool_cache_size) {
+		spill(*cache, pool_cache_size / 2);
+	}
+
+	if (++cache->m_operations >= pool_stats_interval) {
+		flush_stats(*cache);
+	}
+}
+
+void ObjectPoolBase::release(void *n_block) const noexcept {
+
+	::operator delete(n_block, std::align_val_t(m_alignment));
+}
+
+void ObjectPoolBase::spill(ThreadCache &n_cache, const std::size_t n_keep) const noexcept {
+
+	if (n_cache.m_count <= n_keep) {
+		return;
+	}
+
+	// cut off the tail beyond n_keep and put it in front of the shared list
+	void *first = n_cache.m_head;
+	void *last = first;
+	const std::size_t moved = n_cache.m_count - n_keep;
+	for (std::size_t i = 1; i < moved; ++i) {
+		last = pool_next_block(last);
+	}
+	n_cache.m_head = pool_next_block(last);
+	n_cache.m_count = n_keep;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	pool_next_block(last) = m_free;
+	m_free = first;
+	m_free_count += moved;
+}
+
+void ObjectPoolBase::refill(ThreadCache &n_cache) const noexcept {
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	while (m_free && (n_cache.m_count < pool_cache_size / 2)) {
+		void *block = m_free;
+		m_free = pool_next_block(block);
+		--m_free_count;
+		pool_next_block(block) = n_cache.m_head;
+		n_cache.m_head = block;
+		++n_cache.m_count;
+	}
+}
+
+void ObjectPoolBase::flush_stats(ThreadCache &n_cache) const noexcept {
+
+	m_allocations.fetch_add(n_cache.m_allocations, std::memory_order_relaxed);
+	m_hits.fetch_add(n_cache.m_hits, std::memory_order_relaxed);
+	m_retained.fetch_add(n_cache.m_retained, std::memory_order_relaxed);
+	n_cache.m_allocations = 0;
+	n_cache.m_hits = 0;
+	n_cache.m_retained = 0;
+	n_cache.m_operations = 0;
+}
+
+std::size_t ObjectPoolBase::trim() noexcept {
+
+	if (!pool_thread_caches_gone) {
+		try {
+			ThreadCache &cache = thread_cache();
+			spill(cache, 0);
+			flush_stats(cache);
+		} catch (...) {
+			// can't get my cache, trim the rest anyway
+		}
+	}
+
+	void *blocks;
+	std::size_t count;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		blocks = std::exchange(m_free, nullptr);
+		count = std::exchange(m_free_count, 0);
+	}
+
+	while (blocks) {
+		void *next = pool_next_block(blocks);
+		release(blocks);
+		blocks = next;
+	}
+
+	m_retained.fetch_sub(static_cast<boost::int64_t>(count), std::memory_order_relaxed);
+	return count * m_block_size;
+}
+
+ObjectPoolStats ObjectPoolBase::stats() const noexcept {
+
+	if (!pool_thread_caches_gone) {
+		try {
+			flush_stats(thread_cache());
+		} catch (...) {
+			// then without my latest numbers
+		}
+	}
+
+	ObjectPoolStats ret;
+	ret.block_size = m_block_size;
+	ret.allocations = m_allocations.load(std::memory_order_relaxed);
+	ret.hits = m_hits.load(std::memory_order_relaxed);
+	ret.bytes_retained = static_cast<boost::uint64_t>(std::max<boost::int64_t>(m_retained.load(std::memory_order_relaxed), 0)) * m_block_size;
+	return ret;
+}
+
+std::size_t trim_object_pools() noexcept {
+
+	pool_registry &r = pool_registry_instance();
+	std::vector<ObjectPoolBase *> pools;
+	try {
+		std::lock_guard<std::mutex> lock(r.m_mutex);
+		pools = r.m_pools;
+	} catch (...) {
+		return 0;
+	}
+
+	std::size_t ret = 0;
+	for (ObjectPoolBase *p : pools) {
+		ret += p->trim();
+	}
+	return ret;
+}
+
+#if defined(BOOST_MSVC)
+void ObjectPoolGetRidOfLNK4221() {}
+#endif
+
+} // namespace tools
+} // namespace moose
@@ -0,0 +1,177 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+#include "MooseToolsConfig.hpp"
+#include "Pimpled.hpp"
+
+#include <boost/cstdint.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace moose {
+namespace tools {
+
+struct ObjectPoolStats {
+
+	std::size_t      block_size = 0;
+	boost::uint64_t  allocations = 0;
+	boost::uint64_t  hits = 0;            //!< allocations served from a free list rather than new
+	boost::uint64_t  bytes_retained = 0;  //!< held in free lists, not in use and not returned to the system
+
+	double hit_rate() const noexcept {
+
+		return allocations ? static_cast<double>(hits) / static_cast<double>(allocations) : 0.0;
+	}
+};
+
+/*! @brief fixed size block allocator with per-thread caches
+
+	Freed blocks go into a small cache of the freeing thread and are handed out
+	from there again without any locking. Only when a cache runs over or dry
+	half of it is moved to or from a shared free list, under a mutex.
+	Memory is never returned to the system unless you call trim().
+
+	Statistics are gathered per thread and added up every few hundred operations,
+	so with many threads they may lag a little.
+
+	Pools are created once per type by ObjectPool<T>::instance() and live
+	until the process ends, so objects may be freed in any thread at any time.
+ */
+class ObjectPoolBase {
+
+	public:
+		ObjectPoolBase(const ObjectPoolBase &n_other) = delete;
+		ObjectPoolBase &operator=(const ObjectPoolBase &n_other) = delete;
+
+		//! @throw std::bad_alloc
+		MOOSE_TOOLS_API void *allocate();
+
+		//! n_block must come from allocate() of this pool
+		MOOSE_TOOLS_API void deallocate(void *n_block) noexcept;
+
+		/*! @brief give all free blocks back to the system
+			That is all in the shared list and in the calling thread's cache.
+			Other threads' caches remain, they are small.
+			@return number of bytes released
+		 */
+		MOOSE_TOOLS_API std::size_t trim() noexcept;
+
+		//! includes the calling thread's latest numbers
+		MOOSE_TOOLS_API ObjectPoolStats stats() const noexcept;
+
+		std::size_t block_size() const noexcept {
+
+			return m_block_size;
+		}
+
+	protected:
+		MOOSE_TOOLS_API ObjectPoolBase(const std::size_t n_size, const std::size_t n_alignment);
+
+		//! never called as pools are immortal
+		~ObjectPoolBase() noexcept = default;
+
+	private:
+		friend struct ObjectPoolThreadCaches;
+		struct ThreadCache;
+
+		ThreadCache &thread_cache() const;
+
+		//! move blocks from the cache to the shared list until n_keep are left
+		void spill(ThreadCache &n_cache, const std::size_t n_keep) const noexcept;
+
+		//! move up to half a cache full from the shared list to n_cache
+		void refill(ThreadCache &n_cache) const noexcept;
+
+		//! add the cache's counters to the pool's
+		void flush_stats(ThreadCache &n_cache) const noexcept;
+
+		void release(void *n_block) const noexcept;
+
+		const std::size_t                     m_id;
+		const std::size_t                     m_block_size;
+		const std::size_t                     m_alignment;
+
+		mutable std::mutex                    m_mutex;
+		mutable void                         *m_free = nullptr;   //!< shared free list
+		mutable std::size_t                   m_free_count = 0;
+
+		mutable std::atomic<boost::uint64_t>  m_allocations{ 0 };
+		mutable std::atomic<boost::uint64_t>  m_hits{ 0 };
+		mutable std::atomic<boost::int64_t>   m_retained{ 0 };    //!< blocks in all free lists
+};
+
+/*! @brief the pool for objects of type T
+
+	@code
+	Session *s = ObjectPool<Session>::instance().create(connection);
+	ObjectPool<Session>::instance().destroy(s);
+	@endcode
+ */
+template< typename T >
+class ObjectPool : public ObjectPoolBase {
+
+	public:
+		//! intentionally leaked so it outlives all objects
+		static ObjectPool &instance() {
+
+			static ObjectPool *pool = new ObjectPool();
+			return *pool;
+		}
+
+		template< typename... Args >
+		T *create(Args &&... n_args) {
+
+			void *block = allocate();
+			try {
+				return ::new (block) T(std::forward<Args>(n_args)...);
+			} catch (...) {
+				deallocate(block);
+				throw;
+			}
+		}
+
+		void destroy(T *n_object) noexcept {
+
+			if (n_object) {
+				n_object->~T();
+				deallocate(n_object);
+			}
+		}
+
+	private:
+		ObjectPool()
+				: ObjectPoolBase(sizeof(T), alignof(T)) {
+		}
+};
+
+//! Allocation for Pimpled, impls come from their ObjectPool
+struct PimplPoolAllocation {
+
+	template< typename PimplType >
+	static PimplType *create() {
+
+		return ObjectPool<PimplType>::instance().create();
+	}
+
+	template< typename PimplType >
+	static void destroy(PimplType *n_impl) noexcept {
+
+		ObjectPool<PimplType>::instance().destroy(n_impl);
+	}
+};
+
+//! trim() all pools there are
+MOOSE_TOOLS_API std::size_t trim_object_pools() noexcept;
+
+#if defined(BOOST_MSVC)
+MOOSE_TOOLS_API void ObjectPoolGetRidOfLNK4221();
+#endif
+
+} // namespace tools
+} // namespace moose
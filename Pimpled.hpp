@@ -8,6 +8,9 @@
 
 #include <stdexcept>
 #include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
 
 namespace moose {
 namespace tools {
@@ -21,18 +24,36 @@ struct Pimplee {
 	MOOSE_TOOLS_API virtual ~Pimplee() noexcept;
 };
 
+//! default Allocation for Pimpled, plain new and delete
+struct PimplHeapAllocation {
+
+	template< typename PimplType >
+	static PimplType *create() {
+
+		return new PimplType();
+	}
+
+	//! deletes through Pimplee's virtual d'tor, so PimplType may be incomplete here
+	template< typename PimplType >
+	static void destroy(PimplType *n_impl) noexcept {
+
+		delete reinterpret_cast<Pimplee *>(n_impl);
+	}
+};
+
 //! PimplType must be default constructable
-//! and deriving from struct Pimplee
-template< typename PimplType >
+//! and deriving from struct Pimplee.
+//! Allocation is PimplHeapAllocation or PimplPoolAllocation from ObjectPool.hpp
+template< typename PimplType, typename Allocation = PimplHeapAllocation >
 class Pimpled {
 
 	protected:
 		Pimpled(void)
-			: m_d(new PimplType()) {
+			: m_d(Allocation::template create<PimplType>()) {
 
 			// Check if our PimplType has the correct base
 			if (!dynamic_cast<Pimplee *>(m_d)) {
-				delete m_d;
+				Allocation::destroy(m_d);
 				m_d = nullptr;
 				throw std::runtime_error("incorrect pimpl base class");
 			}
@@ -45,9 +66,8 @@ class Pimpled {
 		Pimpled(const Pimpled &n_other) = delete;
 		~Pimpled(void) noexcept {
 
-			Pimplee *tmp = reinterpret_cast<Pimplee *>(m_d);
-			assert(tmp);
-			delete tmp;
+			assert(m_d);
+			Allocation::destroy(m_d);
 			m_d = nullptr;
 		}
 
@@ -69,6 +89,88 @@ class Pimpled {
 		PimplType *m_d = nullptr;
 };
 
+namespace detail {
+
+//! separate so the compiler error shows the actual numbers
+template< std::size_t Needed, std::size_t Reserved >
+struct check_pimpl_size {
+	static_assert(Needed <= Reserved, "FastPimpled Size is too small for PimplType, see Needed in this instantiation");
+};
+
+template< std::size_t Needed, std::size_t Reserved >
+struct check_pimpl_align {
+	static_assert(Reserved % Needed == 0, "FastPimpled Align is insufficient for PimplType, see Needed in this instantiation");
+};
+
+} // namespace detail
+
+/*! @brief like Pimpled but with the impl in an inline buffer instead of on the heap
+
+	Worthwhile for small objects created often as there is no allocation
+	and no pointer to chase. The implementation stays hidden all the same,
+	but its size has to be known in advance. Size and alignment are checked
+	at compile time so when PimplType grows you get an error, not a crash.
+
+	As the checks need a complete PimplType your class' c'tors and d'tor
+	must be defined where PimplType is, usually in the cpp. Like this:
+
+	// .hpp
+	struct MyClassImpl;
+	class MyClass : private FastPimpled<MyClassImpl, 64> {
+		public:
+			MyClass();
+			~MyClass() noexcept;
+	};
+
+	// .cpp
+	struct MyClassImpl : public Pimplee { ... };
+	MyClass::MyClass() {}
+	MyClass::~MyClass() noexcept {}
+
+	PimplType must be default constructable and derive from Pimplee
+ */
+template< typename PimplType, std::size_t Size, std::size_t Align = alignof(std::max_align_t) >
+class FastPimpled {
+
+	protected:
+		FastPimpled(void) {
+
+			check_layout();
+			::new (static_cast<void *>(m_storage)) PimplType();
+		}
+
+		//! same as with Pimpled
+		FastPimpled(const FastPimpled &n_other) = delete;
+
+		~FastPimpled(void) noexcept {
+
+			check_layout();
+
+			// qualified, so there's no virtual call
+			d().PimplType::~PimplType();
+		}
+
+		PimplType &d(void) noexcept {
+
+			return *std::launder(reinterpret_cast<PimplType *>(m_storage));
+		}
+
+		PimplType const &d(void) const noexcept {
+
+			return *std::launder(reinterpret_cast<PimplType const *>(m_storage));
+		}
+
+	private:
+		static void check_layout() noexcept {
+
+			static_assert(std::is_base_of<Pimplee, PimplType>::value, "PimplType must derive from Pimplee");
+			static_assert(sizeof(detail::check_pimpl_size<sizeof(PimplType), Size>) > 0, "");
+			static_assert(sizeof(detail::check_pimpl_align<alignof(PimplType), Align>) > 0, "");
+		}
+
+		alignas(Align) unsigned char m_storage[Size];
+};
+
 }
 }
 
@@ -13,6 +13,10 @@
 #include <boost/random/uniform_int_distribution.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
 namespace moose {
 namespace tools {
 
@@ -39,6 +43,45 @@ namespace {
 		return local_gen.get();
 	}
 	
+	//! mix the seed so similar seeds don't produce correlated streams
+	inline boost::uint64_t splitmix64(boost::uint64_t &n_state) noexcept {
+
+		boost::uint64_t z = (n_state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	struct xorshift128plus {
+
+		//! Seeded without urand() as that may throw and fast_urand() may not.
+		//! The clock, the thread and where its instance lives all go in.
+		xorshift128plus() noexcept {
+
+			static std::atomic<boost::uint64_t> instances{ 0 };
+			boost::uint64_t seed = static_cast<boost::uint64_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count())
+					^ (static_cast<boost::uint64_t>(reinterpret_cast<std::uintptr_t>(this)) << 16)
+					^ (static_cast<boost::uint64_t>(thread_index()) << 48)
+					^ instances.fetch_add(0x9e3779b97f4a7c15ull, std::memory_order_relaxed);
+			m_s[0] = splitmix64(seed);
+			m_s[1] = splitmix64(seed);
+		}
+
+		boost::uint64_t operator()() noexcept {
+
+			boost::uint64_t s1 = m_s[0];
+			const boost::uint64_t s0 = m_s[1];
+			m_s[0] = s0;
+			s1 ^= s1 << 23;
+			m_s[1] = s1 ^ s0 ^ (s1 >> 17) ^ (s0 >> 26);
+			return m_s[1] + s0;
+		}
+
+		boost::uint64_t m_s[2];
+	};
+
+	thread_local xorshift128plus fast_gen;
+
 	// get access to a thread local instance of a uuid generator
 	inline uuid_generator_type *get_uuid_generator() {
 		
@@ -77,6 +120,35 @@ boost::uint64_t urand() {
 	return moose::tools::urand(std::numeric_limits<boost::uint64_t>::max());
 }
 
+boost::uint64_t fast_urand(const boost::uint64_t n_bound) noexcept {
+
+	if (!n_bound) {
+		return 0;
+	}
+
+#if defined(__SIZEOF_INT128__)
+	// Lemire's multiply and shift with rejection of the few biased low values
+	unsigned __int128 m = static_cast<unsigned __int128>(fast_gen()) * n_bound;
+	boost::uint64_t low = static_cast<boost::uint64_t>(m);
+	if (low < n_bound) {
+		const boost::uint64_t threshold = (0 - n_bound) % n_bound;
+		while (low < threshold) {
+			m = static_cast<unsigned __int128>(fast_gen()) * n_bound;
+			low = static_cast<boost::uint64_t>(m);
+		}
+	}
+	return static_cast<boost::uint64_t>(m >> 64);
+#else
+	// no 128 bit multiply, reject the incomplete last bucket instead
+	const boost::uint64_t threshold = (0 - n_bound) % n_bound;
+	boost::uint64_t r = fast_gen();
+	while (r < threshold) {
+		r = fast_gen();
+	}
+	return r % n_bound;
+#endif
+}
+
 boost::uuids::uuid ruuid() {
 
 	uuid_generator_type *gen = get_uuid_generator();
@@ -31,6 +31,19 @@ MOOSE_TOOLS_API boost::uint64_t urand(const boost::uint64_t n_min, const boost::
  */
 MOOSE_TOOLS_API boost::uint64_t urand();
 
+/*! @brief fast, non-cryptographic random number in [0, n_bound)
+
+	Uses a thread local xorshift128+ generator seeded once per thread from the clock
+	and the thread, which cannot throw unlike urand(). Rejection keeps it free of bias.
+	Where the compiler has 128 bit integers it maps into the range by multiplication
+	and divides only in the rare case of a candidate for rejection, elsewhere it takes
+	two modulos per call. Much cheaper than urand() for hot paths like picking a random
+	element.
+	@note returns 0 for n_bound 0
+	@throw nil
+ */
+MOOSE_TOOLS_API boost::uint64_t fast_urand(const boost::uint64_t n_bound) noexcept;
+
 /*! @brief creates a random uuid out of thin air
  *  @return random uuid
  *  @throw std::bad_alloc when out of memory on first use
@@ -0,0 +1,15 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include "RefCounted.hpp"
+
+namespace moose {
+namespace tools {
+
+#if defined(BOOST_MSVC)
+void RefCountedGetRidOfLNK4221() {}
+#endif
+
+} // namespace tools
+} // namespace moose
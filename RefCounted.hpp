@@ -0,0 +1,150 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+#include "MooseToolsConfig.hpp"
+#include "Assert.hpp"
+
+#include <boost/smart_ptr/intrusive_ptr.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#if defined(MOOSE_DEBUG)
+#include <thread>
+#endif
+
+namespace moose {
+namespace tools {
+
+/*! @brief base for objects held by boost::intrusive_ptr, thread safe
+
+	The count lives in the object itself, so unlike std::shared_ptr there is
+	no separate control block and creating one is a single allocation.
+	Pointers are just as safe to copy and release from many threads.
+	There's no weak_ptr equivalent though.
+
+	@code
+	MOOSE_FWD_DECLARE_CLASS(Session)
+	class Session : public RefCounted<Session> { ... };
+	SessionIPtr s = make_intrusive<Session>();
+	@endcode
+ */
+template< typename DerivedType >
+class RefCounted {
+
+	public:
+		//! for debugging and tests. Racy by nature
+		std::size_t use_count() const noexcept {
+
+			return m_references.load(std::memory_order_relaxed);
+		}
+
+	protected:
+		RefCounted() noexcept = default;
+
+		//! copies are new objects with their own count
+		RefCounted(const RefCounted &) noexcept {
+		}
+
+		RefCounted &operator=(const RefCounted &) noexcept {
+
+			return *this;
+		}
+
+		~RefCounted() noexcept = default;
+
+	private:
+		friend void intrusive_ptr_add_ref(const RefCounted *n_object) noexcept {
+
+			n_object->m_references.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		friend void intrusive_ptr_release(const RefCounted *n_object) noexcept {
+
+			if (n_object->m_references.fetch_sub(1, std::memory_order_release) == 1) {
+				// All other threads' writes to the object must be visible before it goes
+				std::atomic_thread_fence(std::memory_order_acquire);
+				delete static_cast<const DerivedType *>(n_object);
+			}
+		}
+
+		mutable std::atomic<std::size_t> m_references{ 0 };
+};
+
+/*! @brief base for objects held by boost::intrusive_ptr which never leave their thread
+
+	Like RefCounted but with a plain integer count, so no atomic operations at all.
+	Meant for objects confined to one thread such as everything handled by one
+	single threaded io_context. Copying and releasing pointers from any other
+	thread corrupts the count.
+
+	Built with MOOSE_DEBUG this is asserted. The owner is the thread that created
+	the object. Call rebind_thread() when handing it over to another one for good.
+ */
+template< typename DerivedType >
+class LocalRefCounted {
+
+	public:
+		std::size_t use_count() const noexcept {
+
+			return m_references;
+		}
+
+		//! make the calling thread the owner. Only required with MOOSE_DEBUG
+		void rebind_thread() noexcept {
+
+#if defined(MOOSE_DEBUG)
+			m_owner = std::this_thread::get_id();
+#endif
+		}
+
+	protected:
+		LocalRefCounted() noexcept = default;
+
+		LocalRefCounted(const LocalRefCounted &) noexcept {
+		}
+
+		LocalRefCounted &operator=(const LocalRefCounted &) noexcept {
+
+			return *this;
+		}
+
+		~LocalRefCounted() noexcept = default;
+
+	private:
+		friend void intrusive_ptr_add_ref(const LocalRefCounted *n_object) noexcept {
+
+			MOOSE_ASSERT_MSG(n_object->m_owner == std::this_thread::get_id(), "LocalRefCounted object referenced outside its thread");
+			++n_object->m_references;
+		}
+
+		friend void intrusive_ptr_release(const LocalRefCounted *n_object) noexcept {
+
+			MOOSE_ASSERT_MSG(n_object->m_owner == std::this_thread::get_id(), "LocalRefCounted object released outside its thread");
+			if (--n_object->m_references == 0) {
+				delete static_cast<const DerivedType *>(n_object);
+			}
+		}
+
+		mutable std::size_t  m_references = 0;
+#if defined(MOOSE_DEBUG)
+		std::thread::id      m_owner = std::this_thread::get_id();
+#endif
+};
+
+//! like std::make_shared but for the above
+template< typename T, typename... Args >
+boost::intrusive_ptr<T> make_intrusive(Args &&... n_args) {
+
+	return boost::intrusive_ptr<T>(new T(std::forward<Args>(n_args)...));
+}
+
+#if defined(BOOST_MSVC)
+MOOSE_TOOLS_API void RefCountedGetRidOfLNK4221();
+#endif
+
+} // namespace tools
+} // namespace moose
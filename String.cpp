@@ -8,13 +8,12 @@
 
 #include <boost/spirit/include/qi.hpp>
 #include <boost/spirit/include/qi_parse.hpp>
-#include <boost/spirit/include/phoenix.hpp>
-#include <boost/fusion/include/vector.hpp>
 #include <boost/spirit/include/karma.hpp>
 #include <boost/asio.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/xpressive/xpressive.hpp>
 
+#include <cstring>
 #include <map>
 
 namespace moose {
@@ -29,90 +28,245 @@ void truncate(std::string &n_string, std::size_t n_length) noexcept {
 	}
 }
 
-struct ip4_from_str_impl {
+namespace qi = boost::spirit::qi;
+namespace karma = boost::spirit::karma;
+namespace ip = boost::asio::ip;
 
-	typedef boost::asio::ip::address_v4  result_type;
+namespace {
 
-	template <typename Arg>
-	result_type operator()(const Arg n_str) const {
+	inline bool endpoint_is_digit(const char n_char) noexcept {
+
+		return (n_char >= '0') && (n_char <= '9');
+	}
 
-#if BOOST_VERSION / 100000 >= 1 && BOOST_VERSION / 100 % 1000 >= 66
-		return boost::asio::ip::make_address_v4(n_str);
-#else
-		return boost::asio::ip::address_v4::from_string(n_str);
-#endif
+	//! @return value of a hex digit or -1 if it isn't one
+	inline int endpoint_hex_value(const char n_char) noexcept {
 
+		if (endpoint_is_digit(n_char)) {
+			return n_char - '0';
+		} else if ((n_char >= 'a') && (n_char <= 'f')) {
+			return n_char - 'a' + 10;
+		} else if ((n_char >= 'A') && (n_char <= 'F')) {
+			return n_char - 'A' + 10;
+		}
+		return -1;
 	}
-};
 
-struct ip6_from_str_impl {
+	/*! @brief dotted quad in exactly [n_begin, n_end) into 4 bytes
+
+		Like inet_pton() this rejects leading zeros as some would read them as octal.
+	 */
+	bool endpoint_parse_v4(const char *n_begin, const char *const n_end, unsigned char *n_bytes) noexcept {
+
+		for (int octet = 0; octet < 4; ++octet) {
+			if (octet > 0) {
+				if ((n_begin == n_end) || (*n_begin != '.')) {
+					return false;
+				}
+				++n_begin;
+			}
+
+			const char *const start = n_begin;
+			unsigned int value = 0;
+			while ((n_begin != n_end) && endpoint_is_digit(*n_begin)) {
+				value = value * 10 + static_cast<unsigned int>(*n_begin - '0');
+				if (value > 255) {
+					return false;
+				}
+				++n_begin;
+			}
+
+			if ((n_begin == start) || ((n_begin - start > 1) && (*start == '0'))) {
+				return false;
+			}
+			n_bytes[octet] = static_cast<unsigned char>(value);
+		}
+
+		return n_begin == n_end;
+	}
+
+	/*! @brief RFC 4291 text form in exactly [n_begin, n_end) into 16 bytes
+
+		Handles "::" compression and a trailing dotted quad. Zone indices are not supported.
+	 */
+	bool endpoint_parse_v6(const char *n_begin, const char *const n_end, unsigned char *n_bytes) noexcept {
+
+		unsigned char parsed[16];
+		int count = 0;     // bytes in parsed
+		int gap = -1;      // where in parsed the "::" was seen
+
+		if ((n_end - n_begin >= 2) && (n_begin[0] == ':') && (n_begin[1] == ':')) {
+			gap = 0;
+			n_begin += 2;
+		}
+
+		while (n_begin != n_end) {
+			const char *const group = n_begin;
+			unsigned int value = 0;
+			int hex;
+			while ((n_begin != n_end) && ((hex = endpoint_hex_value(*n_begin)) >= 0)) {
+				if (n_begin - group == 4) {
+					return false;
+				}
+				value = (value << 4) | static_cast<unsigned int>(hex);
+				++n_begin;
+			}
+
+			// what looked like a group is the start of an embedded IPv4 address
+			if ((n_begin != n_end) && (*n_begin == '.')) {
+				if ((count > 12) || !endpoint_parse_v4(group, n_end, parsed + count)) {
+					return false;
+				}
+				count += 4;
+				break;
+			}
+
+			if ((n_begin == group) || (count == 16)) {
+				return false;
+			}
+			parsed[count++] = static_cast<unsigned char>(value >> 8);
+			parsed[count++] = static_cast<unsigned char>(value & 0xff);
+
+			if (n_begin == n_end) {
+				break;
+			}
+			if (*n_begin != ':') {
+				return false;
+			}
+			++n_begin;
+			if ((n_begin != n_end) && (*n_begin == ':')) {
+				if (gap >= 0) {
+					return false;
+				}
+				gap = count;
+				++n_begin;
+			} else if (n_begin == n_end) {
+				return false;
+			}
+		}
 
-	typedef boost::asio::ip::address_v6  result_type;
+		if (gap < 0) {
+			if (count != 16) {
+				return false;
+			}
+			std::memcpy(n_bytes, parsed, 16);
+			return true;
+		}
 
-	template <typename Arg>
-	result_type operator()(const Arg n_str) const {
-#if BOOST_VERSION / 100000 >= 1 && BOOST_VERSION / 100 % 1000 >= 66
-		return  boost::asio::ip::make_address_v6(n_str);
-#else
-		return boost::asio::ip::address_v6::from_string(n_str);
-#endif
+		// "::" must stand for at least one group
+		if (count == 16) {
+			return false;
+		}
+		const int tail = count - gap;
+		std::memset(n_bytes, 0, 16);
+		std::memcpy(n_bytes, parsed, static_cast<std::size_t>(gap));
+		std::memcpy(n_bytes + 16 - tail, parsed + gap, static_cast<std::size_t>(tail));
+		return true;
 	}
-};
 
-namespace qi = boost::spirit::qi;
-namespace karma = boost::spirit::karma;
-namespace ascii = qi::ascii;
-namespace ip = boost::asio::ip;
-namespace phx = boost::phoenix;
+	bool endpoint_parse_port(const char *n_begin, const char *const n_end, unsigned short int &n_port) noexcept {
 
-typedef boost::fusion::vector<ip::address, unsigned int>  ip_tuple;
+		if (n_begin == n_end) {
+			return false;
+		}
 
-/*! @brief parse a google format ip and port */
-template <typename Iterator>
-struct google_ip_parser : qi::grammar<Iterator, ip_tuple()> {
+		unsigned int value = 0;
+		for (; n_begin != n_end; ++n_begin) {
+			if (!endpoint_is_digit(*n_begin)) {
+				return false;
+			}
+			value = value * 10 + static_cast<unsigned int>(*n_begin - '0');
+			if (value > 65535) {
+				return false;
+			}
+		}
+
+		n_port = static_cast<unsigned short int>(value);
+		return true;
+	}
 
-	google_ip_parser() : google_ip_parser::base_type(m_start, "google_ip") {
+	/*! @brief "<ipv4>:<port>" or "[<ipv6>]:<port>" in a single pass
+
+		Only touches n_address and n_port on success.
+	 */
+	endpoint_parse_error endpoint_parse(const std::string_view n_endpoint, ip::address &n_address, unsigned short int &n_port) noexcept {
+
+		const char *begin = n_endpoint.data();
+		const char *const end = begin + n_endpoint.size();
+		const char *port_begin;
+		ip::address address;
+
+		if ((begin != end) && (*begin == '[')) {
+			++begin;
+			const char *const close = static_cast<const char *>(std::memchr(begin, ']', static_cast<std::size_t>(end - begin)));
+			ip::address_v6::bytes_type bytes;
+			if (!close || !endpoint_parse_v6(begin, close, bytes.data())) {
+				return endpoint_parse_error::bad_address;
+			}
+			address = ip::address_v6(bytes);
+			port_begin = close + 1;
+		} else {
+			const char *const colon = static_cast<const char *>(std::memchr(begin, ':', static_cast<std::size_t>(end - begin)));
+			port_begin = colon ? colon : end;
+			ip::address_v4::bytes_type bytes;
+			if (!endpoint_parse_v4(begin, port_begin, bytes.data())) {
+				return endpoint_parse_error::bad_address;
+			}
+			address = ip::address_v4(bytes);
+		}
+
+		unsigned short int port = 0;
+		if ((port_begin == end) || (*port_begin != ':') || !endpoint_parse_port(port_begin + 1, end, port)) {
+			return endpoint_parse_error::bad_port;
+		}
 
-		using qi::_1;
-		using qi::_2;
-		using qi::_val;
+		n_address = address;
+		n_port = port;
+		return endpoint_parse_error::none;
+	}
 
-		m_ipv4_string  %= "ipv4:" >> +qi::char_("0-9\\.");
-		m_ipv6_string  %= "ipv6:[" >> +qi::char_(":A-Fa-f0-9\\.") >> "]";
+	inline compact_error endpoint_parse_failure(const endpoint_parse_error n_error) noexcept {
 
-		m_ipv4_address  = m_ipv4_string[_val = v4_from_str(_1)];
-		m_ipv6_address  = m_ipv6_string[_val = v6_from_str(_1)];
+		return compact_error(error_kind::network, "Cannot parse IP", static_cast<int>(n_error));
+	}
+}
 
-		m_start        %= (m_ipv4_address | m_ipv6_address) >> ":" >> qi::uint_;
+const char *endpoint_parse_error_name(const endpoint_parse_error n_error) noexcept {
+
+	switch (n_error) {
+		case endpoint_parse_error::none:
+			return "none";
+		case endpoint_parse_error::bad_prefix:
+			return "bad prefix";
+		case endpoint_parse_error::bad_address:
+			return "bad address";
+		case endpoint_parse_error::bad_port:
+			return "bad port";
 	}
+	return "unknown";
+}
 
-	boost::phoenix::function<ip4_from_str_impl>    v4_from_str;
-	boost::phoenix::function<ip6_from_str_impl>    v6_from_str;
+endpoint_parse_error parse_endpoint(const std::string_view n_endpoint, ip::address &n_address, unsigned short int &n_port) noexcept {
 
-	qi::rule<Iterator, std::string()>        m_ipv4_string;
-	qi::rule<Iterator, ip::address_v4()>     m_ipv4_address;
-	qi::rule<Iterator, std::string()>        m_ipv6_string;
-	qi::rule<Iterator, ip::address_v6()>     m_ipv6_address;
-	qi::rule<Iterator, ip_tuple()>          m_start;
-};
+	return endpoint_parse(n_endpoint, n_address, n_port);
+}
+
+endpoint_parse_error parse_google_ep(const std::string_view n_google_ep, ip::address &n_address, unsigned short int &n_port) noexcept {
+
+	// The prefix has to match the bracketing, "ipv4:[::1]:80" is as wrong as "ipv6:127.0.0.1:80"
+	if ((n_google_ep.substr(0, 6) != "ipv6:[") && ((n_google_ep.substr(0, 5) != "ipv4:") || (n_google_ep.substr(5, 1) == "["))) {
+		return endpoint_parse_error::bad_prefix;
+	}
+
+	return endpoint_parse(n_google_ep.substr(5), n_address, n_port);
+}
 
 void from_google_ep(const std::string &n_google_ep, boost::asio::ip::address &n_address, unsigned short int &n_port) {
-	
-	google_ip_parser<std::string::const_iterator> p;
-	ip_tuple                           result;
-	std::string::const_iterator         begin = n_google_ep.begin();
-	const std::string::const_iterator   end = n_google_ep.end();
-
-	try {
-		if (qi::parse(begin, end, p, result) && (begin == end)) {
-			n_address = boost::fusion::at_c<0>(result);
-			n_port = boost::fusion::at_c<1>(result);
-			return;
-		} else {
-			BOOST_THROW_EXCEPTION(network_error() << error_message("Cannot parse IP") << error_argument(n_google_ep));
-		}
-	} catch (const std::exception &) {  // asio throws on invalid parse
-		BOOST_THROW_EXCEPTION(network_error() << error_message("Cannot parse IP") << error_argument(n_google_ep));
+
+	const endpoint_parse_error result = parse_google_ep(n_google_ep, n_address, n_port);
+	if (result != endpoint_parse_error::none) {
+		BOOST_THROW_EXCEPTION(network_error() << error_message(std::string("Cannot parse IP, ") + endpoint_parse_error_name(result))
+			<< error_argument(n_google_ep));
 	}
 }
 
@@ -122,6 +276,18 @@ void from_google_ep(const std::string &n_google_ep, boost::asio::ip::address &n_
 	return from_google_ep(n_google_ep, n_address, unused_port);
 }
 
+expected<ip::tcp::endpoint> try_from_google_ep(const std::string_view n_google_ep) noexcept {
+
+	ip::address address;
+	unsigned short int port = 0;
+	const endpoint_parse_error result = parse_google_ep(n_google_ep, address, port);
+	if (result != endpoint_parse_error::none) {
+		return endpoint_parse_failure(result);
+	}
+
+	return ip::tcp::endpoint(address, port);
+}
+
 std::string endpoint_to_string(const boost::asio::ip::udp::endpoint &n_endpoint) {
 
 	std::ostringstream oss;
@@ -129,56 +295,29 @@ std::string endpoint_to_string(const boost::asio::ip::udp::endpoint &n_endpoint)
 	return oss.str();
 }
 
+boost::asio::ip::udp::endpoint string_to_udp_endpoint(const std::string &n_endpoint) {
 
-/*! @brief parse a normal format ip and port */
-template <typename Iterator>
-struct ip_parser : qi::grammar<Iterator, ip_tuple()> {
-
-	ip_parser() : ip_parser::base_type(m_start, "ip_endpoint") {
-
-		using qi::_1;
-		using qi::_2;
-		using qi::_val;
-
-		m_ipv4_string %= +qi::char_("0-9\\.");
-		m_ipv6_string %= "[" >> +qi::char_(":A-Fa-f0-9\\.") >> "]";
-
-		m_ipv4_address = m_ipv4_string[_val = v4_from_str(_1)];
-		m_ipv6_address = m_ipv6_string[_val = v6_from_str(_1)];
-
-		m_start %= (m_ipv4_address | m_ipv6_address) >> ":" >> qi::uint_;
+	ip::address address;
+	unsigned short int port = 0;
+	const endpoint_parse_error result = parse_endpoint(n_endpoint, address, port);
+	if (result != endpoint_parse_error::none) {
+		BOOST_THROW_EXCEPTION(network_error() << error_message(std::string("Cannot parse IP, ") + endpoint_parse_error_name(result))
+			<< error_argument(n_endpoint));
 	}
 
-	boost::phoenix::function<ip4_from_str_impl>    v4_from_str;
-	boost::phoenix::function<ip6_from_str_impl>    v6_from_str;
-
-	qi::rule<Iterator, std::string()>        m_ipv4_string;
-	qi::rule<Iterator, ip::address_v4()>     m_ipv4_address;
-	qi::rule<Iterator, std::string()>        m_ipv6_string;
-	qi::rule<Iterator, ip::address_v6()>     m_ipv6_address;
-	qi::rule<Iterator, ip_tuple()>           m_start;
-};
+	return ip::udp::endpoint(address, port);
+}
 
-boost::asio::ip::udp::endpoint string_to_udp_endpoint(const std::string &n_endpoint) {
+expected<ip::udp::endpoint> try_string_to_udp_endpoint(const std::string_view n_endpoint) noexcept {
 
-	boost::asio::ip::address address;
-	unsigned short int       port = 0;
-	ip_parser<std::string::const_iterator> p;
-	ip_tuple                               result;
-	std::string::const_iterator            begin = n_endpoint.begin();
-	const std::string::const_iterator      end = n_endpoint.end();
-
-	try {
-		if (qi::parse(begin, end, p, result) && (begin == end)) {
-			address = boost::fusion::at_c<0>(result);
-			port = boost::fusion::at_c<1>(result);
-			return boost::asio::ip::udp::endpoint(address, port);
-		} else {
-			BOOST_THROW_EXCEPTION(network_error() << error_message("Cannot parse IP") << error_argument(n_endpoint));
-		}
-	} catch (const std::exception &) {  // asio throws on invalid parse
-		BOOST_THROW_EXCEPTION(network_error() << error_message("Cannot parse IP") << error_argument(n_endpoint));
+	ip::address address;
+	unsigned short int port = 0;
+	const endpoint_parse_error result = parse_endpoint(n_endpoint, address, port);
+	if (result != endpoint_parse_error::none) {
+		return endpoint_parse_failure(result);
 	}
+
+	return ip::udp::endpoint(address, port);
 }
 
 std::string itoa(const boost::uint64_t n_number) {
@@ -5,12 +5,14 @@
 
 #pragma once
 #include "MooseToolsConfig.hpp"
+#include "Expected.hpp"
 
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/udp.hpp>
 #include <boost/filesystem/path.hpp>
 
 #include <string>
+#include <string_view>
 
 namespace moose {
 namespace tools {
@@ -27,6 +29,32 @@ void trim(SequenceT &n_string);
 }
 */
 
+//! why an endpoint string could not be parsed
+enum class endpoint_parse_error : boost::uint8_t {
+	none = 0,
+	bad_prefix,       //!< google format that doesn't start with "ipv4:" or "ipv6:["
+	bad_address,      //!< not a valid IPv4 or bracketed IPv6 address
+	bad_port          //!< port missing, not a number or larger than 65535
+};
+
+MOOSE_TOOLS_API const char *endpoint_parse_error_name(const endpoint_parse_error n_error) noexcept;
+
+/*! @brief parse "<ipv4>:<port>" or "[<ipv6>]:<port>"
+
+	Address and port are read in one pass without allocating or going through asio's parser.
+	IPv6 may use "::" and a trailing dotted quad but no zone index.
+	n_address and n_port are only written on success.
+ */
+MOOSE_TOOLS_API endpoint_parse_error parse_endpoint(const std::string_view n_endpoint, boost::asio::ip::address &n_address, unsigned short int &n_port) noexcept;
+
+/*! @brief like parse_endpoint() but for google's "ipv4:" and "ipv6:" prefixed format
+
+	examples:
+	* ipv6:[2a02:810d:e40:67c:adb3:f561:144f:89f5]:61176
+	* ipv4:192.168.178.30:61185
+ */
+MOOSE_TOOLS_API endpoint_parse_error parse_google_ep(const std::string_view n_google_ep, boost::asio::ip::address &n_address, unsigned short int &n_port) noexcept;
+
 /*! @brief google uses an endpoint representation string that I don't exactly know but try to parse here
 
 	examples:
@@ -47,10 +75,27 @@ MOOSE_TOOLS_API void from_google_ep(const std::string &n_google_ep, boost::asio:
 */
 MOOSE_TOOLS_API void from_google_ep(const std::string &n_google_ep, boost::asio::ip::address &n_address);
 
+/*! @brief like from_google_ep() but reports errors without throwing or allocating
+
+	Meant for input that is malformed often enough for exceptions to hurt.
+	@return address and port or a network error with the endpoint_parse_error as code
+ */
+MOOSE_TOOLS_API expected<boost::asio::ip::tcp::endpoint> try_from_google_ep(const std::string_view n_google_ep) noexcept;
+
 MOOSE_TOOLS_API std::string endpoint_to_string(const boost::asio::ip::udp::endpoint &n_endpoint);
 
 MOOSE_TOOLS_API boost::asio::ip::udp::endpoint string_to_udp_endpoint(const std::string &n_endpoint);
 
+/*! @brief like string_to_udp_endpoint() but reports errors without throwing or allocating
+
+	examples:
+	* 192.168.178.30:61185
+	* [2a02:810d:e40:67c:adb3:f561:144f:89f5]:61176
+
+	@return the endpoint or a network error with the endpoint_parse_error as code
+ */
+MOOSE_TOOLS_API expected<boost::asio::ip::udp::endpoint> try_string_to_udp_endpoint(const std::string_view n_endpoint) noexcept;
+
 //! spirit itoa wrapper. Always succeeds except bad_alloc
 MOOSE_TOOLS_API std::string itoa(const boost::uint64_t n_number);
 
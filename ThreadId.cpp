@@ -9,6 +9,7 @@
 #include <boost/spirit/include/qi.hpp>
 #include <boost/functional/hash.hpp>
 
+#include <atomic>
 #include <sstream>
 #include <string>
 
@@ -43,6 +44,17 @@ unsigned int faked_thread_id() throw () {
 	}
 }
 
+namespace {
+
+	std::atomic<unsigned int> next_thread_index{ 0 };
+	thread_local const unsigned int local_thread_index = next_thread_index.fetch_add(1, std::memory_order_relaxed);
+}
+
+unsigned int thread_index() noexcept {
+
+	return local_thread_index;
+}
+
 }
 }
 
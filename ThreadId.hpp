@@ -13,6 +13,14 @@ namespace tools {
 //! a number and tries really hard to give you that number
 MOOSE_TOOLS_API unsigned int faked_thread_id() throw ();
 
+/*! @brief a small, dense number for the calling thread
+
+	Threads are numbered 0, 1, 2... in the order they first call this.
+	Meant to pick a per-thread slot or stripe in arrays.
+	Numbers of finished threads are not recycled.
+ */
+MOOSE_TOOLS_API unsigned int thread_index() noexcept;
+
 }
 }
 
@@ -0,0 +1,28 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/_gate_prof/CMakeFiles/moose_tools.dir/Unity/unity_0_cxx.cxx" "CMakeFiles/moose_tools.dir/Unity/unity_0_cxx.cxx.o" "gcc" "CMakeFiles/moose_tools.dir/Unity/unity_0_cxx.cxx.o.d"
+  "/root/repo/_gate_prof/CMakeFiles/moose_tools.dir/cmake_pch.hxx" "CMakeFiles/moose_tools.dir/Unity/unity_0_cxx.cxx.o" "gcc" "CMakeFiles/moose_tools.dir/Unity/unity_0_cxx.cxx.o.d"
+  "/root/repo/_gate_prof/CMakeFiles/moose_tools.dir/Unity/unity_1_cxx.cxx" "CMakeFiles/moose_tools.dir/Unity/unity_1_cxx.cxx.o" "gcc" "CMakeFiles/moose_tools.dir/Unity/unity_1_cxx.cxx.o.d"
+  "/root/repo/_gate_prof/CMakeFiles/moose_tools.dir/cmake_pch.hxx" "CMakeFiles/moose_tools.dir/Unity/unity_1_cxx.cxx.o" "gcc" "CMakeFiles/moose_tools.dir/Unity/unity_1_cxx.cxx.o.d"
+  "/root/repo/_gate_prof/CMakeFiles/moose_tools.dir/Unity/unity_2_cxx.cxx" "CMakeFiles/moose_tools.dir/Unity/unity_2_cxx.cxx.o" "gcc" "CMakeFiles/moose_tools.dir/Unity/unity_2_cxx.cxx.o.d"
+  "/root/repo/_gate_prof/CMakeFiles/moose_tools.dir/cmake_pch.hxx" "CMakeFiles/moose_tools.dir/Unity/unity_2_cxx.cxx.o" "gcc" "CMakeFiles/moose_tools.dir/Unity/unity_2_cxx.cxx.o.d"
+  "/root/repo/_gate_prof/CMakeFiles/moose_tools.dir/Unity/unity_3_cxx.cxx" "CMakeFiles/moose_tools.dir/Unity/unity_3_cxx.cxx.o" "gcc" "CMakeFiles/moose_tools.dir/Unity/unity_3_cxx.cxx.o.d"
+  "/root/repo/_gate_prof/CMakeFiles/moose_tools.dir/cmake_pch.hxx" "CMakeFiles/moose_tools.dir/Unity/unity_3_cxx.cxx.o" "gcc" "CMakeFiles/moose_tools.dir/Unity/unity_3_cxx.cxx.o.d"
+  "/root/repo/_gate_prof/CMakeFiles/moose_tools.dir/cmake_pch.hxx.cxx" "CMakeFiles/moose_tools.dir/cmake_pch.hxx.gch" "gcc" "CMakeFiles/moose_tools.dir/cmake_pch.hxx.gch.d"
+  "/root/repo/_gate_prof/CMakeFiles/moose_tools.dir/cmake_pch.hxx" "CMakeFiles/moose_tools.dir/cmake_pch.hxx.gch" "gcc" "CMakeFiles/moose_tools.dir/cmake_pch.hxx.gch.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
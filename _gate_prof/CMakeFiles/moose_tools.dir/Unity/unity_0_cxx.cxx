@@ -0,0 +1,18 @@
+/* generated by CMake */
+
+#include "/root/repo/Carne.cpp"
+
+#include "/root/repo/Memoized.cpp"
+
+#include "/root/repo/Random.cpp"
+
+#include "/root/repo/ThreadId.cpp"
+
+#include "/root/repo/Pimpled.cpp"
+
+#include "/root/repo/ObjectPool.cpp"
+
+#include "/root/repo/Mutexed.cpp"
+
+#include "/root/repo/Lockables.cpp"
+
@@ -0,0 +1,18 @@
+/* generated by CMake */
+
+#include "/root/repo/LockProfile.cpp"
+
+#include "/root/repo/Macros.cpp"
+
+#include "/root/repo/RefCounted.cpp"
+
+#include "/root/repo/Error.cpp"
+
+#include "/root/repo/Expected.cpp"
+
+#include "/root/repo/IdTagged.cpp"
+
+#include "/root/repo/BloomFilter.cpp"
+
+#include "/root/repo/IdTaggedContainer.cpp"
+
@@ -0,0 +1,18 @@
+/* generated by CMake */
+
+#include "/root/repo/IdTaggedSnapshot.cpp"
+
+#include "/root/repo/IdTaggedReplication.cpp"
+
+#include "/root/repo/String.cpp"
+
+#include "/root/repo/Homedir.cpp"
+
+#include "/root/repo/Log.cpp"
+
+#include "/root/repo/Assert.cpp"
+
+#include "/root/repo/AsioHelpers.cpp"
+
+#include "/root/repo/TimedConnect.cpp"
+
@@ -0,0 +1,8 @@
+/* generated by CMake */
+
+#include "/root/repo/IncarnationWait.cpp"
+
+#include "/root/repo/SOCKS4.cpp"
+
+#include "/root/repo/FilesystemHelpers.cpp"
+
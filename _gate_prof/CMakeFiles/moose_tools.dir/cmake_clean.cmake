@@ -0,0 +1,19 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/moose_tools.dir/Unity/unity_0_cxx.cxx.o"
+  "CMakeFiles/moose_tools.dir/Unity/unity_0_cxx.cxx.o.d"
+  "CMakeFiles/moose_tools.dir/Unity/unity_1_cxx.cxx.o"
+  "CMakeFiles/moose_tools.dir/Unity/unity_1_cxx.cxx.o.d"
+  "CMakeFiles/moose_tools.dir/Unity/unity_2_cxx.cxx.o"
+  "CMakeFiles/moose_tools.dir/Unity/unity_2_cxx.cxx.o.d"
+  "CMakeFiles/moose_tools.dir/Unity/unity_3_cxx.cxx.o"
+  "CMakeFiles/moose_tools.dir/Unity/unity_3_cxx.cxx.o.d"
+  "CMakeFiles/moose_tools.dir/cmake_pch.hxx.gch"
+  "CMakeFiles/moose_tools.dir/cmake_pch.hxx.gch.d"
+  "libmoose_tools.a"
+  "libmoose_tools.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/moose_tools.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
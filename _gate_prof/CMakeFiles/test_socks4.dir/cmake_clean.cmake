@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_socks4.dir/test_socks4.cpp.o"
+  "CMakeFiles/test_socks4.dir/test_socks4.cpp.o.d"
+  "test_socks4"
+  "test_socks4.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/test_socks4.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,31 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo
+# Build directory: /root/repo/_gate_prof
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(Random "/root/repo/_gate_prof/test/TestRandom")
+set_tests_properties(Random PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;168;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(ThreadedId "/root/repo/_gate_prof/test/TestThreadId")
+set_tests_properties(ThreadedId PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;169;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(String "/root/repo/_gate_prof/test/TestString")
+set_tests_properties(String PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;170;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(IdTagged "/root/repo/_gate_prof/test/TestIdTagged")
+set_tests_properties(IdTagged PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;171;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(Mutexed "/root/repo/_gate_prof/test/TestMutexed")
+set_tests_properties(Mutexed PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;172;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(AsioHelpers "/root/repo/_gate_prof/test/TestAsioHelpers")
+set_tests_properties(AsioHelpers PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;173;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(Replication "/root/repo/_gate_prof/test/TestReplication")
+set_tests_properties(Replication PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;174;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(Incarnated "/root/repo/_gate_prof/test/TestIncarnated")
+set_tests_properties(Incarnated PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;175;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(Pimpled "/root/repo/_gate_prof/test/TestPimpled")
+set_tests_properties(Pimpled PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;176;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(ObjectPool "/root/repo/_gate_prof/test/TestObjectPool")
+set_tests_properties(ObjectPool PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;177;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(RefCounted "/root/repo/_gate_prof/test/TestRefCounted")
+set_tests_properties(RefCounted PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;178;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(Error "/root/repo/_gate_prof/test/TestError")
+set_tests_properties(Error PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;179;add_test;/root/repo/CMakeLists.txt;0;")
+subdirs("test")
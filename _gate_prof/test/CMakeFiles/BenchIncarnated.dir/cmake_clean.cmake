@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "BenchIncarnated"
+  "BenchIncarnated.pdb"
+  "CMakeFiles/BenchIncarnated.dir/BenchIncarnated.cpp.o"
+  "CMakeFiles/BenchIncarnated.dir/BenchIncarnated.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/BenchIncarnated.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "BenchMutexed"
+  "BenchMutexed.pdb"
+  "CMakeFiles/BenchMutexed.dir/BenchMutexed.cpp.o"
+  "CMakeFiles/BenchMutexed.dir/BenchMutexed.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/BenchMutexed.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
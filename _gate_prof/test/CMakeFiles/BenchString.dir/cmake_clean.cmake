@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "BenchString"
+  "BenchString.pdb"
+  "CMakeFiles/BenchString.dir/BenchString.cpp.o"
+  "CMakeFiles/BenchString.dir/BenchString.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/BenchString.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/TestAsioHelpers.dir/TestAsioHelpers.cpp.o"
+  "CMakeFiles/TestAsioHelpers.dir/TestAsioHelpers.cpp.o.d"
+  "TestAsioHelpers"
+  "TestAsioHelpers.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/TestAsioHelpers.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
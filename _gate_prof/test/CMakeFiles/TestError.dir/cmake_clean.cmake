@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/TestError.dir/TestError.cpp.o"
+  "CMakeFiles/TestError.dir/TestError.cpp.o.d"
+  "TestError"
+  "TestError.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/TestError.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/TestIdTagged.dir/TestIdTagged.cpp.o"
+  "CMakeFiles/TestIdTagged.dir/TestIdTagged.cpp.o.d"
+  "TestIdTagged"
+  "TestIdTagged.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/TestIdTagged.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/TestIncarnated.dir/TestIncarnated.cpp.o"
+  "CMakeFiles/TestIncarnated.dir/TestIncarnated.cpp.o.d"
+  "TestIncarnated"
+  "TestIncarnated.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/TestIncarnated.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
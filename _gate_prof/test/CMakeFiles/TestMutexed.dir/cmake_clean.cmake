@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/TestMutexed.dir/TestMutexed.cpp.o"
+  "CMakeFiles/TestMutexed.dir/TestMutexed.cpp.o.d"
+  "TestMutexed"
+  "TestMutexed.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/TestMutexed.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/TestObjectPool.dir/TestObjectPool.cpp.o"
+  "CMakeFiles/TestObjectPool.dir/TestObjectPool.cpp.o.d"
+  "TestObjectPool"
+  "TestObjectPool.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/TestObjectPool.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/TestPimpled.dir/TestPimpled.cpp.o"
+  "CMakeFiles/TestPimpled.dir/TestPimpled.cpp.o.d"
+  "TestPimpled"
+  "TestPimpled.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/TestPimpled.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/TestRandom.dir/TestRandom.cpp.o"
+  "CMakeFiles/TestRandom.dir/TestRandom.cpp.o.d"
+  "TestRandom"
+  "TestRandom.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/TestRandom.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/TestRefCounted.dir/TestRefCounted.cpp.o"
+  "CMakeFiles/TestRefCounted.dir/TestRefCounted.cpp.o.d"
+  "TestRefCounted"
+  "TestRefCounted.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/TestRefCounted.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/TestReplication.dir/TestReplication.cpp.o"
+  "CMakeFiles/TestReplication.dir/TestReplication.cpp.o.d"
+  "TestReplication"
+  "TestReplication.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/TestReplication.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
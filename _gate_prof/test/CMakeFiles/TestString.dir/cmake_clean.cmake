@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/TestString.dir/TestString.cpp.o"
+  "CMakeFiles/TestString.dir/TestString.cpp.o.d"
+  "TestString"
+  "TestString.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/TestString.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/TestThreadId.dir/TestThreadId.cpp.o"
+  "CMakeFiles/TestThreadId.dir/TestThreadId.cpp.o.d"
+  "TestThreadId"
+  "TestThreadId.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/TestThreadId.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
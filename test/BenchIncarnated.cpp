@@ -0,0 +1,110 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// Contention benchmark for Incarnated counters.
+// Many threads modify children of one parent, which is what makes the parent's
+// counter cache line bounce between cores.
+
+#include "../Carne.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace moose::tools;
+
+namespace {
+
+	const unsigned int modifications_per_thread = 1000000;
+	const unsigned int propagation_batch = 64;
+
+	class AtomicParent : public Incarnated< AtomicParent > {
+
+		public:
+			AtomicParent() = default;
+	};
+
+	class StripedParent : public Incarnated< StripedParent, IncarnatedUnusedParent, striped_incarnation_counter<> > {
+
+		public:
+			StripedParent() = default;
+	};
+
+	//! every child on its own cache line so only the parent is shared
+	template< typename Parent >
+	class alignas(64) Child : public Incarnated< Child<Parent>, Parent > {
+
+		public:
+			explicit Child(Parent *n_parent)
+					: Incarnated< Child<Parent>, Parent >(n_parent) {
+			}
+	};
+
+	//! run n_threads writers on their own children of one parent
+	template< typename Parent >
+	double run(const unsigned int n_threads, const bool n_deferred) {
+
+		Parent parent;
+		std::vector<std::unique_ptr<Child<Parent> > > children;
+		for (unsigned int i = 0; i < n_threads; ++i) {
+			children.emplace_back(new Child<Parent>(&parent));
+		}
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0; i < n_threads; ++i) {
+			Child<Parent> *child = children[i].get();
+			threads.emplace_back([child, n_deferred]() {
+				for (unsigned int m = 0; m < modifications_per_thread; ++m) {
+					if (n_deferred) {
+						child->increase_incarnation_deferred();
+						if ((m % propagation_batch) == 0) {
+							child->propagate_incarnation();
+						}
+					} else {
+						child->increase_incarnation();
+					}
+				}
+				child->propagate_incarnation();
+			});
+		}
+
+		for (std::thread &t : threads) {
+			t.join();
+		}
+
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		if (!n_deferred && (parent.incarnation() != static_cast<boost::uint64_t>(n_threads) * modifications_per_thread)) {
+			std::cerr << "lost increments" << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+
+		return (static_cast<double>(n_threads) * modifications_per_thread) / elapsed.count() / 1e6;
+	}
+}
+
+int main(int, char **) {
+
+	std::cout << std::setw(8) << "threads"
+		<< std::setw(16) << "atomic"
+		<< std::setw(16) << "striped"
+		<< std::setw(16) << "striped+batch"
+		<< "   (million modifications/s)" << std::endl;
+
+	for (const unsigned int threads : { 1u, 8u, 64u }) {
+		std::cout << std::setw(8) << threads << std::fixed << std::setprecision(1)
+			<< std::setw(16) << run<AtomicParent>(threads, false)
+			<< std::setw(16) << run<StripedParent>(threads, false)
+			<< std::setw(16) << run<StripedParent>(threads, true)
+			<< std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,206 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// Throughput of Mutexed with a read mostly workload.
+// 95% of operations take a read lock, 5% a write lock.
+// Then Lockables with critical sections of a few nanoseconds
+// and flat combining of those.
+
+#include "../Mutexed.hpp"
+#include "../Random.hpp"
+#include "../Lockables.hpp"
+
+#include <boost/thread/mutex.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace moose::tools;
+
+namespace {
+
+	const unsigned int operations_per_thread = 200000;
+	const unsigned int write_percentage = 5;
+
+	//! some state worth protecting, reading it should take a little while
+	template< typename Lockable >
+	class Table : public Mutexed< Table<Lockable>, Lockable > {
+
+		public:
+			Table()
+					: m_values(64) {
+			}
+
+			boost::uint64_t sum(const bool n_optimistic) const {
+
+				if (n_optimistic) {
+					return this->optimistic_read([this]() {
+						return unlocked_sum();
+					});
+				}
+
+				typename Mutexed< Table<Lockable>, Lockable >::scoped_lock slock = this->acquire_read_lock();
+				return unlocked_sum();
+			}
+
+			void add(const std::size_t n_index) {
+
+				typename Mutexed< Table<Lockable>, Lockable >::scoped_lock slock = this->acquire_write_lock();
+				std::atomic<boost::uint64_t> &value = m_values[n_index % m_values.size()];
+				value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+
+		private:
+			//! atomics only so optimistic reads are not a data race
+			boost::uint64_t unlocked_sum() const {
+
+				boost::uint64_t ret = 0;
+				for (const std::atomic<boost::uint64_t> &v : m_values) {
+					ret += v.load(std::memory_order_relaxed);
+				}
+				return ret;
+			}
+
+			std::vector<std::atomic<boost::uint64_t> > m_values;
+	};
+
+	template< typename Lockable >
+	double run(const unsigned int n_threads, const bool n_optimistic) {
+
+		Table<Lockable> table;
+		std::atomic<boost::uint64_t> sink{ 0 };
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0; i < n_threads; ++i) {
+			threads.emplace_back([&table, &sink, n_optimistic]() {
+				boost::uint64_t local = 0;
+				for (unsigned int o = 0; o < operations_per_thread; ++o) {
+					if (fast_urand(100) < write_percentage) {
+						table.add(o);
+					} else {
+						local += table.sum(n_optimistic);
+					}
+				}
+				sink += local;
+			});
+		}
+
+		for (std::thread &t : threads) {
+			t.join();
+		}
+
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		return (static_cast<double>(n_threads) * operations_per_thread) / elapsed.count() / 1e6;
+	}
+
+	//! a critical section of just an increment
+	template< typename Lockable >
+	class Counter : public Mutexed< Counter<Lockable>, Lockable > {
+
+		public:
+			void increase() {
+
+				typename Mutexed< Counter<Lockable>, Lockable >::scoped_lock slock = this->acquire_write_lock();
+				++m_count;
+			}
+
+			void increase_combined() {
+
+				this->combine([this]() {
+					++m_count;
+				});
+			}
+
+		private:
+			boost::uint64_t m_count = 0;
+	};
+
+	template< typename Lockable >
+	double run_short(const unsigned int n_threads, const bool n_combined) {
+
+		Counter<Lockable> counter;
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0; i < n_threads; ++i) {
+			threads.emplace_back([&counter, n_combined]() {
+				for (unsigned int o = 0; o < operations_per_thread; ++o) {
+					if (n_combined) {
+						counter.increase_combined();
+					} else {
+						counter.increase();
+					}
+				}
+			});
+		}
+
+		for (std::thread &t : threads) {
+			t.join();
+		}
+
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		return (static_cast<double>(n_threads) * operations_per_thread) / elapsed.count() / 1e6;
+	}
+
+	//! Pure spin locks are pointless with more threads than cores, those are skipped
+	template< typename Lockable >
+	void short_row(const std::string &n_name, const bool n_spinning = false, const bool n_combined = false) {
+
+		std::cout << std::setw(22) << n_name << std::fixed << std::setprecision(2);
+		for (const unsigned int threads : { 1u, 2u, 4u, 8u, 16u }) {
+			if (n_spinning && (threads > 1) && (threads > std::thread::hardware_concurrency())) {
+				std::cout << std::setw(10) << "-";
+			} else {
+				std::cout << std::setw(10) << run_short<Lockable>(threads, n_combined);
+			}
+		}
+		std::cout << std::endl;
+	}
+
+	template< typename Lockable >
+	void row(const std::string &n_name, const bool n_optimistic = false) {
+
+		std::cout << std::setw(22) << n_name << std::fixed << std::setprecision(2);
+		for (const unsigned int threads : { 1u, 2u, 4u, 8u, 16u }) {
+			std::cout << std::setw(10) << run<Lockable>(threads, n_optimistic);
+		}
+		std::cout << std::endl;
+	}
+}
+
+int main(int, char **) {
+
+	std::cout << std::setw(22) << "lockable / threads";
+	for (const unsigned int threads : { 1u, 2u, 4u, 8u, 16u }) {
+		std::cout << std::setw(10) << threads;
+	}
+	std::cout << "   (million operations/s, " << write_percentage << "% writes)" << std::endl;
+
+	row<boost::mutex>("boost::mutex");
+	row<boost::shared_mutex>("boost::shared_mutex");
+	row<boost::upgrade_mutex>("boost::upgrade_mutex");
+	row<boost::upgrade_mutex>("optimistic_read", true);
+
+	std::cout << std::endl << std::setw(22) << "lockable / threads";
+	for (const unsigned int threads : { 1u, 2u, 4u, 8u, 16u }) {
+		std::cout << std::setw(10) << threads;
+	}
+	std::cout << "   (million operations/s, increment only)" << std::endl;
+
+	short_row<boost::mutex>("boost::mutex");
+	short_row<adaptive_mutex>("adaptive_mutex");
+	short_row<ticket_mutex>("ticket_mutex", true);
+	short_row<cohort_mutex<> >("cohort_mutex", true);
+	short_row<boost::mutex>("combine", false, true);
+
+	return EXIT_SUCCESS;
+}
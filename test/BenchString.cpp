@@ -0,0 +1,157 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// Endpoint parsing benchmark.
+// Compares the hand written parse_google_ep() with the Spirit grammar
+// from_google_ep() used before. The grammar is copied here as it's gone from the library.
+
+#include "../String.hpp"
+
+#include <boost/spirit/include/qi.hpp>
+#include <boost/spirit/include/phoenix.hpp>
+#include <boost/fusion/include/vector.hpp>
+#include <boost/asio/ip/address.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace moose::tools;
+
+namespace {
+
+	namespace qi = boost::spirit::qi;
+	namespace ip = boost::asio::ip;
+
+	const unsigned int rounds = 20;
+
+	struct ip4_from_str_impl {
+
+		typedef ip::address_v4  result_type;
+
+		template <typename Arg>
+		result_type operator()(const Arg n_str) const {
+
+			return ip::make_address_v4(n_str);
+		}
+	};
+
+	struct ip6_from_str_impl {
+
+		typedef ip::address_v6  result_type;
+
+		template <typename Arg>
+		result_type operator()(const Arg n_str) const {
+
+			return ip::make_address_v6(n_str);
+		}
+	};
+
+	typedef boost::fusion::vector<ip::address, unsigned int>  ip_tuple;
+
+	template <typename Iterator>
+	struct google_ip_parser : qi::grammar<Iterator, ip_tuple()> {
+
+		google_ip_parser() : google_ip_parser::base_type(m_start, "google_ip") {
+
+			using qi::_1;
+			using qi::_val;
+
+			m_ipv4_string  %= "ipv4:" >> +qi::char_("0-9\\.");
+			m_ipv6_string  %= "ipv6:[" >> +qi::char_(":A-Fa-f0-9\\.") >> "]";
+			m_ipv4_address = m_ipv4_string[_val = v4_from_str(_1)];
+			m_ipv6_address = m_ipv6_string[_val = v6_from_str(_1)];
+			m_start        %= (m_ipv4_address | m_ipv6_address) >> ":" >> qi::uint_;
+		}
+
+		boost::phoenix::function<ip4_from_str_impl>    v4_from_str;
+		boost::phoenix::function<ip6_from_str_impl>    v6_from_str;
+
+		qi::rule<Iterator, std::string()>        m_ipv4_string;
+		qi::rule<Iterator, ip::address_v4()>     m_ipv4_address;
+		qi::rule<Iterator, std::string()>        m_ipv6_string;
+		qi::rule<Iterator, ip::address_v6()>     m_ipv6_address;
+		qi::rule<Iterator, ip_tuple()>           m_start;
+	};
+
+	//! what from_google_ep() did, minus the exception
+	bool spirit_google_ep(const std::string &n_google_ep, ip::address &n_address, unsigned short int &n_port) {
+
+		google_ip_parser<std::string::const_iterator> p;
+		ip_tuple                                      result;
+		std::string::const_iterator                   begin = n_google_ep.begin();
+		const std::string::const_iterator             end = n_google_ep.end();
+
+		try {
+			if (qi::parse(begin, end, p, result) && (begin == end)) {
+				n_address = boost::fusion::at_c<0>(result);
+				n_port = static_cast<unsigned short int>(boost::fusion::at_c<1>(result));
+				return true;
+			}
+		} catch (const std::exception &) {  // asio throws on invalid parse
+		}
+		return false;
+	}
+
+	std::vector<std::string> make_peers() {
+
+		std::vector<std::string> peers;
+		for (unsigned int i = 0; i < 1000; ++i) {
+			if (i % 3) {
+				peers.push_back("ipv4:192.168." + std::to_string(i % 256) + "." + std::to_string((i * 7) % 256) + ":" + std::to_string(1024 + i));
+			} else {
+				peers.push_back("ipv6:[2a02:810d:e40:67c:adb3:f561:144f:" + std::to_string(i) + "]:" + std::to_string(1024 + i));
+			}
+		}
+		return peers;
+	}
+
+	//! @return million endpoints per second
+	template <typename Parser>
+	double run(const std::vector<std::string> &n_peers, Parser &&n_parser) {
+
+		unsigned long long checksum = 0;
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for (unsigned int r = 0; r < rounds; ++r) {
+			for (const std::string &peer : n_peers) {
+				ip::address address;
+				unsigned short int port = 0;
+				if (!n_parser(peer, address, port)) {
+					std::cerr << "cannot parse " << peer << std::endl;
+					std::exit(EXIT_FAILURE);
+				}
+				checksum += port;
+			}
+		}
+
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		if (checksum == 0) {
+			std::exit(EXIT_FAILURE);
+		}
+
+		return (static_cast<double>(rounds) * n_peers.size()) / elapsed.count() / 1e6;
+	}
+}
+
+int main(int, char **) {
+
+	const std::vector<std::string> peers = make_peers();
+
+	std::cout << std::setw(16) << "spirit"
+		<< std::setw(16) << "hand written"
+		<< "   (million endpoints/s)" << std::endl;
+
+	std::cout << std::fixed << std::setprecision(2)
+		<< std::setw(16) << run(peers, spirit_google_ep)
+		<< std::setw(16) << run(peers, [](const std::string &n_peer, ip::address &n_address, unsigned short int &n_port) {
+				return parse_google_ep(n_peer, n_address, n_port) == endpoint_parse_error::none;
+			})
+		<< std::endl;
+
+	return EXIT_SUCCESS;
+}
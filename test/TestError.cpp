@@ -0,0 +1,393 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MODULE ErrorTests
+#include <boost/test/unit_test.hpp>
+
+#include "../Error.hpp"
+#include "../Expected.hpp"
+
+#include <boost/asio/ip/udp.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <string>
+
+using namespace moose::tools;
+
+namespace {
+
+	expected<int> half(const int n_value) {
+
+		if (n_value % 2) {
+			return compact_error(error_kind::protocol, "odd number", n_value);
+		}
+		return n_value / 2;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(compact_errors) {
+
+	BOOST_CHECK_EQUAL(sizeof(compact_error), 64);
+
+	const compact_error none;
+	BOOST_CHECK(!none);
+	BOOST_CHECK(none.kind() == error_kind::none);
+	BOOST_CHECK(none.message().empty());
+
+	const compact_error e(error_kind::file, "cannot open", 2);
+	BOOST_CHECK(e);
+	BOOST_CHECK(e.kind() == error_kind::file);
+	BOOST_CHECK_EQUAL(e.code(), 2);
+	BOOST_CHECK_EQUAL(e.message(), "cannot open");
+
+	// long messages are cut
+	const std::string long_message(100, 'x');
+	BOOST_CHECK_EQUAL(compact_error(error_kind::io, long_message).message(), long_message.substr(0, compact_error::max_message));
+
+	BOOST_CHECK_EQUAL(std::string(error_kind_name(error_kind::network)), network_error().what());
+}
+
+BOOST_AUTO_TEST_CASE(expected_values) {
+
+	const expected<int> good = half(42);
+	BOOST_REQUIRE(good);
+	BOOST_CHECK_EQUAL(*good, 21);
+	BOOST_CHECK_EQUAL(good.value(), 21);
+	BOOST_CHECK(!good.error());
+
+	const expected<int> bad = half(3);
+	BOOST_REQUIRE(!bad);
+	BOOST_CHECK(bad.error().kind() == error_kind::protocol);
+	BOOST_CHECK_EQUAL(bad.error().message(), "odd number");
+	BOOST_CHECK_EQUAL(bad.value_or(-1), -1);
+
+	// value() of an error throws the matching exception
+	try {
+		bad.value();
+		BOOST_FAIL("value() didn't throw");
+	} catch (const protocol_error &pex) {
+		BOOST_REQUIRE(boost::get_error_info<error_message>(pex));
+		BOOST_CHECK_EQUAL(*boost::get_error_info<error_message>(pex), "odd number");
+		BOOST_REQUIRE(boost::get_error_info<compact_error_code>(pex));
+		BOOST_CHECK_EQUAL(*boost::get_error_info<compact_error_code>(pex), 3);
+	}
+
+	const expected<std::string> text(std::string("moose"));
+	BOOST_CHECK_EQUAL(text->size(), 5);
+
+	const expected<void> fine;
+	BOOST_CHECK(fine);
+	BOOST_CHECK_NO_THROW(fine.value());
+
+	const expected<void> failed = compact_error(error_kind::file, "gone");
+	BOOST_CHECK(!failed);
+	BOOST_CHECK_THROW(failed.value(), file_error);
+}
+
+BOOST_AUTO_TEST_CASE(throw_error_mapping) {
+
+	BOOST_CHECK_THROW(throw_error(compact_error(error_kind::generic, "")), moose_error);
+	BOOST_CHECK_THROW(throw_error(compact_error(error_kind::unit_test, "")), unit_test_error);
+	BOOST_CHECK_THROW(throw_error(compact_error(error_kind::internal, "")), internal_error);
+	BOOST_CHECK_THROW(throw_error(compact_error(error_kind::ui, "")), ui_error);
+	BOOST_CHECK_THROW(throw_error(compact_error(error_kind::io, "")), io_error);
+	BOOST_CHECK_THROW(throw_error(compact_error(error_kind::serialization, "")), serialization_error);
+	BOOST_CHECK_THROW(throw_error(compact_error(error_kind::network, "")), network_error);
+	BOOST_CHECK_THROW(throw_error(compact_error()), internal_error);
+
+	// the code isn't passed off as errno
+	try {
+		throw_error(compact_error(error_kind::network, "Cannot parse IP", 2));
+	} catch (const network_error &nex) {
+		BOOST_CHECK(!boost::get_error_info<errno_code>(nex));
+		BOOST_REQUIRE(boost::get_error_info<compact_error_code>(nex));
+		BOOST_CHECK_EQUAL(*boost::get_error_info<compact_error_code>(nex), 2);
+	}
+}
+
+#if !defined(MOOSE_DEBUG)
+BOOST_AUTO_TEST_CASE(backtrace_sampling) {
+
+	const auto count_backtraces = [](const unsigned int n_throws) {
+		unsigned int ret = 0;
+		for (unsigned int i = 0; i < n_throws; ++i) {
+			try {
+				BOOST_THROW_EXCEPTION(network_error() << error_message("sampled"));
+			} catch (const network_error &nex) {
+				if (const raw_backtrace *bt = boost::get_error_info<error_backtrace>(nex)) {
+					BOOST_CHECK_GT(bt->m_size, 0);
+					++ret;
+				}
+			}
+		}
+		return ret;
+	};
+
+	BOOST_CHECK_EQUAL(count_backtraces(10), 0);
+
+	set_error_backtrace_sampling(1);
+	BOOST_CHECK_EQUAL(count_backtraces(10), 10);
+
+	set_error_backtrace_sampling(5);
+	BOOST_CHECK_EQUAL(count_backtraces(20), 4);
+
+	// symbols are resolved when printed
+	set_error_backtrace_sampling(1);
+	try {
+		BOOST_THROW_EXCEPTION(file_error() << error_message("printed"));
+	} catch (const file_error &fex) {
+		const raw_backtrace *bt = boost::get_error_info<error_backtrace>(fex);
+		BOOST_REQUIRE(bt);
+		BOOST_CHECK_EQUAL(bt->resolve().size(), bt->m_size);
+		BOOST_CHECK(boost::diagnostic_information(fex).find("tag_error_backtrace") != std::string::npos);
+	}
+
+	// plain moose_error and subclasses that don't pass a kind are sampled as well
+	try {
+		BOOST_THROW_EXCEPTION(moose_error() << error_message("plain"));
+	} catch (const moose_error &mex) {
+		BOOST_CHECK(boost::get_error_info<error_backtrace>(mex));
+	}
+
+	set_error_backtrace_sampling(0);
+	BOOST_CHECK_EQUAL(count_backtraces(10), 0);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(last_errors) {
+
+	BOOST_CHECK(last_error().empty());
+	BOOST_CHECK(get_last_error().empty());
+	BOOST_CHECK(recent_errors().empty());
+
+	set_last_error("first");
+	BOOST_CHECK_EQUAL(last_error(), "first");
+	set_last_error(std::string("second"));
+	BOOST_CHECK_EQUAL(get_last_error(), "second");
+
+	std::vector<recent_error> recent = recent_errors();
+	BOOST_REQUIRE_EQUAL(recent.size(), 2);
+	BOOST_CHECK_EQUAL(recent[0].message, "second");
+	BOOST_CHECK_EQUAL(recent[1].message, "first");
+	BOOST_CHECK(recent[0].when >= recent[1].when);
+
+	// the ring keeps only the last ones
+	for (std::size_t i = 0; i < last_error_history + 3; ++i) {
+		set_last_error(std::to_string(i));
+	}
+	recent = recent_errors();
+	BOOST_REQUIRE_EQUAL(recent.size(), last_error_history);
+	BOOST_CHECK_EQUAL(recent.front().message, std::to_string(last_error_history + 2));
+	BOOST_CHECK_EQUAL(recent.back().message, "3");
+
+	// too long ones are cut
+	set_last_error(std::string(last_error_capacity + 10, 'x'));
+	BOOST_CHECK_EQUAL(last_error().size(), last_error_capacity);
+
+	// every thread has its own
+	boost::thread other([]() {
+		BOOST_CHECK(last_error().empty());
+		set_last_error("other");
+	});
+	other.join();
+	BOOST_CHECK_EQUAL(last_error().size(), last_error_capacity);
+}
+
+namespace {
+
+	//! defined outside the library, so it can't pass a kind
+	struct foreign_error : virtual moose_error {};
+
+	//! the same header as seen by two translation units
+	const char header_in_one_unit[] = "Header.hpp";
+	const char header_in_another_unit[] = "Header.hpp";
+}
+
+BOOST_AUTO_TEST_CASE(error_counters) {
+
+	reset_error_stats();
+	const error_statistics before = error_stats();
+	BOOST_CHECK_EQUAL(before.total(), 0);
+
+	const unsigned int network_line = __LINE__ + 3;
+	for (int i = 0; i < 3; ++i) {
+		try {
+			BOOST_THROW_EXCEPTION(network_error() << error_message("counted"));
+		} catch (const moose_error &mex) {
+			BOOST_CHECK(mex.kind() == error_kind::network);
+		}
+	}
+
+	// subclasses of subclasses count as themselves only
+	BOOST_CHECK_THROW(BOOST_THROW_EXCEPTION(ui_error()), internal_error);
+
+	// other threads count too
+	boost::thread other([]() {
+		BOOST_CHECK_THROW(BOOST_THROW_EXCEPTION(protocol_error()), protocol_error);
+	});
+	other.join();
+
+	// without a kind it's generic, also when it comes from compact_error
+	BOOST_CHECK_THROW(BOOST_THROW_EXCEPTION(moose_error()), moose_error);
+	BOOST_CHECK_THROW(BOOST_THROW_EXCEPTION(foreign_error()), foreign_error);
+	BOOST_CHECK_THROW(throw_error(compact_error(error_kind::generic, "")), moose_error);
+
+	const error_statistics after = error_stats();
+	BOOST_CHECK_EQUAL(after.count(error_kind::network), 3);
+	BOOST_CHECK_EQUAL(after.count(error_kind::ui), 1);
+	BOOST_CHECK_EQUAL(after.count(error_kind::internal), 0);
+	BOOST_CHECK_EQUAL(after.count(error_kind::io), 0);
+	BOOST_CHECK_EQUAL(after.count(error_kind::protocol), 1);
+	BOOST_CHECK_EQUAL(after.count(error_kind::generic), 3);
+	BOOST_CHECK_EQUAL(after.total(), 8);
+	BOOST_CHECK_GT(error_rate(before, after, error_kind::network), 0.0);
+
+	BOOST_REQUIRE_EQUAL(after.sites.size(), 6);
+	BOOST_CHECK(after.sites.front().kind == error_kind::network);
+	BOOST_CHECK_EQUAL(after.sites.front().count, 3);
+	BOOST_CHECK_EQUAL(after.sites.front().line, network_line);
+	BOOST_CHECK(after.sites.front().file.find("TestError.cpp") != std::string::npos);
+
+	reset_error_stats();
+	BOOST_CHECK_EQUAL(error_stats().total(), 0);
+	BOOST_CHECK(error_stats().sites.empty());
+}
+
+BOOST_AUTO_TEST_CASE(error_counters_thrown_once) {
+
+	// BOOST_THROW_EXCEPTION's wrapper must not count the error again
+	reset_error_stats();
+	const unsigned int network_line = __LINE__ + 2;
+	try {
+		BOOST_THROW_EXCEPTION(network_error());
+	} catch (const network_error &) {
+	}
+
+	const error_statistics stats = error_stats();
+	BOOST_CHECK_EQUAL(stats.count(error_kind::network), 1);
+	BOOST_CHECK_EQUAL(stats.count(error_kind::generic), 0);
+	BOOST_CHECK_EQUAL(stats.total(), 1);
+	BOOST_REQUIRE_EQUAL(stats.sites.size(), 1);
+	BOOST_CHECK_EQUAL(stats.sites.front().line, network_line);
+	BOOST_CHECK(stats.sites.front().file.find("TestError.cpp") != std::string::npos);
+
+	reset_error_stats();
+}
+
+BOOST_AUTO_TEST_CASE(error_counters_at_caller) {
+
+	// expected and throw_error count where they are called, not in the library
+	reset_error_stats();
+	const unsigned int value_line = __LINE__ + 1;
+	BOOST_CHECK_THROW(half(3).value(), protocol_error);
+	const unsigned int throw_line = __LINE__ + 1;
+	BOOST_CHECK_THROW(throw_error(compact_error(error_kind::io, "")), io_error);
+
+	error_statistics stats = error_stats();
+	BOOST_REQUIRE_EQUAL(stats.sites.size(), 2);
+	for (const error_site_count &site : stats.sites) {
+		BOOST_CHECK(site.file.find("TestError.cpp") != std::string::npos);
+		BOOST_CHECK_EQUAL(site.line, (site.kind == error_kind::protocol) ? value_line : throw_line);
+	}
+
+	// one site, even if every unit has its own pointer to the file name
+	reset_error_stats();
+	BOOST_CHECK(header_in_one_unit != header_in_another_unit);
+	moose_error first(header_in_one_unit, 42);
+	moose_error second(header_in_another_unit, 42);
+	moose_error third(header_in_another_unit, 43);
+
+	stats = error_stats();
+	BOOST_REQUIRE_EQUAL(stats.sites.size(), 2);
+	BOOST_CHECK_EQUAL(stats.sites.front().file, "Header.hpp");
+	BOOST_CHECK_EQUAL(stats.sites.front().line, 42);
+	BOOST_CHECK_EQUAL(stats.sites.front().count, 2);
+	BOOST_CHECK_EQUAL(stats.sites.back().line, 43);
+	BOOST_CHECK_EQUAL(stats.sites.back().count, 1);
+
+	reset_error_stats();
+}
+
+BOOST_AUTO_TEST_CASE(error_counters_of_ended_threads) {
+
+	// threads hand their counts over when they end
+	reset_error_stats();
+	for (int i = 0; i < 4; ++i) {
+		boost::thread t([]() {
+			BOOST_CHECK_THROW(BOOST_THROW_EXCEPTION(io_error()), io_error);
+		});
+		t.join();
+	}
+
+	const error_statistics stats = error_stats();
+	BOOST_CHECK_EQUAL(stats.count(error_kind::io), 4);
+	BOOST_REQUIRE_EQUAL(stats.sites.size(), 1);
+	BOOST_CHECK_EQUAL(stats.sites.front().count, 4);
+
+	reset_error_stats();
+	BOOST_CHECK_EQUAL(error_stats().total(), 0);
+	BOOST_CHECK(error_stats().sites.empty());
+}
+
+namespace {
+
+	enum class color : int {
+		red = 1,
+		green = -2
+	};
+
+	enum class grade : char {
+		good = 'A'
+	};
+
+	enum class toggle : bool {
+		on = true
+	};
+
+	std::string argument_of(const moose_error &n_error) {
+
+		const std::string *ret = boost::get_error_info<error_argument_type>(n_error);
+		return ret ? *ret : std::string("<none>");
+	}
+
+	template< typename T >
+	std::string format(const T &n_value) {
+
+		try {
+			BOOST_THROW_EXCEPTION(internal_error() << error_argument(n_value));
+		} catch (const moose_error &mex) {
+			return argument_of(mex);
+		}
+		return std::string();
+	}
+}
+
+BOOST_AUTO_TEST_CASE(typed_arguments) {
+
+	BOOST_CHECK_EQUAL(format(42), "42");
+	BOOST_CHECK_EQUAL(format(-42), "-42");
+	BOOST_CHECK_EQUAL(format(std::size_t(18446744073709551615ull)), "18446744073709551615");
+	BOOST_CHECK_EQUAL(format(boost::int64_t(-9223372036854775807ll - 1)), "-9223372036854775808");
+	BOOST_CHECK_EQUAL(format(static_cast<unsigned char>(7)), "7");
+	BOOST_CHECK_EQUAL(format('x'), "x");
+	BOOST_CHECK_EQUAL(format(true), "true");
+	BOOST_CHECK_EQUAL(format(color::green), "-2");
+	BOOST_CHECK_EQUAL(format(grade::good), "65");
+	BOOST_CHECK_EQUAL(format(toggle::on), "1");
+	BOOST_CHECK_EQUAL(format(1.5), "1.500000000000000e+00");
+	BOOST_CHECK_EQUAL(format(-0.25f), "-2.500000000000000e-01");
+
+	BOOST_CHECK_EQUAL(format("text"), "text");
+	BOOST_CHECK_EQUAL(format(std::string("string")), "string");
+	BOOST_CHECK_EQUAL(format(std::string_view("view")), "view");
+
+	// streamable types
+	const boost::asio::ip::udp::endpoint ep(boost::asio::ip::make_address("::1"), 42);
+	BOOST_CHECK_EQUAL(format(ep), "[::1]:42");
+
+	// the old way still works
+	BOOST_CHECK_EQUAL(format(boost::any(42u)), "42");
+	BOOST_CHECK_EQUAL(format(boost::any(2.0)), "2.000000000000000e+00");
+	BOOST_CHECK_EQUAL(format(boost::any(std::vector<int>())), "<cannot determine argument type>");
+}
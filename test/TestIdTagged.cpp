@@ -7,9 +7,18 @@
 #include <boost/test/unit_test.hpp>
 
 #include "../IdTaggedContainer.hpp"
+#include "../IdTaggedSnapshot.hpp"
 #include "../IdTagged.hpp"
 #include "../Error.hpp"
 
+#include <boost/filesystem/operations.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <set>
+#include <thread>
+
 #if defined(BOOST_MSVC)
 #pragma warning (disable : 4553) // faulty '==': operator has no effect; did you intend '='?  in checks
 #endif
@@ -169,3 +178,399 @@ BOOST_AUTO_TEST_CASE(range_based_for) {
 	BOOST_CHECK(cnt == 3);
 }
 
+
+BOOST_AUTO_TEST_CASE(memory_usage) {
+
+	BOOST_TEST_MESSAGE("estimating memory usage of id tagged container");
+
+	MyIdTaggedContainer c;
+	IdTaggedContainerMemoryUsage empty = c.memory_usage();
+	BOOST_CHECK(empty.elements == 0);
+	BOOST_CHECK(empty.object_bytes == 0);
+	BOOST_CHECK(empty.tree_depth == 0);
+
+	for (int i = 0; i < 100; ++i) {
+		BOOST_REQUIRE(c.insert(std::make_shared<IdTaggedClass>()));
+	}
+
+	IdTaggedContainerMemoryUsage full = c.memory_usage();
+	BOOST_CHECK(full.elements == 100);
+	BOOST_CHECK(full.object_bytes == 100 * sizeof(IdTaggedClass));
+	BOOST_CHECK(full.node_bytes > empty.node_bytes);
+	BOOST_CHECK(full.total() > empty.total());
+	BOOST_CHECK(full.load_factor > 0.0 && full.load_factor <= 1.0);
+	BOOST_CHECK(full.tree_depth >= 7);   // log2(100)
+
+	IdTaggedContainerMemoryUsage deep = c.memory_usage([](const IdTaggedClass &) { return std::size_t(1000); });
+	BOOST_CHECK(deep.object_bytes == 100 * 1000);
+}
+
+BOOST_AUTO_TEST_CASE(statistics) {
+
+	BOOST_TEST_MESSAGE("counting operations on id tagged container");
+
+	MyIdTaggedContainer c;
+	MyIdTaggedContainer::pointer_type o1(new IdTaggedClass());
+	MyIdTaggedContainer::pointer_type o2(new IdTaggedClass());
+
+	BOOST_CHECK(c.insert(o1));
+	BOOST_CHECK(c.insert(o2));
+	BOOST_CHECK(!c.insert(o2));
+	BOOST_CHECK(c.has(o1->id()));
+	BOOST_CHECK(c.get(o2->id()));
+	BOOST_CHECK(c.remove(o1->id()));
+	BOOST_CHECK(!c.has(o1->id()));
+	c.clear();
+
+	const IdTaggedContainerStatistics stats = c.statistics();
+#if defined(MOOSE_TOOLS_CONTAINER_STATS)
+	BOOST_CHECK(stats.lookups == 3);
+	BOOST_CHECK(stats.misses == 1);
+	BOOST_CHECK(stats.inserts == 2);
+	BOOST_CHECK(stats.erases == 2);
+	BOOST_CHECK(stats.incarnation_bumps == 4);
+	BOOST_CHECK(stats.incarnation_bumps == c.incarnation());
+#else
+	BOOST_CHECK(stats.lookups == 0);
+#endif
+
+	// counters move along with the content
+	IdTaggedContainer<IdTaggedClass> moved(std::move(c));
+	BOOST_CHECK(moved.statistics().lookups == stats.lookups);
+	BOOST_CHECK(moved.statistics().inserts == stats.inserts);
+	IdTaggedContainer<IdTaggedClass> assigned;
+	assigned = std::move(moved);
+	BOOST_CHECK(assigned.statistics().lookups == stats.lookups);
+	BOOST_CHECK(moved.statistics().lookups == 0);
+
+	assigned.reset_statistics();
+	BOOST_CHECK(assigned.statistics().lookups == 0);
+}
+
+//! a tagged class with content to serialize
+class PayloadClass : public IdTagged< PayloadClass > {
+
+	public:
+		PayloadClass(const id_type n_id, const std::string &n_payload)
+				: IdTagged< PayloadClass >(n_id)
+				, m_payload(n_payload) {
+		}
+
+		PayloadClass(const PayloadClass &n_other) = delete;
+		~PayloadClass() = default;
+
+		const std::string m_payload;
+};
+
+struct PayloadCodec {
+
+	void encode(const PayloadClass &n_object, std::string &n_buffer) const {
+
+		n_buffer.append(n_object.m_payload);
+	}
+
+	std::shared_ptr<PayloadClass> decode(const PayloadClass::id_type n_id, const char *n_data, const std::size_t n_size) const {
+
+		return std::make_shared<PayloadClass>(n_id, std::string(n_data, n_size));
+	}
+};
+
+BOOST_AUTO_TEST_CASE(snapshot_roundtrip) {
+
+	BOOST_TEST_MESSAGE("saving and mapping id tagged container snapshots");
+
+	namespace fs = boost::filesystem;
+	const fs::path path = fs::temp_directory_path() / fs::unique_path("moose_snapshot_%%%%%%%%.bin");
+
+	IdTaggedContainer<PayloadClass> c;
+	for (PayloadClass::id_type i = 1; i <= 1000; ++i) {
+		// insert in reverse to make sure the snapshot sorts them
+		const PayloadClass::id_type id = 5000 - i * 3;
+		BOOST_REQUIRE(c.insert(std::make_shared<PayloadClass>(id, std::string(i % 17, 'x') + std::to_string(id))));
+	}
+	BOOST_REQUIRE(c.insert(std::make_shared<PayloadClass>(7, std::string())));  // empty payloads are legal
+
+	BOOST_REQUIRE_NO_THROW(save_snapshot(c, path, PayloadCodec()));
+
+	{
+		IdTaggedSnapshot<PayloadClass> snapshot(path);
+		BOOST_CHECK(snapshot.size() == c.size());
+		BOOST_CHECK(snapshot.incarnation() == c.incarnation());
+		BOOST_CHECK(snapshot.id(0) == 7);
+		BOOST_CHECK(snapshot.has(5000 - 3));
+		BOOST_CHECK(!snapshot.has(5000 - 4));
+		BOOST_CHECK(!snapshot.get(5000 - 4, PayloadCodec()));
+
+		const std::shared_ptr<PayloadClass> o = snapshot.get(5000 - 30, PayloadCodec());
+		BOOST_REQUIRE(o);
+		BOOST_CHECK(o->m_payload == c.get(5000 - 30)->m_payload);
+
+		IdTaggedContainer<PayloadClass> loaded;
+		BOOST_CHECK(snapshot.load(loaded, PayloadCodec()) == c.size());
+		BOOST_CHECK(loaded == c);
+		BOOST_CHECK(loaded.get(7)->m_payload.empty());
+		BOOST_CHECK(loaded.incarnation() == 1);  // bulk insert increases only once
+	}
+
+	// garbage must be rejected
+	{
+		std::ofstream out(path.string(), std::ios::binary | std::ios::trunc);
+		out << "this is not a snapshot at all, no matter how long I write on";
+	}
+	BOOST_CHECK_THROW(IdTaggedSnapshot<PayloadClass> broken(path), serialization_error);
+
+	// a count chosen so that the section sizes wrap around to match a tiny file
+	{
+		IdTaggedSnapshotHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, "MOOSESNP", 8);
+		header.version        = 1;
+		header.byte_order     = 0x01020304;
+		header.id_size        = sizeof(PayloadClass::id_type);
+		header.count          = std::numeric_limits<boost::uint64_t>::max() / header.id_size + 1;
+		header.ids_offset     = (sizeof(header) + 7) & ~boost::uint64_t(7);
+		header.offsets_offset = (header.ids_offset + header.count * header.id_size + 7) & ~boost::uint64_t(7);
+		header.payload_offset = header.offsets_offset + (header.count + 1) * sizeof(boost::uint64_t);
+		header.payload_size   = 0;
+
+		std::ofstream out(path.string(), std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		out << std::string(static_cast<std::size_t>(header.payload_offset - sizeof(header)), '\0');
+	}
+	BOOST_CHECK_THROW(IdTaggedSnapshot<PayloadClass> wrapped(path), serialization_error);
+
+	fs::remove(path);
+	BOOST_CHECK_THROW(IdTaggedSnapshot<PayloadClass> missing(path), file_error);
+}
+
+BOOST_AUTO_TEST_CASE(negative_lookup_filter) {
+
+	BOOST_TEST_MESSAGE("using a negative lookup filter on id tagged container");
+
+	IdTaggedContainer<PayloadClass> c;
+	for (PayloadClass::id_type i = 1; i <= 1000; ++i) {
+		BOOST_REQUIRE(c.insert(std::make_shared<PayloadClass>(i * 2, std::string())));
+	}
+
+	c.enable_negative_lookup_filter();
+	BOOST_CHECK(c.negative_lookup_filter_enabled());
+	BOOST_CHECK(c.memory_usage().filter_bytes > 0);
+
+	// grow beyond initial size to make sure it keeps up
+	for (PayloadClass::id_type i = 1001; i <= 5000; ++i) {
+		BOOST_REQUIRE(c.insert(std::make_shared<PayloadClass>(i * 2, std::string())));
+	}
+
+	// no false negatives ever
+	for (PayloadClass::id_type i = 1; i <= 5000; ++i) {
+		BOOST_REQUIRE(c.has(i * 2));
+		BOOST_REQUIRE(c.get(i * 2));
+	}
+
+	c.reset_statistics();
+	for (PayloadClass::id_type i = 1; i <= 10000; ++i) {
+		BOOST_REQUIRE(!c.has(i * 2 + 1));
+	}
+
+#if defined(MOOSE_TOOLS_CONTAINER_STATS)
+	const IdTaggedContainerStatistics stats = c.statistics();
+	BOOST_CHECK(stats.misses == 10000);
+	BOOST_CHECK(stats.filter_rejections + stats.filter_false_positives == 10000);
+	// 10 bits per element make about 1%, growing must not make that worse
+	BOOST_CHECK_MESSAGE(stats.filter_false_positive_rate() < 0.02, "false positive rate " << stats.filter_false_positive_rate());
+#endif
+
+	// heavy removal makes it stale, a rebuild fixes that
+	for (PayloadClass::id_type i = 1; i <= 4000; ++i) {
+		BOOST_REQUIRE(c.remove(i * 2));
+	}
+	BOOST_CHECK(c.negative_lookup_filter_stale());
+	BOOST_CHECK(!c.has(2));
+	c.rebuild_negative_lookup_filter();
+	BOOST_CHECK(!c.negative_lookup_filter_stale());
+	BOOST_CHECK(c.has(8002));
+
+	c.clear();
+	BOOST_CHECK(!c.has(8002));
+	c.disable_negative_lookup_filter();
+	BOOST_CHECK(!c.negative_lookup_filter_enabled());
+}
+
+BOOST_AUTO_TEST_CASE(bounded_eviction) {
+
+	IdTaggedContainer<PayloadClass> c;
+	std::vector<PayloadClass::id_type> evicted;
+	c.set_eviction_handler([&](const std::shared_ptr<PayloadClass> &n_object) {
+		evicted.push_back(n_object->id());
+	});
+	c.set_capacity(3);
+
+	for (PayloadClass::id_type i = 1; i <= 3; ++i) {
+		BOOST_REQUIRE(c.insert(std::make_shared<PayloadClass>(i, "")));
+	}
+
+	// everything is fresh, so the hand sweeps once and takes the first
+	BOOST_REQUIRE(c.insert(std::make_shared<PayloadClass>(4, "")));
+	BOOST_CHECK(c.size() == 3);
+	BOOST_REQUIRE(evicted.size() == 1);
+	BOOST_CHECK(evicted[0] == 1);
+
+	// 2 is used, so 3 goes next
+	BOOST_REQUIRE(c.get(2));
+	BOOST_REQUIRE(c.insert(std::make_shared<PayloadClass>(5, "")));
+	BOOST_REQUIRE(evicted.size() == 2);
+	BOOST_CHECK(evicted[1] == 3);
+	BOOST_CHECK(c.has(2));
+	BOOST_CHECK(c.has(4));
+	BOOST_CHECK(c.has(5));
+
+	// replacing an existing one must not evict
+	BOOST_CHECK(c.replace(std::make_shared<PayloadClass>(4, "new")));
+	BOOST_CHECK(evicted.size() == 2);
+	BOOST_CHECK(c.size() == 3);
+
+#if defined(MOOSE_TOOLS_CONTAINER_STATS)
+	BOOST_CHECK(c.statistics().evictions == 2);
+#endif
+
+	// expired ones go first with ttl
+	c.set_expiry_extractor([](const PayloadClass &n_object) {
+		return (n_object.m_payload == "expired") ? std::chrono::steady_clock::time_point() : std::chrono::steady_clock::time_point::max();
+	});
+	c.set_capacity(3, eviction_policy::ttl);
+	BOOST_CHECK(c.replace(std::make_shared<PayloadClass>(5, "expired")));
+	BOOST_REQUIRE(c.get(2));
+	BOOST_REQUIRE(c.get(4));
+	BOOST_REQUIRE(c.insert(std::make_shared<PayloadClass>(6, "expired")));
+	BOOST_CHECK(!c.has(5));
+	BOOST_CHECK(c.evict_expired() == 1);
+	BOOST_CHECK(c.size() == 2);
+	BOOST_CHECK(!c.has(6));
+
+	// an expired object goes before an unused one that is still valid, even when the hand is on the latter
+	{
+		const std::chrono::steady_clock::time_point soon = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+		IdTaggedContainer<PayloadClass> t;
+		t.set_expiry_extractor([soon](const PayloadClass &n_object) {
+			return (n_object.m_payload == "soon") ? soon : std::chrono::steady_clock::time_point::max();
+		});
+		t.set_capacity(3, eviction_policy::ttl);
+		for (PayloadClass::id_type i = 1; i <= 3; ++i) {
+			BOOST_REQUIRE(t.insert(std::make_shared<PayloadClass>(i, "")));
+		}
+		BOOST_REQUIRE(t.insert(std::make_shared<PayloadClass>(4, "soon")));  // nothing expired, clock evicts 1
+		BOOST_CHECK(!t.has(1));
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(60));
+		BOOST_REQUIRE(t.insert(std::make_shared<PayloadClass>(5, "")));
+		BOOST_CHECK(!t.has(4));
+		BOOST_CHECK(t.has(2));
+		BOOST_CHECK(t.has(3));
+	}
+
+	// shrinking evicts right away, unbounded stops evicting
+	c.set_capacity(1);
+	BOOST_CHECK(c.size() == 1);
+	c.set_capacity(0);
+	for (PayloadClass::id_type i = 10; i < 20; ++i) {
+		BOOST_REQUIRE(c.insert(std::make_shared<PayloadClass>(i, "")));
+	}
+	BOOST_CHECK(c.size() == 11);
+}
+
+BOOST_AUTO_TEST_CASE(range_insert_present) {
+
+	BOOST_TEST_MESSAGE("range inserting objects that are already present");
+
+	const std::shared_ptr<PayloadClass> p1 = std::make_shared<PayloadClass>(1, "");
+	const std::shared_ptr<PayloadClass> p2 = std::make_shared<PayloadClass>(2, "");
+
+	IdTaggedContainer<PayloadClass> c;
+	BOOST_REQUIRE(c.insert(p1));
+	const std::uint64_t incarnation = c.incarnation();
+
+	// the very same pointer, present and twice in the range, is not an insert
+	const std::vector<std::shared_ptr<PayloadClass> > present{ p1, p1 };
+	BOOST_CHECK(c.insert(present.begin(), present.end()) == 0);
+	BOOST_CHECK(c.incarnation() == incarnation);
+	BOOST_CHECK(c.size() == 1);
+
+	const std::vector<std::shared_ptr<PayloadClass> > mixed{ p2, p1, p2 };
+	BOOST_CHECK(c.insert(mixed.begin(), mixed.end()) == 1);
+	BOOST_CHECK(c.incarnation() == incarnation + 1);
+	BOOST_CHECK(c.size() == 2);
+
+	// in a bounded container the clock must stay in line with the index
+	IdTaggedContainer<PayloadClass> b;
+	std::vector<PayloadClass::id_type> evicted;
+	b.set_eviction_handler([&](const std::shared_ptr<PayloadClass> &n_object) {
+		evicted.push_back(n_object->id());
+	});
+	b.set_capacity(2);
+	BOOST_CHECK(b.insert(mixed.begin(), mixed.end()) == 2);
+	BOOST_CHECK(b.insert(present.begin(), present.end()) == 0);
+	BOOST_CHECK(b.size() == 2);
+	BOOST_CHECK(evicted.empty());
+
+	// all fresh, so the hand sweeps once and takes the first, which is 2 from the range
+	BOOST_REQUIRE(b.insert(std::make_shared<PayloadClass>(3, "")));
+	BOOST_REQUIRE(evicted.size() == 1);
+	BOOST_CHECK(evicted[0] == 2);
+	BOOST_CHECK(b.has(1));
+	BOOST_CHECK(b.has(3));
+	BOOST_CHECK(b.size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(random_sampling) {
+
+	IdTaggedContainer<PayloadClass> c;
+	BOOST_CHECK(!c.random_element());
+	BOOST_CHECK(c.sample(3).empty());
+	BOOST_CHECK(!c.power_of_two_choices([](const PayloadClass &) { return 0.0; }));
+
+	for (PayloadClass::id_type i = 0; i < 100; ++i) {
+		BOOST_REQUIRE(c.insert(std::make_shared<PayloadClass>(i, std::to_string(i))));
+	}
+
+	for (int i = 0; i < 1000; ++i) {
+		const std::shared_ptr<PayloadClass> e = c.random_element();
+		BOOST_REQUIRE(e);
+		BOOST_REQUIRE(c.has(e->id()));
+	}
+
+	// both algorithms must yield distinct elements
+	for (const std::size_t k : { 5, 60, 100, 200 }) {
+		const std::vector<std::shared_ptr<PayloadClass> > s = c.sample(k);
+		BOOST_CHECK(s.size() == std::min<std::size_t>(k, 100));
+		std::set<PayloadClass::id_type> ids;
+		for (const std::shared_ptr<PayloadClass> &o : s) {
+			ids.insert(o->id());
+		}
+		BOOST_CHECK(ids.size() == s.size());
+	}
+
+	// the one with the highest id can never win against another
+	for (int i = 0; i < 1000; ++i) {
+		const std::shared_ptr<PayloadClass> e = c.power_of_two_choices([](const PayloadClass &n_object) {
+			return static_cast<double>(n_object.id());
+		});
+		BOOST_REQUIRE(e);
+		BOOST_REQUIRE(e->id() != 99);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(try_insert) {
+
+	MyIdTaggedContainer c;
+	const MyIdTaggedContainer::pointer_type object = std::make_shared<IdTaggedClass>();
+
+	const expected<bool> first = c.try_insert(object);
+	BOOST_REQUIRE(first);
+	BOOST_CHECK(*first);
+	BOOST_CHECK_EQUAL(c.try_insert(object).value(), false);
+
+	const expected<bool> null = c.try_insert(MyIdTaggedContainer::pointer_type());
+	BOOST_CHECK(!null);
+	BOOST_CHECK(null.error().kind() == error_kind::internal);
+	BOOST_CHECK_EQUAL(c.size(), 1);
+}
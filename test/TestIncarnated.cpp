@@ -0,0 +1,330 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MODULE IncarnatedTests
+#include <boost/test/unit_test.hpp>
+
+#include "../Carne.hpp"
+#include "../IncarnationWait.hpp"
+#include "../Memoized.hpp"
+
+#include <boost/asio/io_context.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(BOOST_MSVC)
+#pragma warning (disable : 4553) // faulty '==': operator has no effect; did you intend '='?  in checks
+#endif
+
+using namespace moose::tools;
+
+class IncarnatedClass : public Incarnated< IncarnatedClass > {
+
+	public:
+		IncarnatedClass() = default;
+};
+
+class ChildClass : public Incarnated< ChildClass, IncarnatedClass > {
+
+	public:
+		explicit ChildClass(IncarnatedClass *n_parent)
+				: Incarnated< ChildClass, IncarnatedClass >(n_parent) {
+		}
+};
+
+BOOST_AUTO_TEST_CASE(parent_propagation) {
+
+	IncarnatedClass parent;
+	ChildClass child(&parent);
+
+	child.increase_incarnation();
+	BOOST_CHECK(child.incarnation() == 1);
+	BOOST_CHECK(parent.incarnation() == 1);
+
+	// deferred ones arrive in one batch
+	child.increase_incarnation_deferred();
+	child.increase_incarnation_deferred();
+	BOOST_CHECK(child.incarnation() == 3);
+	BOOST_CHECK(parent.incarnation() == 1);
+	BOOST_CHECK(child.propagate_incarnation());
+	BOOST_CHECK(parent.incarnation() == 2);
+	BOOST_CHECK(!child.propagate_incarnation());
+
+	// without a parent nothing is deferred and nothing is kept for it
+	parent.increase_incarnation_deferred();
+	BOOST_CHECK(parent.incarnation() == 3);
+	BOOST_CHECK(!parent.propagate_incarnation());
+	BOOST_CHECK_EQUAL(sizeof(IncarnatedClass), sizeof(atomic_incarnation_counter) + sizeof(IncarnatedUnusedParent *));
+}
+
+BOOST_AUTO_TEST_CASE(striped_counter) {
+
+	// fewer stripes than threads so some share one
+	striped_incarnation_counter<4> counter(5);
+	BOOST_CHECK(counter.load() == 5);
+
+	const unsigned int threads = 8;
+	const unsigned int increases = 20000;
+	std::atomic<bool> done{ false };
+	bool monotonic = true;
+
+	// the sum of all stripes must never go backwards for a reader
+	std::thread reader([&]() {
+		boost::uint64_t last = 0;
+		while (!done.load()) {
+			const boost::uint64_t current = counter.load();
+			if (current < last) {
+				monotonic = false;
+			}
+			last = current;
+		}
+	});
+
+	std::vector<std::thread> writers;
+	for (unsigned int i = 0; i < threads; ++i) {
+		writers.emplace_back([&counter]() {
+			for (unsigned int n = 0; n < increases; ++n) {
+				counter.increase();
+			}
+		});
+	}
+	for (std::thread &t : writers) {
+		t.join();
+	}
+	done = true;
+	reader.join();
+
+	BOOST_CHECK(monotonic);
+	BOOST_CHECK_EQUAL(counter.load(), 5 + threads * increases);
+}
+
+BOOST_AUTO_TEST_CASE(blocking_wait) {
+
+	IncarnatedClass c;
+	const boost::uint64_t known = c.incarnation();
+
+	BOOST_CHECK(!c.wait_changed(known, std::chrono::milliseconds(20)));
+
+	std::thread writer([&c]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		c.increase_incarnation();
+	});
+
+	BOOST_CHECK(c.wait_changed(known, std::chrono::seconds(10)));
+	writer.join();
+
+	// returns right away when already changed
+	BOOST_CHECK(c.wait_changed(known, std::chrono::seconds(0)));
+}
+
+BOOST_AUTO_TEST_CASE(async_wait) {
+
+	boost::asio::io_context io;
+	IncarnatedClass c;
+	const boost::uint64_t known = c.incarnation();
+
+	boost::system::error_code timeout_result;
+	bool timeout_called = false;
+	async_wait_changed(io.get_executor(), c, known, std::chrono::milliseconds(10), [&](const boost::system::error_code &n_error) {
+		timeout_called = true;
+		timeout_result = n_error;
+	});
+	io.run();
+	BOOST_CHECK(timeout_called);
+	BOOST_CHECK(timeout_result == boost::asio::error::timed_out);
+
+	// changed from another thread while io runs here
+	io.restart();
+	boost::system::error_code change_result = boost::asio::error::timed_out;
+	async_wait_changed(io.get_executor(), c, known, std::chrono::seconds(10), [&](const boost::system::error_code &n_error) {
+		change_result = n_error;
+	});
+
+	std::thread writer([&c]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		c.increase_incarnation();
+	});
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	io.run();
+	writer.join();
+	BOOST_CHECK(!change_result);
+	BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+	BOOST_CHECK(detail::incarnation_waiters[detail::incarnation_bucket_index(&c)].m_count.load() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(waiter_buckets) {
+
+	IncarnatedClass waited;
+	IncarnatedClass others[8];
+	const std::size_t waited_bucket = detail::incarnation_bucket_index(&waited);
+	const IncarnatedClass *other = std::find_if(std::begin(others), std::end(others), [waited_bucket](const IncarnatedClass &n_other) {
+		return detail::incarnation_bucket_index(&n_other) != waited_bucket;
+	});
+	BOOST_REQUIRE(other != std::end(others));
+
+	// a waiter only makes writers in its own bucket notify
+	const boost::uint64_t ticket = detail::incarnation_add_async_waiter(&waited, []() {});
+	BOOST_CHECK(detail::incarnation_waiters[waited_bucket].m_count.load() == 1);
+	BOOST_CHECK(detail::incarnation_waiters[detail::incarnation_bucket_index(other)].m_count.load() == 0);
+	detail::incarnation_remove_async_waiter(&waited, ticket);
+	BOOST_CHECK(detail::incarnation_waiters[waited_bucket].m_count.load() == 0);
+
+	// a throwing callback neither terminates the writer nor keeps the others from being notified
+	int notified = 0;
+	detail::incarnation_add_async_waiter(&waited, []() {
+		throw std::runtime_error("cannot post");
+	});
+	detail::incarnation_add_async_waiter(&waited, [&notified]() {
+		++notified;
+	});
+	waited.increase_incarnation();
+	BOOST_CHECK(notified == 1);
+	BOOST_CHECK(detail::incarnation_waiters[waited_bucket].m_count.load() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(memoized) {
+
+	IncarnatedClass a;
+	IncarnatedClass b;
+	int computations = 0;
+
+	Memoized<boost::uint64_t, IncarnatedClass, IncarnatedClass> sum([&](const IncarnatedClass &n_a, const IncarnatedClass &n_b) {
+		++computations;
+		return n_a.incarnation() + n_b.incarnation();
+	}, a, b);
+
+	BOOST_CHECK(!sum.valid());
+	BOOST_CHECK(*sum.get() == 0);
+	BOOST_CHECK(*sum.get() == 0);
+	BOOST_CHECK(computations == 1);
+	BOOST_CHECK(sum.valid());
+
+	// any source changing makes it compute again
+	b.increase_incarnation();
+	BOOST_CHECK(!sum.valid());
+	BOOST_CHECK(*sum.get() == 1);
+	a.increase_incarnation();
+	BOOST_CHECK(*sum.get() == 2);
+	BOOST_CHECK(computations == 3);
+
+	sum.invalidate();
+	BOOST_CHECK(*sum.get() == 2);
+	BOOST_CHECK(computations == 4);
+
+	// in background the outdated value is handed out until the scheduled job ran
+	std::vector<std::function<void ()> > jobs;
+	sum.set_background_scheduler([&](std::function<void ()> &&n_job) {
+		jobs.push_back(std::move(n_job));
+	});
+	sum.invalidate();
+	BOOST_CHECK(*sum.get() == 2);
+
+	a.increase_incarnation();
+	BOOST_CHECK(*sum.get() == 2);
+	BOOST_CHECK(*sum.get() == 2);
+	BOOST_REQUIRE(jobs.size() == 1);
+	jobs.front()();
+	BOOST_CHECK(*sum.get() == 3);
+
+	// a scheduler failing doesn't keep it from scheduling again later
+	jobs.clear();
+	bool fail = true;
+	sum.set_background_scheduler([&](std::function<void ()> &&n_job) {
+		if (fail) {
+			throw std::runtime_error("scheduler down");
+		}
+		jobs.push_back(std::move(n_job));
+	});
+	b.increase_incarnation();
+	BOOST_CHECK_THROW(sum.get(), std::runtime_error);
+	fail = false;
+	BOOST_CHECK(*sum.get() == 3);
+	BOOST_REQUIRE(jobs.size() == 1);
+	jobs.front()();
+	BOOST_CHECK(*sum.get() == 4);
+}
+
+class TrackedChild;
+
+class TrackingParent : public Incarnated< TrackingParent >, public DirtyChildTracker< TrackedChild > {
+
+	public:
+		TrackingParent() = default;
+};
+
+class TrackedChild : public Incarnated< TrackedChild, TrackingParent >, public DirtyTrackedChild< TrackedChild > {
+
+	public:
+		explicit TrackedChild(TrackingParent *n_parent)
+				: Incarnated< TrackedChild, TrackingParent >(n_parent) {
+		}
+};
+
+BOOST_AUTO_TEST_CASE(dirty_tracking) {
+
+	TrackingParent parent;
+	std::vector<std::unique_ptr<TrackedChild> > children;
+	for (int i = 0; i < 10; ++i) {
+		children.emplace_back(new TrackedChild(&parent));
+	}
+
+	BOOST_CHECK(!parent.has_dirty());
+	BOOST_CHECK(parent.collect_dirty().empty());
+
+	// each dirty one exactly once
+	children[2]->increase_incarnation();
+	children[7]->increase_incarnation();
+	children[2]->increase_incarnation();
+	children[5]->increase_incarnation_deferred();
+	BOOST_CHECK(parent.has_dirty());
+
+	std::vector<TrackedChild *> dirty = parent.collect_dirty();
+	BOOST_REQUIRE(dirty.size() == 3);
+	std::sort(dirty.begin(), dirty.end());
+	std::vector<TrackedChild *> expected{ children[2].get(), children[5].get(), children[7].get() };
+	std::sort(expected.begin(), expected.end());
+	BOOST_CHECK(dirty == expected);
+	BOOST_CHECK(parent.collect_dirty().empty());
+
+	// dying children leave the list
+	children[1]->increase_incarnation();
+	children[3]->increase_incarnation();
+	children[4]->increase_incarnation();
+	children[3].reset();
+	children[4].reset();
+	dirty = parent.collect_dirty();
+	BOOST_REQUIRE(dirty.size() == 1);
+	BOOST_CHECK(dirty[0] == children[1].get());
+
+	// concurrent writers lose nothing
+	std::vector<std::thread> writers;
+	for (int t = 0; t < 4; ++t) {
+		writers.emplace_back([&children, t]() {
+			for (int i = 0; i < 1000; ++i) {
+				children[(t % 2) ? 6 : 8]->increase_incarnation();
+			}
+		});
+	}
+	std::size_t collected = 0;
+	while (collected < 2) {
+		for (TrackedChild *c : parent.collect_dirty()) {
+			if (c->incarnation() == 2000) {
+				++collected;
+			}
+		}
+		if (collected < 2) {
+			std::this_thread::yield();
+		}
+	}
+	for (std::thread &w : writers) {
+		w.join();
+	}
+}
@@ -8,6 +8,17 @@
 
 #include "../Mutexed.hpp"
 #include "../Error.hpp"
+#include "../LockProfile.hpp"
+#include "../Lockables.hpp"
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <atomic>
+#include <optional>
+#include <vector>
 
 using namespace moose::tools;
 
@@ -55,3 +66,476 @@ BOOST_AUTO_TEST_CASE(compile_write_lock) {
 	BOOST_CHECK(inc2 == (inc1 + 1));
 }
 
+
+BOOST_AUTO_TEST_CASE(shared_readers) {
+
+	MutexedClass c;
+	const boost::uint64_t inc = c.incarnation();
+
+	// readers don't block each other, one upgradable may join them
+	MutexedClass::scoped_lock r1 = c.acquire_read_lock();
+	MutexedClass::scoped_lock r2 = c.acquire_read_lock();
+	MutexedClass::scoped_lock u = c.acquire_upgradable_lock();
+	BOOST_CHECK(r1.owns_lock());
+	BOOST_CHECK(r2.owns_lock());
+	BOOST_CHECK(u.mode() == MutexedClass::lock_mode::upgradable);
+	BOOST_CHECK(&u.issuer() == &c);
+
+	// a reader in another thread gets in as well
+	bool reader_got_in = false;
+	boost::thread reader([&]() {
+		MutexedClass::scoped_lock r = c.acquire_read_lock();
+		reader_got_in = true;
+	});
+	reader.join();
+	BOOST_CHECK(reader_got_in);
+
+	r1.unlock();
+	r2.unlock();
+	BOOST_CHECK(!r1.owns_lock());
+
+	// upgrade while others wait
+	u.upgrade();
+	BOOST_CHECK(u.mode() == MutexedClass::lock_mode::write);
+	BOOST_CHECK(c.incarnation() == inc);
+
+	// downgrading ends the write
+	u.downgrade();
+	BOOST_CHECK(c.incarnation() == inc + 1);
+	BOOST_CHECK(u.mode() == MutexedClass::lock_mode::read);
+	u.unlock();
+	BOOST_CHECK(c.incarnation() == inc + 1);
+
+	// read locks never increase
+	{
+		MutexedClass::scoped_lock r = c.acquire_read_lock();
+		r.upgrade();
+	}
+	BOOST_CHECK(c.incarnation() == inc + 2);
+}
+
+BOOST_AUTO_TEST_CASE(writer_excludes_readers) {
+
+	MutexedClass c;
+	std::atomic<bool> reader_got_in{ false };
+
+	MutexedClass::scoped_lock w = c.acquire_write_lock();
+	boost::thread reader([&]() {
+		MutexedClass::scoped_lock r = c.acquire_read_lock();
+		reader_got_in = true;
+	});
+
+	boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+	BOOST_CHECK(!reader_got_in);
+
+	// moving the lock keeps it held
+	MutexedClass::scoped_lock moved(std::move(w));
+	BOOST_CHECK(!w.owns_lock());
+	BOOST_CHECK(moved.owns_lock());
+	moved.unlock();
+
+	reader.join();
+	BOOST_CHECK(reader_got_in);
+}
+
+class PlainMutexedClass : public Mutexed< PlainMutexedClass, boost::mutex > {
+
+	public:
+		PlainMutexedClass() = default;
+};
+
+BOOST_AUTO_TEST_CASE(exclusive_lockable) {
+
+	// everything works with a plain mutex, just exclusively
+	PlainMutexedClass c;
+	const boost::uint64_t inc = c.incarnation();
+	{
+		PlainMutexedClass::scoped_lock r = c.acquire_upgradable_lock();
+		r.upgrade();
+		r.downgrade();
+	}
+	{
+		PlainMutexedClass::scoped_lock r = c.acquire_read_lock();
+	}
+	BOOST_CHECK(c.incarnation() == inc + 1);
+}
+
+BOOST_AUTO_TEST_CASE(condition_wait) {
+
+	// scoped_lock is BasicLockable and thus waits on a condition_variable_any
+	PlainMutexedClass c;
+	boost::condition_variable_any cond;
+	bool ready = false;
+
+	PlainMutexedClass::scoped_lock w = c.acquire_write_lock();
+	const boost::uint64_t inc = c.incarnation();
+	boost::thread notifier([&]() {
+		PlainMutexedClass::scoped_lock slock = c.acquire_write_lock();
+		ready = true;
+		cond.notify_one();
+	});
+
+	cond.wait(w, [&]() { return ready; });
+	BOOST_CHECK(w.owns_lock());
+	BOOST_CHECK(w.mode() == PlainMutexedClass::lock_mode::write);
+
+	// my own wait released the write lock and so did the notifier
+	BOOST_CHECK_EQUAL(c.incarnation(), inc + 2);
+	w.unlock();
+	notifier.join();
+}
+
+class PairClass : public Mutexed< PairClass > {
+
+	public:
+		PairClass() = default;
+
+		std::atomic<int> m_first{ 0 };
+		std::atomic<int> m_second{ 0 };
+};
+
+BOOST_AUTO_TEST_CASE(optimistic_read) {
+
+	PairClass c;
+	BOOST_CHECK(c.incarnation() == 1);
+
+	std::atomic<bool> stop{ false };
+	boost::thread writer([&]() {
+		while (!stop) {
+			PairClass::scoped_lock w = c.acquire_write_lock();
+			c.m_first.store(c.m_first.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			c.m_second.store(c.m_second.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+	});
+
+	// the writer keeps both the same, so must every read that got through
+	for (int i = 0; i < 100000; ++i) {
+		const std::pair<int, int> p = c.optimistic_read([&c]() {
+			return std::make_pair(c.m_first.load(std::memory_order_relaxed), c.m_second.load(std::memory_order_relaxed));
+		});
+		BOOST_REQUIRE(p.first == p.second);
+	}
+
+	stop = true;
+	writer.join();
+	BOOST_CHECK(c.incarnation() == static_cast<boost::uint64_t>(c.m_first.load()) + 1);
+
+	// void works as well
+	int calls = 0;
+	c.optimistic_read([&calls]() { ++calls; });
+	BOOST_CHECK(calls == 1);
+}
+
+#if defined(MOOSE_TOOLS_LOCK_PROFILING)
+BOOST_AUTO_TEST_CASE(lock_profiling) {
+
+	BOOST_CHECK(lock_profiling_enabled());
+	reset_lock_profile();
+
+	MutexedClass c;
+	for (int i = 0; i < 10; ++i) {
+		MutexedClass::scoped_lock w = c.acquire_write_lock();
+	}
+
+	// one waiting
+	MutexedClass::scoped_lock w = c.acquire_write_lock();
+	boost::thread waiter([&c]() {
+		MutexedClass::scoped_lock r = c.acquire_read_lock();
+	});
+	boost::this_thread::sleep_for(boost::chrono::milliseconds(20));
+	w.unlock();
+	waiter.join();
+
+	// released on another thread
+	MutexedClass::scoped_lock moved = c.acquire_write_lock();
+	boost::thread releaser([&moved]() {
+		moved.unlock();
+	});
+	releaser.join();
+
+	const LockProfileSnapshot profile = lock_profile();
+	boost::uint64_t acquisitions = 0;
+	boost::uint64_t contended = 0;
+	boost::uint64_t histogram = 0;
+	for (const LockSiteProfile &site : profile.sites) {
+		if (site.type.find("MutexedClass") != std::string::npos) {
+			BOOST_CHECK(site.file.find("TestMutexed.cpp") != std::string::npos);
+			acquisitions += site.acquisitions;
+			contended += site.contended;
+			for (const boost::uint64_t h : site.hold_histogram) {
+				histogram += h;
+			}
+		}
+	}
+
+	BOOST_CHECK(acquisitions == 13);
+	BOOST_CHECK(contended == 1);
+	BOOST_CHECK(histogram == 13);
+	BOOST_CHECK_NO_THROW(dump_lock_profile());
+
+	// Threads hand their numbers over when they end, lock_all() records where it was called
+	// and a lock may outlive the thread that acquired it
+	reset_lock_profile();
+	MutexedClass d;
+	unsigned int lock_all_line = 0;
+	std::optional<MutexedClass::scoped_lock> outliving;
+	for (int i = 0; i < 4; ++i) {
+		boost::thread t([&]() {
+			lock_all_line = __LINE__; const auto locks = lock_all(c, d);
+		});
+		t.join();
+	}
+	boost::thread acquirer([&]() {
+		outliving.emplace(d.acquire_write_lock());
+	});
+	acquirer.join();
+	outliving->unlock();
+
+	acquisitions = 0;
+	histogram = 0;
+	boost::uint64_t at_lock_all = 0;
+	for (const LockSiteProfile &site : lock_profile().sites) {
+		if (site.type.find("MutexedClass") != std::string::npos) {
+			BOOST_CHECK(site.file.find("TestMutexed.cpp") != std::string::npos);
+			acquisitions += site.acquisitions;
+			if (site.line == lock_all_line) {
+				at_lock_all += site.acquisitions;
+			}
+			for (const boost::uint64_t h : site.hold_histogram) {
+				histogram += h;
+			}
+		}
+	}
+
+	BOOST_CHECK_EQUAL(acquisitions, 9);
+	BOOST_CHECK_EQUAL(at_lock_all, 8);
+	BOOST_CHECK_EQUAL(histogram, 9);
+}
+#endif
+
+template< typename Lockable >
+class CountingClass : public Mutexed< CountingClass<Lockable>, Lockable > {
+
+	public:
+		CountingClass() = default;
+
+		void increase() {
+
+			typename Mutexed< CountingClass<Lockable>, Lockable >::scoped_lock slock = this->acquire_write_lock();
+			++m_count;
+		}
+
+		unsigned int m_count = 0;
+};
+
+template< typename Lockable >
+void check_mutual_exclusion() {
+
+	CountingClass<Lockable> c;
+	std::vector<boost::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&c]() {
+			for (int i = 0; i < 20000; ++i) {
+				c.increase();
+			}
+		});
+	}
+	for (boost::thread &t : threads) {
+		t.join();
+	}
+
+	BOOST_CHECK(c.m_count == 80000);
+	BOOST_CHECK(c.incarnation() == 80001);
+
+	// try_lock must fail while held
+	Lockable l;
+	BOOST_CHECK(l.try_lock());
+	BOOST_CHECK(!l.try_lock());
+	l.unlock();
+	BOOST_CHECK(l.try_lock());
+	l.unlock();
+}
+
+BOOST_AUTO_TEST_CASE(lockables) {
+
+	check_mutual_exclusion<adaptive_mutex>();
+	check_mutual_exclusion<ticket_mutex>();
+	check_mutual_exclusion<cohort_mutex<> >();
+}
+
+class CombinedCounter : public Mutexed< CombinedCounter > {
+
+	public:
+		boost::uint64_t increase() {
+
+			return combine([this]() {
+				return ++m_count;
+			});
+		}
+
+		boost::uint64_t count() const {
+
+			const scoped_lock slock = acquire_read_lock();
+			return m_count;
+		}
+
+	private:
+		boost::uint64_t m_count = 0;
+};
+
+BOOST_AUTO_TEST_CASE(combine) {
+
+	CombinedCounter c;
+	const boost::uint64_t inc1 = c.incarnation();
+
+	// return values come back to the caller
+	BOOST_CHECK_EQUAL(c.increase(), 1);
+	BOOST_CHECK_EQUAL(c.incarnation(), inc1 + 1);
+
+	const unsigned int threads = 4;
+	const unsigned int operations = 5000;
+	std::vector<boost::thread> workers;
+	for (unsigned int i = 0; i < threads; ++i) {
+		workers.emplace_back([&c]() {
+			for (unsigned int o = 0; o < operations; ++o) {
+				c.increase();
+			}
+		});
+	}
+	for (boost::thread &t : workers) {
+		t.join();
+	}
+
+	BOOST_CHECK_EQUAL(c.count(), threads * operations + 1);
+
+	// Batches bump the incarnation once, so it can only be less than one per operation
+	BOOST_CHECK_GT(c.incarnation(), inc1 + 1);
+	BOOST_CHECK_LE(c.incarnation(), inc1 + 1 + threads * operations);
+
+	// exceptions get to the caller, the object stays usable
+	BOOST_CHECK_THROW(c.combine([]() {
+		BOOST_THROW_EXCEPTION(internal_error() << error_message("combined operation failed"));
+	}), internal_error);
+	BOOST_CHECK_EQUAL(c.increase(), threads * operations + 2);
+
+	// const callables work with and without result
+	bool called = false;
+	const auto mark_called = [&called]() {
+		called = true;
+	};
+	c.combine(mark_called);
+	BOOST_CHECK(called);
+
+	const auto answer = []() {
+		return 42;
+	};
+	BOOST_CHECK_EQUAL(c.combine(answer), 42);
+
+	// try_acquire_write_lock doesn't wait for readers
+	{
+		const CombinedCounter::scoped_lock rlock = c.acquire_read_lock();
+		CombinedCounter::scoped_lock wlock = c.try_acquire_write_lock();
+		BOOST_CHECK(!wlock.owns_lock());
+	}
+	CombinedCounter::scoped_lock wlock = c.try_acquire_write_lock();
+	BOOST_CHECK(wlock.owns_lock());
+	BOOST_CHECK(wlock.mode() == CombinedCounter::lock_mode::write);
+}
+
+class Account : public Mutexed< Account > {
+
+	public:
+		Account(const int n_balance)
+				: m_balance(n_balance) {
+		}
+
+		//! moves money without locking, the caller has to lock both
+		static void transfer(Account &n_from, Account &n_to, const int n_amount) {
+
+			n_from.m_balance -= n_amount;
+			n_to.m_balance += n_amount;
+		}
+
+		int balance() const {
+
+			const scoped_lock slock = acquire_read_lock();
+			return m_balance;
+		}
+
+	private:
+		int m_balance;
+};
+
+BOOST_AUTO_TEST_CASE(lock_all_objects) {
+
+	Account a(1000);
+	Account b(1000);
+	MutexedClass c;
+	const boost::uint64_t inc_a = a.incarnation();
+
+	{
+		auto locks = lock_all(a, c, b);
+		BOOST_CHECK(std::get<0>(locks).mode() == Account::lock_mode::write);
+		BOOST_CHECK(std::get<1>(locks).owns_lock());
+		BOOST_CHECK(std::get<2>(locks).owns_lock());
+
+		// nobody else gets in
+		BOOST_CHECK(!b.try_acquire_write_lock().owns_lock());
+	}
+	BOOST_CHECK_EQUAL(a.incarnation(), inc_a + 1);
+
+	// Two threads transferring in opposite directions and naming the accounts
+	// in opposite order would deadlock with naive locking
+	const unsigned int transfers = 20000;
+	boost::thread there([&]() {
+		for (unsigned int i = 0; i < transfers; ++i) {
+			const auto locks = lock_all(a, b);
+			Account::transfer(a, b, 1);
+		}
+	});
+	boost::thread back([&]() {
+		for (unsigned int i = 0; i < transfers; ++i) {
+			const auto [lb, la] = lock_all(b, a);
+			Account::transfer(b, a, 1);
+		}
+	});
+	there.join();
+	back.join();
+
+	BOOST_CHECK_EQUAL(a.balance(), 1000);
+	BOOST_CHECK_EQUAL(b.balance(), 1000);
+	BOOST_CHECK_EQUAL(a.incarnation(), inc_a + 1 + 2 * transfers);
+
+	BOOST_CHECK_THROW(lock_all(a, b, a), internal_error);
+	BOOST_CHECK(a.try_acquire_write_lock().owns_lock());
+}
+
+BOOST_AUTO_TEST_CASE(lock_all_against_reader) {
+
+	// A reader of one going on to write the other must not deadlock with lock_all()
+	MutexedClass a;
+	MutexedClass b;
+	const boost::uint64_t inc_a = a.incarnation();
+	std::atomic<bool> reading{ false };
+
+	boost::thread reader([&]() {
+		MutexedClass::scoped_lock r = b.acquire_read_lock();
+		reading = true;
+		boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+		MutexedClass::scoped_lock w = a.acquire_write_lock();
+	});
+
+	while (!reading) {
+		boost::this_thread::yield();
+	}
+
+	{
+		const auto locks = lock_all(a, b);
+		BOOST_CHECK(std::get<0>(locks).mode() == MutexedClass::lock_mode::write);
+		BOOST_CHECK(std::get<1>(locks).mode() == MutexedClass::lock_mode::write);
+	}
+	reader.join();
+
+	// locks given back while backing off don't count
+	BOOST_CHECK_EQUAL(a.incarnation(), inc_a + 2);
+}
@@ -0,0 +1,159 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MODULE ObjectPoolTests
+#include <boost/test/unit_test.hpp>
+
+#include "../ObjectPool.hpp"
+
+#include <boost/thread/thread.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace moose::tools;
+
+namespace {
+
+	struct alignas(32) Aligned {
+
+		Aligned(const int n_value)
+				: m_value(n_value) {
+		}
+
+		int m_value;
+	};
+
+	struct Thrower {
+
+		Thrower() {
+
+			throw std::runtime_error("no");
+		}
+	};
+}
+
+struct SessionImpl;
+class Session : private Pimpled<SessionImpl, PimplPoolAllocation> {
+
+	public:
+		Session(const std::string &n_peer);
+		~Session() noexcept;
+
+		const std::string &peer() const;
+};
+
+struct SessionImpl : public Pimplee {
+
+	std::string m_peer;
+};
+
+Session::Session(const std::string &n_peer) {
+
+	d().m_peer = n_peer;
+}
+
+Session::~Session() noexcept {
+
+}
+
+const std::string &Session::peer() const {
+
+	return d().m_peer;
+}
+
+BOOST_AUTO_TEST_CASE(create_destroy) {
+
+	ObjectPool<Aligned> &pool = ObjectPool<Aligned>::instance();
+	BOOST_CHECK_EQUAL(pool.block_size() % 32, 0);
+
+	Aligned *first = pool.create(42);
+	BOOST_CHECK_EQUAL(first->m_value, 42);
+	BOOST_CHECK_EQUAL(reinterpret_cast<std::uintptr_t>(first) % 32, 0);
+	pool.destroy(first);
+
+	ObjectPoolStats stats = pool.stats();
+	BOOST_CHECK_EQUAL(stats.allocations, 1);
+	BOOST_CHECK_EQUAL(stats.hits, 0);
+	BOOST_CHECK_EQUAL(stats.bytes_retained, pool.block_size());
+
+	// the same block again, now from the thread's cache
+	Aligned *second = pool.create(43);
+	BOOST_CHECK_EQUAL(second, first);
+	stats = pool.stats();
+	BOOST_CHECK_EQUAL(stats.hits, 1);
+	BOOST_CHECK_EQUAL(stats.bytes_retained, 0);
+	pool.destroy(second);
+
+	BOOST_CHECK_EQUAL(pool.trim(), pool.block_size());
+	BOOST_CHECK_EQUAL(pool.stats().bytes_retained, 0);
+
+	// failing c'tors give the block back
+	BOOST_CHECK_THROW(ObjectPool<Thrower>::instance().create(), std::runtime_error);
+	BOOST_CHECK_EQUAL(ObjectPool<Thrower>::instance().stats().bytes_retained, ObjectPool<Thrower>::instance().block_size());
+}
+
+BOOST_AUTO_TEST_CASE(pooled_pimpl) {
+
+	const ObjectPoolStats before = ObjectPool<SessionImpl>::instance().stats();
+
+	for (int i = 0; i < 1000; ++i) {
+		std::vector<std::unique_ptr<Session> > sessions;
+		for (int s = 0; s < 10; ++s) {
+			sessions.push_back(std::make_unique<Session>("peer"));
+		}
+		BOOST_CHECK_EQUAL(sessions.back()->peer(), "peer");
+	}
+
+	const ObjectPoolStats after = ObjectPool<SessionImpl>::instance().stats();
+	BOOST_CHECK_EQUAL(after.allocations - before.allocations, 10000);
+	BOOST_CHECK_EQUAL(after.hits - before.hits, 9990);
+	BOOST_CHECK_GT(after.hit_rate(), 0.99);
+	BOOST_CHECK_EQUAL(after.bytes_retained, 10 * ObjectPool<SessionImpl>::instance().block_size());
+
+	BOOST_CHECK_GE(trim_object_pools(), after.bytes_retained);
+	BOOST_CHECK_EQUAL(ObjectPool<SessionImpl>::instance().stats().bytes_retained, 0);
+}
+
+BOOST_AUTO_TEST_CASE(cross_thread) {
+
+	ObjectPool<Aligned> &pool = ObjectPool<Aligned>::instance();
+	pool.trim();
+
+	// created here, freed in other threads and created there again
+	std::vector<Aligned *> objects;
+	for (int i = 0; i < 1000; ++i) {
+		objects.push_back(pool.create(i));
+	}
+
+	std::vector<boost::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&pool, &objects, t]() {
+			for (std::size_t i = t; i < objects.size(); i += 4) {
+				BOOST_CHECK_EQUAL(objects[i]->m_value, static_cast<int>(i));
+				pool.destroy(objects[i]);
+			}
+			for (int round = 0; round < 100; ++round) {
+				std::vector<Aligned *> mine;
+				for (int i = 0; i < 100; ++i) {
+					mine.push_back(pool.create(i));
+				}
+				for (Aligned *a : mine) {
+					pool.destroy(a);
+				}
+			}
+		});
+	}
+	for (boost::thread &t : threads) {
+		t.join();
+	}
+
+	// Threads flushed everything they had when ending
+	const ObjectPoolStats stats = pool.stats();
+	BOOST_CHECK_GT(stats.hit_rate(), 0.9);
+	BOOST_CHECK_EQUAL(pool.trim(), stats.bytes_retained);
+	BOOST_CHECK_EQUAL(pool.stats().bytes_retained, 0);
+}
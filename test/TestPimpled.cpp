@@ -0,0 +1,130 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MODULE PimpledTests
+#include <boost/test/unit_test.hpp>
+
+#include "../Pimpled.hpp"
+
+#include <cstdint>
+#include <string>
+
+using namespace moose::tools;
+
+namespace {
+
+	int impls_alive = 0;
+}
+
+// This would be in a header
+struct HeapImpl;
+class HeapWidget : private Pimpled<HeapImpl> {
+
+	public:
+		HeapWidget(const std::string &n_name);
+		~HeapWidget() noexcept;
+
+		const std::string &name() const;
+};
+
+struct InlineImpl;
+class InlineWidget : private FastPimpled<InlineImpl, 64> {
+
+	public:
+		InlineWidget(const std::string &n_name);
+		~InlineWidget() noexcept;
+
+		const std::string &name() const;
+		void rename(const std::string &n_name);
+
+		//! address of the impl, to see it's really inline
+		const void *impl() const;
+};
+
+// and this in the cpp
+struct HeapImpl : public Pimplee {
+
+	std::string m_name;
+};
+
+HeapWidget::HeapWidget(const std::string &n_name) {
+
+	d().m_name = n_name;
+}
+
+HeapWidget::~HeapWidget() noexcept {
+
+}
+
+const std::string &HeapWidget::name() const {
+
+	return d().m_name;
+}
+
+struct InlineImpl : public Pimplee {
+
+	InlineImpl() {
+
+		++impls_alive;
+	}
+
+	~InlineImpl() noexcept {
+
+		--impls_alive;
+	}
+
+	std::string m_name;
+};
+
+InlineWidget::InlineWidget(const std::string &n_name) {
+
+	d().m_name = n_name;
+}
+
+InlineWidget::~InlineWidget() noexcept {
+
+}
+
+const std::string &InlineWidget::name() const {
+
+	return d().m_name;
+}
+
+void InlineWidget::rename(const std::string &n_name) {
+
+	d().m_name = n_name;
+}
+
+const void *InlineWidget::impl() const {
+
+	return &d();
+}
+
+BOOST_AUTO_TEST_CASE(heap_pimpl) {
+
+	const HeapWidget w("heap");
+	BOOST_CHECK_EQUAL(w.name(), "heap");
+}
+
+BOOST_AUTO_TEST_CASE(fast_pimpl) {
+
+	BOOST_CHECK_EQUAL(sizeof(InlineWidget), 64);
+	BOOST_CHECK_EQUAL(alignof(InlineWidget), alignof(std::max_align_t));
+
+	{
+		InlineWidget w("inline");
+		BOOST_CHECK_EQUAL(impls_alive, 1);
+		BOOST_CHECK_EQUAL(w.name(), "inline");
+
+		w.rename("renamed");
+		BOOST_CHECK_EQUAL(w.name(), "renamed");
+
+		const std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(&w);
+		const std::uintptr_t impl = reinterpret_cast<std::uintptr_t>(w.impl());
+		BOOST_CHECK((impl >= begin) && (impl < begin + sizeof(InlineWidget)));
+		BOOST_CHECK_EQUAL(impl % alignof(std::max_align_t), 0);
+	}
+
+	BOOST_CHECK_EQUAL(impls_alive, 0);
+}
@@ -53,3 +53,21 @@ BOOST_AUTO_TEST_CASE(SmallStatistics) {
 	
 	BOOST_CHECK_CLOSE(mean(acc), 1.0, 1.0);
 }
+
+BOOST_AUTO_TEST_CASE(FastStatistics) {
+
+	BOOST_CHECK(moose::tools::fast_urand(0) == 0);
+	BOOST_CHECK(moose::tools::fast_urand(1) == 0);
+
+	// all values in range, mean where it should be
+	accumulator_set<double, stats<tag::mean> > acc;
+	for (unsigned int i = 0; i < 100000; ++i) {
+
+		const boost::uint64_t val = moose::tools::fast_urand(101);
+		BOOST_REQUIRE(val <= 100);
+		acc(static_cast<double>(val));
+	}
+
+	BOOST_CHECK(mean(acc) < 52);
+	BOOST_CHECK(mean(acc) > 48);
+}
@@ -0,0 +1,111 @@
+//  Copyright 2015 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MODULE RefCountedTests
+#include <boost/test/unit_test.hpp>
+
+#include "../RefCounted.hpp"
+#include "../Macros.hpp"
+
+#include <boost/thread/thread.hpp>
+
+#include <vector>
+
+using namespace moose::tools;
+
+namespace {
+
+	int alive = 0;
+}
+
+MOOSE_FWD_DECLARE_CLASS(Shared)
+MOOSE_FWD_DECLARE_STRUCT(Local)
+
+class Shared : public RefCounted<Shared> {
+
+	public:
+		Shared(const int n_value)
+				: m_value(n_value) {
+
+			++alive;
+		}
+
+		~Shared() noexcept {
+
+			--alive;
+		}
+
+		int value() const noexcept {
+
+			return m_value;
+		}
+
+	private:
+		const int m_value;
+};
+
+struct Local : public LocalRefCounted<Local> {
+
+	Local() {
+
+		++alive;
+	}
+
+	~Local() noexcept {
+
+		--alive;
+	}
+};
+
+BOOST_AUTO_TEST_CASE(atomic_count) {
+
+	{
+		SharedIPtr s = make_intrusive<Shared>(42);
+		BOOST_CHECK_EQUAL(s->use_count(), 1);
+		BOOST_CHECK_EQUAL(alive, 1);
+
+		SharedCIPtr c = s;
+		BOOST_CHECK_EQUAL(c->value(), 42);
+		BOOST_CHECK_EQUAL(s->use_count(), 2);
+
+		// copies from many threads at once
+		std::vector<boost::thread> threads;
+		for (int t = 0; t < 4; ++t) {
+			threads.emplace_back([s]() {
+				for (int i = 0; i < 10000; ++i) {
+					const SharedIPtr copy = s;
+				}
+			});
+		}
+		for (boost::thread &t : threads) {
+			t.join();
+		}
+		BOOST_CHECK_EQUAL(s->use_count(), 2);
+
+		// the last one to let go in some other thread deletes
+		c.reset();
+		boost::thread last([moved = std::move(s)]() mutable {
+			moved.reset();
+		});
+		last.join();
+	}
+
+	BOOST_CHECK_EQUAL(alive, 0);
+}
+
+BOOST_AUTO_TEST_CASE(local_count) {
+
+	{
+		LocalLPtr l = make_intrusive<Local>();
+		LocalCLPtr c = l;
+		BOOST_CHECK_EQUAL(l->use_count(), 2);
+		BOOST_CHECK_EQUAL(alive, 1);
+
+		l.reset();
+		BOOST_CHECK_EQUAL(c->use_count(), 1);
+		BOOST_CHECK_EQUAL(alive, 1);
+	}
+
+	BOOST_CHECK_EQUAL(alive, 0);
+}
@@ -0,0 +1,320 @@
+//  Copyright 2019 Stephan Menzel. Distributed under the Boost
+//  Software License, Version 1.0. (See accompanying file
+//  LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MODULE ReplicationTests
+#include <boost/test/unit_test.hpp>
+
+#include "../IdTaggedReplication.hpp"
+#include "../IdTagged.hpp"
+
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using namespace moose::tools;
+
+class ReplicatedClass : public IdTagged< ReplicatedClass > {
+
+	public:
+		ReplicatedClass(const id_type n_id, const std::string &n_payload)
+				: IdTagged< ReplicatedClass >(n_id)
+				, m_payload(n_payload) {
+		}
+
+		ReplicatedClass(const ReplicatedClass &n_other) = delete;
+		~ReplicatedClass() = default;
+
+		const std::string m_payload;
+};
+
+struct ReplicatedCodec {
+
+	void encode(const ReplicatedClass &n_object, std::string &n_buffer) const {
+
+		n_buffer.append(n_object.m_payload);
+	}
+
+	std::shared_ptr<ReplicatedClass> decode(const ReplicatedClass::id_type n_id, const char *n_data, const std::size_t n_size) const {
+
+		return std::make_shared<ReplicatedClass>(n_id, std::string(n_data, n_size));
+	}
+};
+
+using Publisher  = IdTaggedContainerPublisher<ReplicatedClass, ReplicatedCodec>;
+using Subscriber = IdTaggedContainerSubscriber<ReplicatedClass, ReplicatedCodec>;
+
+//! runs an io_context in a thread and lets tests wait for replica updates
+struct ReplicationFixture {
+
+	ReplicationFixture()
+			: m_work(boost::asio::make_work_guard(m_io_ctx))
+			, m_thread([this] { m_io_ctx.run(); }) {
+
+		m_publisher = std::make_shared<Publisher>(m_io_ctx, m_source,
+				boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+		m_publisher->start();
+
+		m_subscriber = std::make_shared<Subscriber>(m_io_ctx, m_replica);
+		m_subscriber->set_update_handler([this](const boost::uint64_t n_incarnation) {
+			boost::lock_guard<boost::mutex> lock(m_mutex);
+			m_remote_incarnation = n_incarnation;
+			m_updated.notify_all();
+		});
+	}
+
+	~ReplicationFixture() {
+
+		m_subscriber->stop();
+		m_publisher->stop();
+		m_work.reset();
+		m_thread.join();
+	}
+
+	//! wait until the replica has applied the given incarnation of the source
+	bool wait_for(const boost::uint64_t n_incarnation) {
+
+		boost::unique_lock<boost::mutex> lock(m_mutex);
+		return m_updated.wait_for(lock, boost::chrono::seconds(5), [&] { return m_remote_incarnation >= n_incarnation; });
+	}
+
+	boost::asio::io_context           m_io_ctx;
+	boost::asio::executor_work_guard<boost::asio::io_context::executor_type> m_work;
+	boost::thread                     m_thread;
+
+	IdTaggedContainer<ReplicatedClass> m_source;
+	IdTaggedContainer<ReplicatedClass> m_replica;
+	std::shared_ptr<Publisher>         m_publisher;
+	std::shared_ptr<Subscriber>        m_subscriber;
+
+	boost::mutex                       m_mutex;
+	boost::condition_variable          m_updated;
+	boost::uint64_t                    m_remote_incarnation = 0;
+};
+
+BOOST_FIXTURE_TEST_SUITE(replication, ReplicationFixture)
+
+BOOST_AUTO_TEST_CASE(SnapshotAndDeltas) {
+
+	BOOST_TEST_MESSAGE("replicating an id tagged container over localhost");
+
+	// those are present before anyone subscribes and must arrive in the snapshot
+	for (ReplicatedClass::id_type i = 1; i <= 100; ++i) {
+		BOOST_REQUIRE(m_publisher->insert(std::make_shared<ReplicatedClass>(i, "initial " + std::to_string(i))));
+	}
+
+	m_subscriber->start("127.0.0.1", m_publisher->local_endpoint().port());
+	BOOST_REQUIRE(wait_for(m_source.incarnation()));
+	BOOST_CHECK(m_subscriber->synchronized());
+
+	// now stream some changes
+	BOOST_CHECK(m_publisher->remove(5));
+	BOOST_CHECK(!m_publisher->remove(5));
+	BOOST_CHECK(m_publisher->replace(std::make_shared<ReplicatedClass>(6, "changed")));
+	BOOST_CHECK(m_publisher->insert(std::make_shared<ReplicatedClass>(1000, "new")));
+	m_publisher->flush();
+
+	BOOST_REQUIRE(wait_for(m_source.incarnation()));
+
+	// the io thread is idle now as nothing else is published
+	BOOST_CHECK(m_replica == m_source);
+	BOOST_CHECK(!m_replica.has(5));
+	BOOST_CHECK(m_replica.get(6)->m_payload == "changed");
+	BOOST_CHECK(m_replica.get(1000)->m_payload == "new");
+	BOOST_CHECK(m_replica.get(42)->m_payload == "initial 42");
+
+	m_publisher->clear();
+	BOOST_REQUIRE(wait_for(m_source.incarnation()));
+	BOOST_CHECK(m_replica.empty());
+}
+
+BOOST_AUTO_TEST_CASE(ManySmallChanges) {
+
+	BOOST_TEST_MESSAGE("batching many changes into few frames");
+
+	m_subscriber->start("127.0.0.1", m_publisher->local_endpoint().port());
+	BOOST_REQUIRE(wait_for(0));
+
+	for (ReplicatedClass::id_type i = 1; i <= 20000; ++i) {
+		m_publisher->insert(std::make_shared<ReplicatedClass>(i, std::string(i % 50, 'x')));
+	}
+
+	BOOST_REQUIRE(wait_for(m_source.incarnation()));
+	BOOST_CHECK(m_replica.size() == 20000);
+	BOOST_CHECK(m_replica == m_source);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//! decodes slowly, so the subscriber cannot keep up with the publisher
+struct SlowReplicatedCodec : public ReplicatedCodec {
+
+	std::shared_ptr<ReplicatedClass> decode(const ReplicatedClass::id_type n_id, const char *n_data, const std::size_t n_size) const {
+
+		boost::this_thread::sleep_for(boost::chrono::microseconds(50));
+		return ReplicatedCodec::decode(n_id, n_data, n_size);
+	}
+};
+
+BOOST_AUTO_TEST_CASE(SlowSubscriberResync) {
+
+	BOOST_TEST_MESSAGE("a slow subscriber gets a snapshot larger than the queue limit under constant writes");
+
+	using SlowSubscriber = IdTaggedContainerSubscriber<ReplicatedClass, SlowReplicatedCodec>;
+
+	// publisher and subscriber on their own threads so the slow one doesn't hold up the other
+	boost::asio::io_context publisher_ctx;
+	boost::asio::io_context subscriber_ctx;
+	auto publisher_work = boost::asio::make_work_guard(publisher_ctx);
+	auto subscriber_work = boost::asio::make_work_guard(subscriber_ctx);
+	boost::thread publisher_thread([&] { publisher_ctx.run(); });
+	boost::thread subscriber_thread([&] { subscriber_ctx.run(); });
+
+	ReplicationOptions options;
+	options.max_batch_bytes = 16 * 1024;
+	options.max_queued_bytes = 64 * 1024;
+
+	// about 2MB of snapshot, way more than the limit
+	const std::string payload(1000, 'x');
+	IdTaggedContainer<ReplicatedClass> source;
+	IdTaggedContainer<ReplicatedClass> replica;
+	std::shared_ptr<Publisher> publisher = std::make_shared<Publisher>(publisher_ctx, source,
+			boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0), options);
+	publisher->start();
+	for (ReplicatedClass::id_type i = 1; i <= 2000; ++i) {
+		BOOST_REQUIRE(publisher->insert(std::make_shared<ReplicatedClass>(i, payload)));
+	}
+
+	std::shared_ptr<SlowSubscriber> subscriber = std::make_shared<SlowSubscriber>(subscriber_ctx, replica);
+	subscriber->start("127.0.0.1", publisher->local_endpoint().port());
+
+	// The snapshot must get through while writes go on faster than the subscriber can read.
+	// Deltas exceed the limit over and over, which must not throw away the snapshot itself.
+	const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+	ReplicatedClass::id_type next = 1;
+	while (!subscriber->synchronized() && (std::chrono::steady_clock::now() < deadline)) {
+		for (int i = 0; i < 100; ++i) {
+			publisher->replace(std::make_shared<ReplicatedClass>(next, payload + std::to_string(next)));
+			next = (next % 2000) + 1;
+		}
+		boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+	}
+	BOOST_CHECK(subscriber->synchronized());
+
+	// and once the writes stop the replica catches up entirely
+	publisher->flush();
+	while ((subscriber->remote_incarnation() < source.incarnation()) && (std::chrono::steady_clock::now() < deadline)) {
+		boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+	}
+	BOOST_REQUIRE(subscriber->remote_incarnation() >= source.incarnation());
+
+	// the replica is only touched on the subscriber's thread
+	std::promise<bool> equal;
+	boost::asio::post(subscriber_ctx, [&] { equal.set_value(replica == source); });
+	BOOST_CHECK(equal.get_future().get());
+
+	subscriber->stop();
+	publisher->stop();
+	publisher_work.reset();
+	subscriber_work.reset();
+	publisher_thread.join();
+	subscriber_thread.join();
+}
+
+//! throws on one particular payload like a codec with a bug would
+struct ThrowingReplicatedCodec : public ReplicatedCodec {
+
+	std::shared_ptr<ReplicatedClass> decode(const ReplicatedClass::id_type n_id, const char *n_data, const std::size_t n_size) const {
+
+		if (std::string(n_data, n_size) == "throw") {
+			throw std::runtime_error("codec failure");
+		}
+		return ReplicatedCodec::decode(n_id, n_data, n_size);
+	}
+};
+
+namespace {
+
+	std::string snapshot_begin_frame(const boost::uint64_t n_count) {
+
+		std::string ret;
+		moose::tools::replication::begin_frame(ret, moose::tools::replication::frame_type::snapshot_begin);
+		moose::tools::replication::append_u64(ret, 1);
+		moose::tools::replication::append_u64(ret, n_count);
+		moose::tools::replication::finish_frame(ret);
+		return ret;
+	}
+
+	std::string single_entry_batch(const moose::tools::replication::entry_op n_op, const ReplicatedClass::id_type n_id, const std::string &n_payload) {
+
+		std::string ret;
+		moose::tools::replication::begin_frame(ret, moose::tools::replication::frame_type::batch);
+		moose::tools::replication::append_u64(ret, 1);
+		moose::tools::replication::append_u32(ret, 1);
+		moose::tools::replication::append_u8(ret, static_cast<boost::uint8_t>(n_op));
+		ret.append(reinterpret_cast<const char *>(&n_id), sizeof(n_id));
+		moose::tools::replication::append_u32(ret, static_cast<boost::uint32_t>(n_payload.size()));
+		ret.append(n_payload);
+		moose::tools::replication::finish_frame(ret);
+		return ret;
+	}
+
+	/*! serve n_frames to a subscriber of the given type and return why it stopped
+		The replica is expected to hold id 7 before and after.
+	 */
+	template <typename SubscriberType>
+	boost::system::error_code serve_frames(const std::string &n_frames) {
+
+		boost::asio::io_context io_ctx;
+		boost::asio::ip::tcp::acceptor acceptor(io_ctx, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+		boost::asio::ip::tcp::socket peer(io_ctx);
+		acceptor.async_accept(peer, [&](const boost::system::error_code &n_error) {
+			if (!n_error) {
+				boost::asio::write(peer, boost::asio::buffer(n_frames));
+			}
+		});
+
+		IdTaggedContainer<ReplicatedClass> replica;
+		BOOST_REQUIRE(replica.insert(std::make_shared<ReplicatedClass>(7, "live")));
+
+		boost::system::error_code stopped;
+		std::shared_ptr<SubscriberType> subscriber = std::make_shared<SubscriberType>(io_ctx, replica);
+		subscriber->set_stop_handler([&](const boost::system::error_code &n_error) {
+			stopped = n_error;
+			io_ctx.stop();
+		});
+		subscriber->start("127.0.0.1", acceptor.local_endpoint().port());
+
+		// exceptions escaping here would fail the test
+		BOOST_CHECK_NO_THROW(io_ctx.run_for(std::chrono::seconds(5)));
+		BOOST_CHECK(replica.has(7));
+		BOOST_CHECK(!subscriber->synchronized());
+		return stopped;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(InvalidStreams) {
+
+	BOOST_TEST_MESSAGE("a subscriber drops publishers violating the protocol");
+
+	const std::string hello = moose::tools::replication::hello_frame(sizeof(ReplicatedClass::id_type));
+
+	// announcing more than could ever be allocated must not be trusted
+	BOOST_CHECK(serve_frames<Subscriber>(hello + snapshot_begin_frame(std::numeric_limits<boost::uint64_t>::max())
+			+ single_entry_batch(moose::tools::replication::entry_op::remove, 7, "")) == boost::asio::error::invalid_argument);
+
+	BOOST_CHECK(serve_frames<Subscriber>(hello + snapshot_begin_frame(1)
+			+ single_entry_batch(moose::tools::replication::entry_op::clear, 0, "")) == boost::asio::error::invalid_argument);
+
+	// other exceptions than moose_error end the session as well
+	using ThrowingSubscriber = IdTaggedContainerSubscriber<ReplicatedClass, ThrowingReplicatedCodec>;
+	BOOST_CHECK(serve_frames<ThrowingSubscriber>(hello
+			+ single_entry_batch(moose::tools::replication::entry_op::upsert, 8, "throw")) == boost::asio::error::invalid_argument);
+}
@@ -44,6 +44,93 @@ BOOST_AUTO_TEST_CASE(ParseIp) {
 	BOOST_CHECK_THROW(from_google_ep("ipv4:192.", addr, port), network_error);
 }
 
+BOOST_AUTO_TEST_CASE(TryParseIp) {
+
+	namespace ip = boost::asio::ip;
+
+	const expected<ip::tcp::endpoint> v4 = try_from_google_ep("ipv4:192.168.178.30:61184");
+	BOOST_REQUIRE(v4);
+	BOOST_CHECK_EQUAL(v4->address(), ip::make_address("192.168.178.30"));
+	BOOST_CHECK_EQUAL(v4->port(), 61184);
+
+	const expected<ip::tcp::endpoint> v6 = try_from_google_ep("ipv6:[2a02:810d:e40:67c:adb3:f561:144f:89f5]:61176");
+	BOOST_REQUIRE(v6);
+	BOOST_CHECK_EQUAL(v6->address(), ip::make_address("2a02:810d:e40:67c:adb3:f561:144f:89f5"));
+	BOOST_CHECK_EQUAL(v6->port(), 61176);
+
+	for (const char *bad : { "ipv6:[2a02:810dsgdc:adb3:f561:144f:89f5]:61176", "ipdyfa6", "ipv4:192.", "ipv4:192.168.178.30:70000",
+			"ipv4:192.168.178.30:", "ipv6:2a02::1:80", "" }) {
+		const expected<ip::tcp::endpoint> ep = try_from_google_ep(bad);
+		BOOST_CHECK_MESSAGE(!ep, bad);
+		BOOST_CHECK(ep.error().kind() == error_kind::network);
+	}
+
+	const expected<ip::udp::endpoint> udp4 = try_string_to_udp_endpoint("127.0.0.1:42");
+	BOOST_REQUIRE(udp4);
+	BOOST_CHECK_EQUAL(*udp4, ip::udp::endpoint(ip::make_address("127.0.0.1"), 42));
+
+	const expected<ip::udp::endpoint> udp6 = try_string_to_udp_endpoint("[::1]:42");
+	BOOST_REQUIRE(udp6);
+	BOOST_CHECK_EQUAL(*udp6, ip::udp::endpoint(ip::make_address("::1"), 42));
+
+	BOOST_CHECK(!try_string_to_udp_endpoint("[::1:42"));
+	BOOST_CHECK(!try_string_to_udp_endpoint("127.0.0.1"));
+	BOOST_CHECK(!try_string_to_udp_endpoint(":42"));
+	BOOST_CHECK_THROW(try_string_to_udp_endpoint("moose:42").value(), network_error);
+}
+
+BOOST_AUTO_TEST_CASE(ParseEndpointForms) {
+
+	namespace ip = boost::asio::ip;
+
+	// everything asio accepts must come out the same
+	for (const char *good : { "0.0.0.0", "255.255.255.255", "10.0.0.1", "[::]", "[::1]", "[1::]", "[1:2:3:4:5:6:7::]", "[::2:3:4:5:6:7:8]",
+			"[1:2:3:4:5:6:7:8]", "[fe80::ABCD:ef01]", "[::ffff:192.168.1.1]", "[1:2:3:4:5:6:1.2.3.4]", "[2a02:810d:e40:67c:adb3:f561:144f:89f5]" }) {
+		const std::string address_string(good);
+		const std::string plain = (address_string.front() == '[') ? address_string.substr(1, address_string.size() - 2) : address_string;
+
+		ip::address address;
+		unsigned short int port = 0;
+		BOOST_CHECK_MESSAGE(parse_endpoint(address_string + ":8080", address, port) == endpoint_parse_error::none, good);
+		BOOST_CHECK_EQUAL(address, ip::make_address(plain));
+		BOOST_CHECK_EQUAL(port, 8080);
+	}
+
+	for (const char *bad : { "", "1.2.3:1", "1.2.3.4.5:1", "256.1.1.1:1", "01.2.3.4:1", "1..2.3:1", "a.b.c.d:1", "[1:2:3:4:5:6:7:8:9]:1",
+			"[1::2::3]:1", "[12345::]:1", "[:1]:1", "[1:]:1", "[:::]:1", "[1:2:3:4:5:6:7:8::]:1", "[::1.2.3]:1", "[1:2:3:4:5:6:7:1.2.3.4]:1",
+			"[::1%eth0]:1", "[::1:1", "::1:1" }) {
+		ip::address address;
+		unsigned short int port = 0;
+		BOOST_CHECK_MESSAGE(parse_endpoint(bad, address, port) == endpoint_parse_error::bad_address, bad);
+	}
+
+	for (const char *bad : { "1.2.3.4", "1.2.3.4:", "1.2.3.4:65536", "1.2.3.4:99999999999", "1.2.3.4:-1", "1.2.3.4:80x", "[::1]", "[::1]80", "[::1]:" }) {
+		ip::address address;
+		unsigned short int port = 0;
+		BOOST_CHECK_MESSAGE(parse_endpoint(bad, address, port) == endpoint_parse_error::bad_port, bad);
+	}
+
+	// outputs are left alone on failure
+	ip::address address = ip::make_address("10.0.0.1");
+	unsigned short int port = 42;
+	BOOST_CHECK(parse_endpoint("1.2.3.4:70000", address, port) == endpoint_parse_error::bad_port);
+	BOOST_CHECK_EQUAL(address, ip::make_address("10.0.0.1"));
+	BOOST_CHECK_EQUAL(port, 42);
+
+	BOOST_CHECK(parse_google_ep("ipv4:1.2.3.4:65535", address, port) == endpoint_parse_error::none);
+	BOOST_CHECK_EQUAL(address, ip::make_address("1.2.3.4"));
+	BOOST_CHECK_EQUAL(port, 65535);
+	BOOST_CHECK(parse_google_ep("ipv4:[::1]:80", address, port) == endpoint_parse_error::bad_prefix);
+	BOOST_CHECK(parse_google_ep("ipv6:1.2.3.4:80", address, port) == endpoint_parse_error::bad_prefix);
+	BOOST_CHECK(parse_google_ep("[::1]:80", address, port) == endpoint_parse_error::bad_prefix);
+	BOOST_CHECK(parse_google_ep("ipv6:[::1]", address, port) == endpoint_parse_error::bad_port);
+
+	const expected<ip::udp::endpoint> failed = try_string_to_udp_endpoint("1.2.3.4:70000");
+	BOOST_REQUIRE(!failed);
+	BOOST_CHECK_EQUAL(failed.error().code(), static_cast<int>(endpoint_parse_error::bad_port));
+	BOOST_CHECK_THROW(string_to_udp_endpoint("1.2.3.4:70000"), network_error);
+}
+
 BOOST_AUTO_TEST_CASE(AsioEP) {
 
 	using boost::asio::ip::udp;
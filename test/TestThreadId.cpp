@@ -49,3 +49,26 @@ BOOST_AUTO_TEST_CASE(RunThreaded) {
 }
 
 
+void insert_own_index(boost::mutex &n_mutex, std::set<unsigned int> &n_set) {
+
+	const unsigned int index_here = moose::tools::thread_index();
+	BOOST_CHECK(index_here == moose::tools::thread_index());
+	boost::unique_lock<boost::mutex> slock(n_mutex);
+	n_set.insert(index_here);
+}
+
+BOOST_AUTO_TEST_CASE(ThreadIndex) {
+
+	boost::mutex m;
+	std::set<unsigned int> results;
+
+	boost::thread_group threads;
+	for (unsigned int i = 0; i < 20; ++i) {
+		threads.create_thread(boost::bind(&insert_own_index, boost::ref(m), boost::ref(results)));
+	}
+	threads.join_all();
+
+	// distinct and dense, allowing for this and earlier threads
+	BOOST_CHECK(results.size() == 20);
+	BOOST_CHECK(*results.rbegin() < 20 + 2 + 100);
+}